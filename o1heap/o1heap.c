@@ -17,6 +17,7 @@
 #include "o1heap.h"
 #include <assert.h>
 #include <limits.h>
+#include <string.h>
 
 // ---------------------------------------- BUILD CONFIGURATION OPTIONS ----------------------------------------
 
@@ -79,12 +80,63 @@ O1HEAP_PRIVATE uint_fast8_t O1HEAP_CLZ(const size_t x)
 }
 #endif
 
+/// Atomic operations are only needed for the concurrent heap (see o1heapConcurrentInit()) and for the deferred
+/// deallocation (see o1heapFreeDeferred()); the rest of the library does not use them. The semantics of the
+/// operations shall match those of the corresponding C11 atomic_*() functions with the sequentially consistent
+/// memory order, except that the operands are ordinary (non-_Atomic) bool, size_t, or pointer objects.
+/// If the user overrides one of these, all of them shall be overridden. If they are not available,
+/// o1heapConcurrentInit() always returns NULL and o1heapFreeDeferred() always returns false.
+#if O1HEAP_USE_INTRINSICS && !defined(O1HEAP_ATOMIC_LOAD)
+#    if defined(__GNUC__) || defined(__clang__)
+// Intentional violation of MISRA: the atomic intrinsics are type-generic, so they cannot be wrapped into functions.
+#        define O1HEAP_ATOMIC_LOAD(p) __atomic_load_n((p), __ATOMIC_SEQ_CST)                  // NOSONAR
+#        define O1HEAP_ATOMIC_EXCHANGE(p, v) __atomic_exchange_n((p), (v), __ATOMIC_SEQ_CST)  // NOSONAR
+#        define O1HEAP_ATOMIC_COMPARE_EXCHANGE(p, e, v) \
+            __atomic_compare_exchange_n((p), (e), (v), false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)  // NOSONAR
+#        define O1HEAP_ATOMIC_FETCH_ADD(p, v) __atomic_fetch_add((p), (v), __ATOMIC_SEQ_CST)  // NOSONAR
+#        define O1HEAP_ATOMIC_FETCH_SUB(p, v) __atomic_fetch_sub((p), (v), __ATOMIC_SEQ_CST)  // NOSONAR
+#    endif
+#endif
+
+/// The maximum number of fragments queued by o1heapFreeDeferred() that are released per o1heapAllocate() or
+/// o1heapFree() call. Larger values drain the queue faster at the expense of the worst-case execution time.
+#ifndef O1HEAP_DEFERRED_DRAIN_LIMIT
+#    define O1HEAP_DEFERRED_DRAIN_LIMIT 4U
+#endif
+
+/// The number of bits of the second-level bin index. Zero selects the classic half-fit engine where each bin covers
+/// one power of two. A non-zero value K splits each power-of-two bin into 2**K linearly spaced sub-bins
+/// (two-level segregated fit, TLSF), which reduces the rounding waste at the cost of a weaker WCMC guarantee.
+#ifndef O1HEAP_SUBBIN_BITS
+#    define O1HEAP_SUBBIN_BITS 0U
+#endif
+
+/// The maximum number of free fragments at the head of the floor bin that are checked for a sufficient fit before
+/// a fragment is taken from a larger bin. Zero disables the probing. Larger values find a fit more often
+/// at the expense of the worst-case execution time of the allocation functions.
+#ifndef O1HEAP_FLOOR_PROBE_LIMIT
+#    define O1HEAP_FLOOR_PROBE_LIMIT 0U
+#endif
+
+/// If non-zero, o1heapFree() does not merge the fragment with its neighbors but only queues it for coalescing,
+/// which is done by o1heapMaintain() or on demand when an allocation request cannot be served otherwise.
+#ifndef O1HEAP_DEFERRED_COALESCING
+#    define O1HEAP_DEFERRED_COALESCING 0
+#endif
+
 // ---------------------------------------- INTERNAL DEFINITIONS ----------------------------------------
 
 #if !defined(__STDC_VERSION__) || (__STDC_VERSION__ < 199901L)
 #    error "Unsupported language: ISO C99 or a newer version is required."
 #endif
 
+#if defined(O1HEAP_ATOMIC_LOAD) && defined(O1HEAP_ATOMIC_EXCHANGE) && defined(O1HEAP_ATOMIC_COMPARE_EXCHANGE) && \
+    defined(O1HEAP_ATOMIC_FETCH_ADD) && defined(O1HEAP_ATOMIC_FETCH_SUB)
+#    define ATOMICS_AVAILABLE 1
+#else
+#    define ATOMICS_AVAILABLE 0
+#endif
+
 #if __STDC_VERSION__ < 201112L
 // Intentional violation of MISRA: static assertion macro cannot be replaced with a function definition.
 #    define static_assert(x, ...) typedef char _static_assert_gl(_static_assertion_, __LINE__)[(x) ? 1 : -1]  // NOSONAR
@@ -100,24 +152,64 @@ O1HEAP_PRIVATE uint_fast8_t O1HEAP_CLZ(const size_t x)
 /// This is risky, handle with care: if the allocation amount plus per-fragment overhead exceeds 2**(b-1),
 /// where b is the pointer bit width, then ceil(log2(amount)) yields b; then 2**b causes an integer overflow.
 /// To avoid this, we put a hard limit on fragment size (which is amount + per-fragment overhead): 2**(b-1)
-#define FRAGMENT_SIZE_MAX ((SIZE_MAX >> 1U) + 1U)
+/// The compact headers store the size in 32 bits, so the same reasoning applies with b=32.
+#if O1HEAP_COMPACT_HEADERS
+#    define FRAGMENT_SIZE_MAX ((((size_t) UINT32_MAX) >> 1U) + 1U)
+#else
+#    define FRAGMENT_SIZE_MAX ((SIZE_MAX >> 1U) + 1U)
+#endif
 
 /// Normally we should subtract log2(FRAGMENT_SIZE_MIN) but log2 is bulky to compute using the preprocessor only.
 /// We will certainly end up with unused bins this way, but it is cheap to ignore.
 #define NUM_BINS_MAX (sizeof(size_t) * CHAR_BIT)
+static_assert(NUM_BINS_MAX == O1HEAP_DIAGNOSTICS_BIN_COUNT, "Memory layout error");
+
+/// Each first-level (power-of-two) bin is split into this many second-level bins.
+/// The second-level mask of each first-level bin is 32 bits wide, hence the limit.
+#define NUM_SUBBINS (1U << O1HEAP_SUBBIN_BITS)
+static_assert(O1HEAP_SUBBIN_BITS <= 5U, "O1HEAP_SUBBIN_BITS shall not exceed 5");
+
+/// The tag is stored in a single byte of the fragment header.
+static_assert((O1HEAP_TAG_COUNT >= 1U) && (O1HEAP_TAG_COUNT <= 256U), "O1HEAP_TAG_COUNT shall be in [1, 256]");
 
 static_assert((O1HEAP_ALIGNMENT & (O1HEAP_ALIGNMENT - 1U)) == 0U, "Not a power of 2");
 static_assert((FRAGMENT_SIZE_MIN & (FRAGMENT_SIZE_MIN - 1U)) == 0U, "Not a power of 2");
 static_assert((FRAGMENT_SIZE_MAX & (FRAGMENT_SIZE_MAX - 1U)) == 0U, "Not a power of 2");
 
 typedef struct Fragment Fragment;
+typedef struct Region   Region;
 
+#if O1HEAP_COMPACT_HEADERS
+/// A compact link is the signed distance from the fragment that holds the link to the target fragment expressed
+/// in units of FRAGMENT_SIZE_MIN. This is possible because all fragments share the same offset relative to
+/// FRAGMENT_SIZE_MIN (see getRootFragmentOffset()), also across regions. A link to self is zero.
+typedef int32_t FragmentLink;
+#    define LINK_NULL INT32_MIN
+/// The compact size field holds the flags in its lower bits, which are zero because of the size granularity.
+#    define SIZE_FLAG_USED 1U
+#    define SIZE_FLAG_ZEROED 2U
+#    define SIZE_FLAG_MOVABLE 4U
+#    define SIZE_FLAG_MASK (SIZE_FLAG_USED | SIZE_FLAG_ZEROED | SIZE_FLAG_MOVABLE)
+static_assert(SIZE_FLAG_MASK < FRAGMENT_SIZE_MIN, "Memory layout error");
+#else
+typedef Fragment* FragmentLink;
+#endif
+
+/// The fields shall only be accessed via getNext(), getSize(), isUsed(), etc. because their format depends on
+/// O1HEAP_COMPACT_HEADERS.
 typedef struct FragmentHeader
 {
-    Fragment* next;
-    Fragment* prev;
-    size_t    size;
-    bool      used;
+    FragmentLink next;
+    FragmentLink prev;
+#if O1HEAP_COMPACT_HEADERS
+    uint32_t size;  ///< The used, zeroed, and movable flags are stored in the lower bits, see SIZE_FLAG_MASK.
+#else
+    size_t size;
+    bool   used;
+    bool   zeroed;   ///< Free fragments only: the memory past the free list links is known to be zero-filled.
+    bool   movable;  ///< Used fragments only: the allocation was made by o1heapAllocateMovable().
+#endif
+    uint8_t tag;  ///< Used fragments only: the allocation tag, see o1heapAllocateTagged().
 } FragmentHeader;
 static_assert(sizeof(FragmentHeader) <= O1HEAP_ALIGNMENT, "Memory layout error");
 
@@ -125,17 +217,90 @@ struct Fragment
 {
     FragmentHeader header;
     // Everything past the header may spill over into the allocatable space. The header survives across alloc/free.
-    Fragment* next_free;  // Next free fragment in the bin; NULL in the last one.
-    Fragment* prev_free;  // Same but points back; NULL in the first one.
+    FragmentLink next_free;  // Next free fragment in the bin; NULL in the last one.
+    FragmentLink prev_free;  // Same but points back; the first one points to the last one (possibly itself).
 };
 static_assert(sizeof(Fragment) <= FRAGMENT_SIZE_MIN, "Memory layout error");
+static_assert(sizeof(Fragment) > O1HEAP_ALIGNMENT, "Memory layout error");
+
+/// The state of the incremental validation performed by o1heapValidateStep().
+typedef struct
+{
+    const Fragment* fragment;    ///< The next fragment to validate; NULL if a new pass is to be started.
+    size_t          region;      ///< The region of the fragment, see O1HeapFragmentInfo.
+    size_t          used_size;   ///< The totals over the fragments validated during the current pass.
+    size_t          free_size;
+    size_t          free_count;
+    bool            unmodified;  ///< False if the bins were modified during the current pass, voiding the totals.
+} ValidationCursor;
+
+/// The checkpoint recorded by o1heapMark(). The frame is the free fragment that was the largest one at the time of
+/// the checkpoint; the checkpoint is intact as long as the bins have only been modified within the frame since then.
+typedef struct
+{
+    Fragment* fragment;   ///< The frame; NULL if there is no checkpoint.
+    Fragment* next;       ///< The right neighbor of the frame at the time of the checkpoint.
+    size_t    size;       ///< The size of the frame at the time of the checkpoint.
+    size_t    allocated;  ///< The allocated memory at the time of the checkpoint.
+    size_t    tag_allocated[O1HEAP_TAG_COUNT];  ///< The per-tag allocated memory at the time of the checkpoint.
+    bool      intact;
+} Checkpoint;
+
+/// The state of the memory pressure notifications, see o1heapSetPressureCallback().
+typedef struct
+{
+    O1HeapPressureCallback callback;  ///< NULL if there is no callback.
+    void*                  context;
+    size_t                 high_watermark;
+    size_t                 low_watermark;
+    bool                   high;  ///< True since the high watermark is crossed until the low watermark is crossed.
+    bool                   busy;  ///< True while the callback is running, so that it is not invoked recursively.
+} PressureMonitor;
+
+/// The handle table of the movable allocations and the state of the incremental compaction, see o1heapCompactStep().
+typedef struct
+{
+    O1HeapMovableEntry* entries;  ///< NULL unless attached via o1heapSetMovableTable().
+    size_t              count;
+    O1HeapMovable       vacant;    ///< The first vacant entry; the rest are linked via their pins field.
+    size_t              live;      ///< The number of the movable allocations.
+    Fragment*           fragment;  ///< The next fragment to examine; NULL if a new pass is to be started.
+    size_t              region;    ///< The region of the fragment, see O1HeapFragmentInfo.
+} MovableTable;
 
 struct O1HeapInstance
 {
-    Fragment* bins[NUM_BINS_MAX];  ///< Smallest fragments are in the bin at index 0.
-    size_t    nonempty_bin_mask;   ///< Bit 1 represents a non-empty bin; bin at index 0 is for the smallest fragments.
+    /// Smallest fragments are in the bin at index 0. The bin of a fragment is given by getBinIndex().
+    Fragment* bins[NUM_BINS_MAX * NUM_SUBBINS];
+    size_t    nonempty_bin_mask;  ///< Bit 1 represents a non-empty bin; bin at index 0 is for the smallest fragments.
+#if O1HEAP_SUBBIN_BITS > 0U
+    /// Bit N of the element at index I is set if the bin (I * NUM_SUBBINS + N) is non-empty. In this configuration,
+    /// bit I of nonempty_bin_mask is set if any of the second-level bins of the first-level bin I is non-empty.
+    uint32_t nonempty_subbin_mask[NUM_BINS_MAX];
+#endif
+
+    Fragment* deferred;        ///< Lock-free stack of fragments passed to o1heapFreeDeferred(), linked via next_free.
+    Fragment* deferred_local;  ///< Fragments taken off the lock-free stack that are yet to be released.
+    Fragment* pending;         ///< Fragments freed by o1heapFree() that await coalescing, linked via next_free.
+
+    Region*         regions;  ///< The additional memory regions attached via o1heapAddRegion(), most recent first.
+    O1HeapInstance* parent;   ///< The heap that the arena and the regions are allocated from; NULL unless a child.
+
+    O1HeapFreeListPolicy    free_list_policy;  ///< Where rebin() inserts the fragments, see o1heapSetFreeListPolicy().
+    O1HeapRequestHistogram* histogram;         ///< NULL unless attached via o1heapSetRequestHistogram().
+
+    size_t  reserve;               ///< The free memory available only to the high-priority requests.
+    uint8_t reserve_min_priority;  ///< The lowest priority that may use the reserve; see o1heapSetReserve().
 
-    O1HeapDiagnostics diagnostics;
+    PressureMonitor pressure;
+    MovableTable    movable;
+
+    ValidationCursor validation;
+    Checkpoint       checkpoint;
+
+    O1HeapDiagnostics    diagnostics;
+    O1HeapFragmentation  fragmentation;
+    O1HeapTagDiagnostics tag_diagnostics[O1HEAP_TAG_COUNT];
 };
 
 /// The amount of space allocated for the heap instance.
@@ -145,6 +310,76 @@ struct O1HeapInstance
 static_assert(INSTANCE_SIZE_PADDED >= sizeof(O1HeapInstance), "Invalid instance footprint computation");
 static_assert((INSTANCE_SIZE_PADDED % O1HEAP_ALIGNMENT) == 0U, "Invalid instance footprint computation");
 
+/// Each additional memory region begins with this header followed by the root fragment of the region.
+/// The fragments of different regions are never merged because the fragment chain of each region is NULL-terminated.
+struct Region
+{
+    Region* next;
+    size_t  capacity;  ///< The total size of the fragments in this region.
+};
+
+#define REGION_SIZE_PADDED ((sizeof(Region) + O1HEAP_ALIGNMENT - 1U) & ~(O1HEAP_ALIGNMENT - 1U))
+
+struct O1HeapCache
+{
+    O1HeapInstance* heap;
+    size_t          max_amount;   ///< The largest request that can be served from the cache.
+    size_t          depth;        ///< The capacity of each stack.
+    size_t          num_classes;  ///< Class N holds fragments of size (FRAGMENT_SIZE_MIN << N).
+    size_t*         fill;         ///< The number of fragments in each stack; [num_classes].
+    void**          stacks;       ///< The storage for all stacks, the bottom item is the oldest; [num_classes][depth].
+};
+
+/// The slot sizes of the slab allocator; the largest one shall equal O1HEAP_SLAB_AMOUNT_MAX.
+#define SLAB_CLASS_COUNT 5U
+#define SLAB_SIZE_MAX 65536U
+
+typedef struct Slab Slab;
+
+/// Each slab begins with this header followed by the slots. The slab is aligned at its size,
+/// so that the slab that contains a given slot can be found by clearing the lower bits of the slot address.
+/// The slots past 'fresh' have never been allocated; this avoids linking the free list when the slab is created.
+struct Slab
+{
+    Slab*    next;       ///< Next slab of the same class that has free slots; NULL in the last one.
+    Slab*    prev;       ///< Same but points back; NULL in the first one.
+    void*    free_list;  ///< The slots freed since the slab was created, linked via their first bytes.
+    uint16_t used;       ///< The number of allocated slots.
+    uint16_t fresh;      ///< The number of slots that have been allocated at least once.
+    uint8_t  cls;
+};
+
+#define SLAB_HEADER_SIZE_PADDED ((sizeof(Slab) + O1HEAP_ALIGNMENT - 1U) & ~(O1HEAP_ALIGNMENT - 1U))
+
+static_assert(((SLAB_SIZE_MAX - O1HEAP_ALIGNMENT - SLAB_HEADER_SIZE_PADDED) / sizeof(void*)) <= UINT16_MAX,
+              "The slot counters may overflow");
+
+struct O1HeapSlab
+{
+    O1HeapInstance* heap;
+    size_t          slab_size;                  ///< The size of the heap fragment occupied by each slab.
+    size_t          slots[SLAB_CLASS_COUNT];    ///< The number of slots per slab of each class.
+    Slab*           partial[SLAB_CLASS_COUNT];  ///< The slabs that have at least one free slot; most recent first.
+};
+
+typedef struct
+{
+    O1HeapInstance* heap;
+    bool            lock;
+} Shard;
+
+/// The shards are visited by o1heapConcurrentAllocate() in groups of this many, so that the shards skipped in each
+/// group can be tracked in a single bit mask.
+#define SHARD_GROUP_SIZE (sizeof(size_t) * CHAR_BIT)
+
+struct O1HeapConcurrent
+{
+    Shard* shards;       ///< [shard_count]
+    size_t shard_count;  ///< The shards are placed back-to-back in the arena.
+    size_t span;         ///< The amount of arena space occupied by each shard.
+    char*  arena;        ///< The beginning of the first shard.
+};
+
 /// Undefined for zero argument.
 O1HEAP_PRIVATE uint_fast8_t log2Floor(const size_t x)
 {
@@ -176,322 +411,2996 @@ O1HEAP_PRIVATE size_t roundUpToPowerOf2(const size_t x)
     return ((size_t) 1U) << ((sizeof(x) * CHAR_BIT) - ((uint_fast8_t) O1HEAP_CLZ(x - 1U)));
 }
 
-/// Links two fragments so that their next/prev pointers point to each other; left goes before right.
-O1HEAP_PRIVATE void interlink(Fragment* const left, Fragment* const right)
+/// Returns the index of the bin for free fragments of the specified size. The size is rounded DOWN to the lower bound
+/// of the bin. In the half-fit configuration, the index is log2Floor(size / FRAGMENT_SIZE_MIN); otherwise,
+/// it is composed of the first-level index (the same) and the second-level index (the bits past the leading one).
+O1HEAP_PRIVATE size_t getBinIndex(const size_t size)
 {
-    if (O1HEAP_LIKELY(left != NULL))
-    {
-        left->header.next = right;
-    }
-    if (O1HEAP_LIKELY(right != NULL))
-    {
-        right->header.prev = left;
-    }
+    O1HEAP_ASSERT(size >= FRAGMENT_SIZE_MIN);
+    O1HEAP_ASSERT((size % FRAGMENT_SIZE_MIN) == 0U);
+    const size_t       units = size / FRAGMENT_SIZE_MIN;
+    const uint_fast8_t fl    = log2Floor(units);
+#if O1HEAP_SUBBIN_BITS > 0U
+    // The small first-level bins cannot be split below FRAGMENT_SIZE_MIN, so some of their sub-bins remain unused.
+    const size_t sl = (fl >= O1HEAP_SUBBIN_BITS) ? ((units >> (fl - O1HEAP_SUBBIN_BITS)) - NUM_SUBBINS)
+                                                 : ((units << (O1HEAP_SUBBIN_BITS - fl)) - NUM_SUBBINS);
+    O1HEAP_ASSERT(sl < NUM_SUBBINS);
+    return (((size_t) fl) * NUM_SUBBINS) + sl;
+#else
+    return fl;
+#endif
 }
 
-/// Adds a new fragment into the appropriate bin and updates the lookup mask.
-O1HEAP_PRIVATE void rebin(O1HeapInstance* const handle, Fragment* const fragment)
+/// Rounds the size up to the lower bound of the nearest bin, so that every fragment in that bin and in the bins above
+/// it is at least as large. In the half-fit configuration, this is roundUpToPowerOf2().
+/// The argument shall exceed O1HEAP_ALIGNMENT, so that the result is not less than FRAGMENT_SIZE_MIN.
+O1HEAP_PRIVATE size_t roundUpToBin(const size_t x)
 {
-    O1HEAP_ASSERT(handle != NULL);
-    O1HEAP_ASSERT(fragment != NULL);
-    O1HEAP_ASSERT(fragment->header.size >= FRAGMENT_SIZE_MIN);
-    O1HEAP_ASSERT((fragment->header.size % FRAGMENT_SIZE_MIN) == 0U);
-    const uint_fast8_t idx = log2Floor(fragment->header.size / FRAGMENT_SIZE_MIN);  // Round DOWN when inserting.
-    O1HEAP_ASSERT(idx < NUM_BINS_MAX);
-    // Add the new fragment to the beginning of the bin list.
-    // I.e., each allocation will be returning the most-recently-used fragment -- good for caching.
-    fragment->next_free = handle->bins[idx];
-    fragment->prev_free = NULL;
-    if (O1HEAP_LIKELY(handle->bins[idx] != NULL))
+    O1HEAP_ASSERT(x > O1HEAP_ALIGNMENT);
+#if O1HEAP_SUBBIN_BITS > 0U
+    // The granularity is the power of 2 below x divided by NUM_SUBBINS, but not finer than the minimum fragment size.
+    size_t granularity = roundUpToPowerOf2(x) >> (O1HEAP_SUBBIN_BITS + 1U);
+    if (granularity < FRAGMENT_SIZE_MIN)
     {
-        handle->bins[idx]->prev_free = fragment;
+        granularity = FRAGMENT_SIZE_MIN;
     }
-    handle->bins[idx] = fragment;
-    handle->nonempty_bin_mask |= pow2(idx);
+    return (x + granularity - 1U) & ~(granularity - 1U);
+#else
+    return roundUpToPowerOf2(x);
+#endif
 }
 
-/// Removes the specified fragment from its bin.
-O1HEAP_PRIVATE void unbin(O1HeapInstance* const handle, const Fragment* const fragment)
+#if O1HEAP_COMPACT_HEADERS
+
+O1HEAP_PRIVATE FragmentLink makeLink(const Fragment* const from, const Fragment* const to)
 {
-    O1HEAP_ASSERT(handle != NULL);
-    O1HEAP_ASSERT(fragment != NULL);
-    O1HEAP_ASSERT(fragment->header.size >= FRAGMENT_SIZE_MIN);
-    O1HEAP_ASSERT((fragment->header.size % FRAGMENT_SIZE_MIN) == 0U);
-    const uint_fast8_t idx = log2Floor(fragment->header.size / FRAGMENT_SIZE_MIN);  // Round DOWN when removing.
-    O1HEAP_ASSERT(idx < NUM_BINS_MAX);
-    // Remove the bin from the free fragment list.
-    if (O1HEAP_LIKELY(fragment->next_free != NULL))
+    O1HEAP_ASSERT(from != NULL);
+    FragmentLink out = LINK_NULL;
+    if (to != NULL)
     {
-        fragment->next_free->prev_free = fragment->prev_free;
+        // The address difference is computed in unsigned arithmetic because the fragments may belong to
+        // different regions, which are different objects from the standpoint of the C language.
+        const ptrdiff_t delta = (ptrdiff_t) (((size_t) to) - ((size_t) from));
+        O1HEAP_ASSERT((delta % (ptrdiff_t) FRAGMENT_SIZE_MIN) == 0);
+        const ptrdiff_t units = delta / (ptrdiff_t) FRAGMENT_SIZE_MIN;
+        O1HEAP_ASSERT((units > (ptrdiff_t) LINK_NULL) && (units <= (ptrdiff_t) INT32_MAX));
+        out = (FragmentLink) units;
     }
-    if (O1HEAP_LIKELY(fragment->prev_free != NULL))
-    {
-        fragment->prev_free->next_free = fragment->next_free;
-    }
-    // Update the bin header.
-    if (O1HEAP_LIKELY(handle->bins[idx] == fragment))
+    return out;
+}
+
+O1HEAP_PRIVATE Fragment* followLink(const Fragment* const from, const FragmentLink link)
+{
+    O1HEAP_ASSERT(from != NULL);
+    Fragment* out = NULL;
+    if (link != LINK_NULL)
     {
-        O1HEAP_ASSERT(fragment->prev_free == NULL);
-        handle->bins[idx] = fragment->next_free;
-        if (O1HEAP_LIKELY(handle->bins[idx] == NULL))
-        {
-            handle->nonempty_bin_mask &= ~pow2(idx);
-        }
+        out = (Fragment*) (void*) (((char*) from) + (((ptrdiff_t) link) * ((ptrdiff_t) FRAGMENT_SIZE_MIN)));
     }
+    return out;
 }
 
-// ---------------------------------------- PUBLIC API IMPLEMENTATION ----------------------------------------
+O1HEAP_PRIVATE size_t getSize(const Fragment* const frag)
+{
+    return (size_t) (frag->header.size & ~(uint32_t) SIZE_FLAG_MASK);
+}
 
-O1HeapInstance* o1heapInit(void* const base, const size_t size)
+O1HEAP_PRIVATE void setSize(Fragment* const frag, const size_t value)
 {
-    O1HeapInstance* out = NULL;
-    if ((base != NULL) && ((((size_t) base) % O1HEAP_ALIGNMENT) == 0U) &&
-        (size >= (INSTANCE_SIZE_PADDED + FRAGMENT_SIZE_MIN)))
-    {
-        // Allocate the core heap metadata structure in the beginning of the arena.
-        O1HEAP_ASSERT(((size_t) base) % sizeof(O1HeapInstance*) == 0U);
-        out                    = (O1HeapInstance*) base;
-        out->nonempty_bin_mask = 0U;
-        for (size_t i = 0; i < NUM_BINS_MAX; i++)
-        {
-            out->bins[i] = NULL;
-        }
+    O1HEAP_ASSERT((value % FRAGMENT_SIZE_MIN) == 0U);
+    O1HEAP_ASSERT(value <= FRAGMENT_SIZE_MAX);
+    frag->header.size = ((uint32_t) value) | (frag->header.size & (uint32_t) SIZE_FLAG_MASK);
+}
 
-        // Limit and align the capacity.
-        size_t capacity = size - INSTANCE_SIZE_PADDED;
-        if (capacity > FRAGMENT_SIZE_MAX)
-        {
-            capacity = FRAGMENT_SIZE_MAX;
-        }
-        while ((capacity % FRAGMENT_SIZE_MIN) != 0)
-        {
-            O1HEAP_ASSERT(capacity > 0U);
-            capacity--;
-        }
-        O1HEAP_ASSERT((capacity % FRAGMENT_SIZE_MIN) == 0);
-        O1HEAP_ASSERT((capacity >= FRAGMENT_SIZE_MIN) && (capacity <= FRAGMENT_SIZE_MAX));
+O1HEAP_PRIVATE bool isUsed(const Fragment* const frag)
+{
+    return (frag->header.size & (uint32_t) SIZE_FLAG_USED) != 0U;
+}
 
-        // Initialize the root fragment.
-        Fragment* const frag = (Fragment*) (void*) (((char*) base) + INSTANCE_SIZE_PADDED);
-        O1HEAP_ASSERT((((size_t) frag) % O1HEAP_ALIGNMENT) == 0U);
-        frag->header.next = NULL;
-        frag->header.prev = NULL;
-        frag->header.size = capacity;
-        frag->header.used = false;
-        frag->next_free   = NULL;
-        frag->prev_free   = NULL;
-        rebin(out, frag);
-        O1HEAP_ASSERT(out->nonempty_bin_mask != 0U);
+O1HEAP_PRIVATE void setUsed(Fragment* const frag, const bool value)
+{
+    frag->header.size = value ? (frag->header.size | (uint32_t) SIZE_FLAG_USED)
+                              : (frag->header.size & ~(uint32_t) SIZE_FLAG_USED);
+}
 
-        // Initialize the diagnostics.
-        out->diagnostics.capacity          = capacity;
-        out->diagnostics.allocated         = 0U;
-        out->diagnostics.peak_allocated    = 0U;
-        out->diagnostics.peak_request_size = 0U;
-        out->diagnostics.oom_count         = 0U;
-    }
+O1HEAP_PRIVATE bool isZeroed(const Fragment* const frag)
+{
+    return (frag->header.size & (uint32_t) SIZE_FLAG_ZEROED) != 0U;
+}
 
-    return out;
+O1HEAP_PRIVATE void setZeroed(Fragment* const frag, const bool value)
+{
+    frag->header.size = value ? (frag->header.size | (uint32_t) SIZE_FLAG_ZEROED)
+                              : (frag->header.size & ~(uint32_t) SIZE_FLAG_ZEROED);
 }
 
-void* o1heapAllocate(O1HeapInstance* const handle, const size_t amount)
+O1HEAP_PRIVATE bool isMovable(const Fragment* const frag)
 {
-    O1HEAP_ASSERT(handle != NULL);
-    O1HEAP_ASSERT(handle->diagnostics.capacity <= FRAGMENT_SIZE_MAX);
-    void* out = NULL;
+    return (frag->header.size & (uint32_t) SIZE_FLAG_MOVABLE) != 0U;
+}
 
-    // If the amount approaches approx. SIZE_MAX/2, an undetected integer overflow may occur.
-    // To avoid that, we do not attempt allocation if the amount exceeds the hard limit.
-    // We perform multiple redundant checks to account for a possible unaccounted overflow.
-    if (O1HEAP_LIKELY((amount > 0U) && (amount <= (handle->diagnostics.capacity - O1HEAP_ALIGNMENT))))
-    {
-        // Add the header size and align the allocation size to the power of 2.
-        // See "Timing-Predictable Memory Allocation In Hard Real-Time Systems", Herter, page 27.
-        const size_t fragment_size = roundUpToPowerOf2(amount + O1HEAP_ALIGNMENT);
-        O1HEAP_ASSERT(fragment_size <= FRAGMENT_SIZE_MAX);
-        O1HEAP_ASSERT(fragment_size >= FRAGMENT_SIZE_MIN);
-        O1HEAP_ASSERT(fragment_size >= amount + O1HEAP_ALIGNMENT);
-        O1HEAP_ASSERT((fragment_size & (fragment_size - 1U)) == 0U);  // Is power of 2.
+O1HEAP_PRIVATE void setMovable(Fragment* const frag, const bool value)
+{
+    frag->header.size = value ? (frag->header.size | (uint32_t) SIZE_FLAG_MOVABLE)
+                              : (frag->header.size & ~(uint32_t) SIZE_FLAG_MOVABLE);
+}
 
-        const uint_fast8_t optimal_bin_index = log2Ceil(fragment_size / FRAGMENT_SIZE_MIN);  // Use CEIL when fetching.
-        O1HEAP_ASSERT(optimal_bin_index < NUM_BINS_MAX);
-        const size_t candidate_bin_mask = ~(pow2(optimal_bin_index) - 1U);
+#else
 
-        // Find the smallest non-empty bin we can use.
-        const size_t suitable_bins     = handle->nonempty_bin_mask & candidate_bin_mask;
-        const size_t smallest_bin_mask = suitable_bins & ~(suitable_bins - 1U);  // Clear all bits but the lowest.
-        if (O1HEAP_LIKELY(smallest_bin_mask != 0))
-        {
-            O1HEAP_ASSERT((smallest_bin_mask & (smallest_bin_mask - 1U)) == 0U);  // Is power of 2.
-            const uint_fast8_t bin_index = log2Floor(smallest_bin_mask);
-            O1HEAP_ASSERT(bin_index >= optimal_bin_index);
-            O1HEAP_ASSERT(bin_index < NUM_BINS_MAX);
-
-            // The bin we found shall not be empty, otherwise it's a state divergence (memory corruption?).
-            Fragment* const frag = handle->bins[bin_index];
-            O1HEAP_ASSERT(frag != NULL);
-            O1HEAP_ASSERT(frag->header.size >= fragment_size);
-            O1HEAP_ASSERT((frag->header.size % FRAGMENT_SIZE_MIN) == 0U);
-            O1HEAP_ASSERT(!frag->header.used);
-            unbin(handle, frag);
-
-            // Split the fragment if it is too large.
-            const size_t leftover = frag->header.size - fragment_size;
-            frag->header.size     = fragment_size;
-            O1HEAP_ASSERT(leftover < handle->diagnostics.capacity);  // Overflow check.
-            O1HEAP_ASSERT(leftover % FRAGMENT_SIZE_MIN == 0U);       // Alignment check.
-            if (O1HEAP_LIKELY(leftover >= FRAGMENT_SIZE_MIN))
-            {
-                Fragment* const new_frag = (Fragment*) (void*) (((char*) frag) + fragment_size);
-                O1HEAP_ASSERT(((size_t) new_frag) % O1HEAP_ALIGNMENT == 0U);
-                new_frag->header.size = leftover;
-                new_frag->header.used = false;
-                interlink(new_frag, frag->header.next);
-                interlink(frag, new_frag);
-                rebin(handle, new_frag);
-            }
+O1HEAP_PRIVATE FragmentLink makeLink(const Fragment* const from, const Fragment* const to)
+{
+    (void) from;
+    return (Fragment*) to;
+}
 
-            // Update the diagnostics.
-            O1HEAP_ASSERT((handle->diagnostics.allocated % FRAGMENT_SIZE_MIN) == 0U);
-            handle->diagnostics.allocated += fragment_size;
-            O1HEAP_ASSERT(handle->diagnostics.allocated <= handle->diagnostics.capacity);
-            if (O1HEAP_LIKELY(handle->diagnostics.peak_allocated < handle->diagnostics.allocated))
-            {
-                handle->diagnostics.peak_allocated = handle->diagnostics.allocated;
-            }
+O1HEAP_PRIVATE Fragment* followLink(const Fragment* const from, const FragmentLink link)
+{
+    (void) from;
+    return link;
+}
 
-            // Finalize the fragment we just allocated.
-            O1HEAP_ASSERT(frag->header.size >= amount + O1HEAP_ALIGNMENT);
-            frag->header.used = true;
+O1HEAP_PRIVATE size_t getSize(const Fragment* const frag)
+{
+    return frag->header.size;
+}
 
-            out = ((char*) frag) + O1HEAP_ALIGNMENT;
-        }
+O1HEAP_PRIVATE void setSize(Fragment* const frag, const size_t value)
+{
+    frag->header.size = value;
+}
+
+O1HEAP_PRIVATE bool isUsed(const Fragment* const frag)
+{
+    return frag->header.used;
+}
+
+O1HEAP_PRIVATE void setUsed(Fragment* const frag, const bool value)
+{
+    frag->header.used = value;
+}
+
+O1HEAP_PRIVATE bool isZeroed(const Fragment* const frag)
+{
+    return frag->header.zeroed;
+}
+
+O1HEAP_PRIVATE void setZeroed(Fragment* const frag, const bool value)
+{
+    frag->header.zeroed = value;
+}
+
+O1HEAP_PRIVATE bool isMovable(const Fragment* const frag)
+{
+    return frag->header.movable;
+}
+
+O1HEAP_PRIVATE void setMovable(Fragment* const frag, const bool value)
+{
+    frag->header.movable = value;
+}
+
+#endif
+
+O1HEAP_PRIVATE Fragment* getNext(const Fragment* const frag)
+{
+    return followLink(frag, frag->header.next);
+}
+
+O1HEAP_PRIVATE void setNext(Fragment* const frag, const Fragment* const value)
+{
+    frag->header.next = makeLink(frag, value);
+}
+
+O1HEAP_PRIVATE Fragment* getPrev(const Fragment* const frag)
+{
+    return followLink(frag, frag->header.prev);
+}
+
+O1HEAP_PRIVATE void setPrev(Fragment* const frag, const Fragment* const value)
+{
+    frag->header.prev = makeLink(frag, value);
+}
+
+O1HEAP_PRIVATE Fragment* getNextFree(const Fragment* const frag)
+{
+    return followLink(frag, frag->next_free);
+}
+
+O1HEAP_PRIVATE void setNextFree(Fragment* const frag, const Fragment* const value)
+{
+    frag->next_free = makeLink(frag, value);
+}
+
+O1HEAP_PRIVATE Fragment* getPrevFree(const Fragment* const frag)
+{
+    return followLink(frag, frag->prev_free);
+}
+
+O1HEAP_PRIVATE void setPrevFree(Fragment* const frag, const Fragment* const value)
+{
+    frag->prev_free = makeLink(frag, value);
+}
+
+O1HEAP_PRIVATE uint8_t getTag(const Fragment* const frag)
+{
+    return frag->header.tag;
+}
+
+O1HEAP_PRIVATE void setTag(Fragment* const frag, const uint8_t value)
+{
+    O1HEAP_ASSERT(value < O1HEAP_TAG_COUNT);
+    frag->header.tag = value;
+}
+
+/// The compact links can only connect the fragments that are not too far from each other. This is ensured by
+/// requiring every memory region to be within half of the link range from the instance.
+O1HEAP_PRIVATE bool isWithinLinkRange(const O1HeapInstance* const handle, const void* const base, const size_t size)
+{
+#if O1HEAP_COMPACT_HEADERS
+    const size_t instance = (size_t) handle;
+    const size_t region   = (size_t) base;
+    // The distance is expressed in units of FRAGMENT_SIZE_MIN to avoid overflow.
+    size_t distance = (instance - region) / FRAGMENT_SIZE_MIN;
+    if (region >= instance)
+    {
+        distance = ((region - instance) / FRAGMENT_SIZE_MIN) + (size / FRAGMENT_SIZE_MIN) + 1U;
     }
+    return distance < (((size_t) INT32_MAX) / 2U);
+#else
+    (void) handle;
+    (void) base;
+    (void) size;
+    return true;
+#endif
+}
 
-    // Update the diagnostics.
-    if (O1HEAP_LIKELY(handle->diagnostics.peak_request_size < amount))
+/// Links two fragments so that their next/prev pointers point to each other; left goes before right.
+O1HEAP_PRIVATE void interlink(Fragment* const left, Fragment* const right)
+{
+    if (O1HEAP_LIKELY(left != NULL))
     {
-        handle->diagnostics.peak_request_size = amount;
+        setNext(left, right);
     }
-    if (O1HEAP_LIKELY((out == NULL) && (amount > 0U)))
+    if (O1HEAP_LIKELY(right != NULL))
     {
-        handle->diagnostics.oom_count++;
+        setPrev(right, left);
     }
+}
 
-    return out;
+/// Updates the largest allocation that is guaranteed to succeed, which is given by the largest non-empty bin:
+/// every fragment in it is at least as large as its lower bound. Shall be invoked whenever nonempty_bin_mask changes.
+O1HEAP_PRIVATE void updateLargestAllocatable(O1HeapInstance* const handle)
+{
+    O1HEAP_ASSERT(handle != NULL);
+    size_t out = 0U;
+    if (O1HEAP_LIKELY(handle->nonempty_bin_mask != 0U))
+    {
+        out = (FRAGMENT_SIZE_MIN << log2Floor(handle->nonempty_bin_mask)) - O1HEAP_ALIGNMENT;
+    }
+    handle->diagnostics.largest_allocatable = out;
 }
 
-void o1heapFree(O1HeapInstance* const handle, void* const pointer)
+/// True if the fragment begins within the frame of the checkpoint; false if there is no checkpoint.
+O1HEAP_PRIVATE bool isWithinFrame(const Checkpoint* const checkpoint, const Fragment* const fragment)
+{
+    O1HEAP_ASSERT(checkpoint != NULL);
+    const size_t frame = (size_t) checkpoint->fragment;
+    return (frame != 0U) && (((size_t) fragment) >= frame) && (((size_t) fragment) < (frame + checkpoint->size));
+}
+
+/// Invoked whenever the bins are modified at the specified fragment. This voids the totals of the current validation
+/// pass, and also the checkpoint unless the fragment is within its frame (see o1heapRollback()).
+O1HEAP_PRIVATE void noteModification(O1HeapInstance* const handle, const Fragment* const fragment)
 {
     O1HEAP_ASSERT(handle != NULL);
-    O1HEAP_ASSERT(handle->diagnostics.capacity <= FRAGMENT_SIZE_MAX);
-    if (O1HEAP_LIKELY(pointer != NULL))  // NULL pointer is a no-op.
+    O1HEAP_ASSERT(fragment != NULL);
+    handle->validation.unmodified = false;
+    if (!isWithinFrame(&handle->checkpoint, fragment))
     {
-        Fragment* const frag = (Fragment*) (void*) (((char*) pointer) - O1HEAP_ALIGNMENT);
+        handle->checkpoint.intact = false;
+    }
+}
 
-        // Check for heap corruption in debug builds.
-        O1HEAP_ASSERT(((size_t) frag) % sizeof(Fragment*) == 0U);
-        O1HEAP_ASSERT(((size_t) frag) >= (((size_t) handle) + INSTANCE_SIZE_PADDED));
-        O1HEAP_ASSERT(((size_t) frag) <=
-                      (((size_t) handle) + INSTANCE_SIZE_PADDED + handle->diagnostics.capacity - FRAGMENT_SIZE_MIN));
-        O1HEAP_ASSERT(frag->header.used);  // Catch double-free
-        O1HEAP_ASSERT(((size_t) frag->header.next) % sizeof(Fragment*) == 0U);
-        O1HEAP_ASSERT(((size_t) frag->header.prev) % sizeof(Fragment*) == 0U);
-        O1HEAP_ASSERT(frag->header.size >= FRAGMENT_SIZE_MIN);
-        O1HEAP_ASSERT(frag->header.size <= handle->diagnostics.capacity);
-        O1HEAP_ASSERT((frag->header.size % FRAGMENT_SIZE_MIN) == 0U);
-
-        // Even if we're going to drop the fragment later, mark it free anyway to prevent double-free.
-        frag->header.used = false;
-
-        // Update the diagnostics. It must be done before merging because it invalidates the fragment size information.
-        O1HEAP_ASSERT(handle->diagnostics.allocated >= frag->header.size);  // Heap corruption check.
-        handle->diagnostics.allocated -= frag->header.size;
-
-        // Merge with siblings and insert the returned fragment into the appropriate bin and update metadata.
-        Fragment* const prev       = frag->header.prev;
-        Fragment* const next       = frag->header.next;
-        const bool      join_left  = (prev != NULL) && (!prev->header.used);
-        const bool      join_right = (next != NULL) && (!next->header.used);
-        if (join_left && join_right)  // [ prev ][ this ][ next ] => [ ------- prev ------- ]
-        {
-            unbin(handle, prev);
-            unbin(handle, next);
-            prev->header.size += frag->header.size + next->header.size;
-            frag->header.size = 0;  // Invalidate the dropped fragment headers to prevent double-free.
-            next->header.size = 0;
-            O1HEAP_ASSERT((prev->header.size % FRAGMENT_SIZE_MIN) == 0U);
-            interlink(prev, next->header.next);
-            rebin(handle, prev);
-        }
-        else if (join_left)  // [ prev ][ this ][ next ] => [ --- prev --- ][ next ]
-        {
-            unbin(handle, prev);
-            prev->header.size += frag->header.size;
-            frag->header.size = 0;
-            O1HEAP_ASSERT((prev->header.size % FRAGMENT_SIZE_MIN) == 0U);
-            interlink(prev, next);
-            rebin(handle, prev);
-        }
-        else if (join_right)  // [ prev ][ this ][ next ] => [ prev ][ --- this --- ]
+/// Adds a new fragment into the appropriate bin and updates the lookup mask.
+O1HEAP_PRIVATE void rebin(O1HeapInstance* const handle, Fragment* const fragment)
+{
+    O1HEAP_ASSERT(handle != NULL);
+    O1HEAP_ASSERT(fragment != NULL);
+    O1HEAP_ASSERT(getSize(fragment) >= FRAGMENT_SIZE_MIN);
+    O1HEAP_ASSERT((getSize(fragment) % FRAGMENT_SIZE_MIN) == 0U);
+    const size_t idx = getBinIndex(getSize(fragment));  // Round DOWN when inserting.
+    O1HEAP_ASSERT(idx < (NUM_BINS_MAX * NUM_SUBBINS));
+    Fragment* const head = handle->bins[idx];
+    if (O1HEAP_LIKELY(head == NULL))
+    {
+        setNextFree(fragment, NULL);
+        setPrevFree(fragment, fragment);
+        handle->bins[idx] = fragment;
+    }
+    else
+    {
+        // The first fragment points back to the last one, so the fragment can be added at either end.
+        Fragment* const tail = getPrevFree(head);
+        setPrevFree(fragment, tail);
+        setPrevFree(head, fragment);
+        // By default, add the new fragment to the beginning of the bin list.
+        // I.e., each allocation will be returning the most-recently-used fragment -- good for caching.
+        const bool at_head = (handle->free_list_policy == O1HEAP_FREE_LIST_MRU) ||
+                             ((handle->free_list_policy == O1HEAP_FREE_LIST_ADDRESS_ORDERED) &&
+                              (((size_t) fragment) < ((size_t) head)));
+        if (at_head)
         {
-            unbin(handle, next);
-            frag->header.size += next->header.size;
-            next->header.size = 0;
-            O1HEAP_ASSERT((frag->header.size % FRAGMENT_SIZE_MIN) == 0U);
-            interlink(frag, next->header.next);
-            rebin(handle, frag);
+            setNextFree(fragment, head);
+            handle->bins[idx] = fragment;
         }
         else
         {
-            rebin(handle, frag);
+            setNextFree(fragment, NULL);
+            setNextFree(tail, fragment);
         }
     }
+#if O1HEAP_SUBBIN_BITS > 0U
+    handle->nonempty_subbin_mask[idx / NUM_SUBBINS] |= ((uint32_t) 1U) << (idx % NUM_SUBBINS);
+#endif
+    handle->nonempty_bin_mask |= pow2((uint_fast8_t) (idx / NUM_SUBBINS));
+    if (O1HEAP_LIKELY(head == NULL))
+    {
+        updateLargestAllocatable(handle);
+    }
+    handle->fragmentation.free_fragment_count[idx / NUM_SUBBINS]++;
+    handle->fragmentation.free_fragment_size[idx / NUM_SUBBINS] += getSize(fragment);
+    noteModification(handle, fragment);
 }
 
-bool o1heapDoInvariantsHold(const O1HeapInstance* const handle)
+/// Removes the specified fragment from its bin.
+O1HEAP_PRIVATE void unbin(O1HeapInstance* const handle, const Fragment* const fragment)
 {
     O1HEAP_ASSERT(handle != NULL);
-    bool valid = true;
-
-    // Check the bin mask consistency.
-    for (size_t i = 0; i < NUM_BINS_MAX; i++)  // Dear compiler, feel free to unroll this loop.
+    O1HEAP_ASSERT(fragment != NULL);
+    O1HEAP_ASSERT(getSize(fragment) >= FRAGMENT_SIZE_MIN);
+    O1HEAP_ASSERT((getSize(fragment) % FRAGMENT_SIZE_MIN) == 0U);
+    const size_t idx = getBinIndex(getSize(fragment));  // Round DOWN when removing.
+    O1HEAP_ASSERT(idx < (NUM_BINS_MAX * NUM_SUBBINS));
+    Fragment* const head = handle->bins[idx];
+    Fragment* const next = getNextFree(fragment);
+    Fragment* const prev = getPrevFree(fragment);  // The last fragment in the bin if this is the first one.
+    O1HEAP_ASSERT((head != NULL) && (prev != NULL));
+    if (O1HEAP_LIKELY(head == fragment))
     {
-        const bool mask_bit_set = (handle->nonempty_bin_mask & pow2((uint_fast8_t) i)) != 0U;
-        const bool bin_nonempty = handle->bins[i] != NULL;
-        valid                   = valid && (mask_bit_set == bin_nonempty);
-    }
+        // Update the bin header.
+        handle->bins[idx] = next;
+        if (O1HEAP_LIKELY(next == NULL))
+        {
+            O1HEAP_ASSERT(prev == fragment);
+#if O1HEAP_SUBBIN_BITS > 0U
+            handle->nonempty_subbin_mask[idx / NUM_SUBBINS] &= ~(((uint32_t) 1U) << (idx % NUM_SUBBINS));
+            if (handle->nonempty_subbin_mask[idx / NUM_SUBBINS] == 0U)
+#endif
+            {
+                handle->nonempty_bin_mask &= ~pow2((uint_fast8_t) (idx / NUM_SUBBINS));
+                updateLargestAllocatable(handle);
+            }
+        }
+        else
+        {
+            setPrevFree(next, prev);  // The new first fragment points back to the last one.
+        }
+    }
+    else
+    {
+        // Remove the fragment from the middle or the end of the free fragment list.
+        setNextFree(prev, next);
+        setPrevFree((next != NULL) ? next : head, prev);
+    }
+    O1HEAP_ASSERT(handle->fragmentation.free_fragment_count[idx / NUM_SUBBINS] > 0U);
+    O1HEAP_ASSERT(handle->fragmentation.free_fragment_size[idx / NUM_SUBBINS] >= getSize(fragment));
+    handle->fragmentation.free_fragment_count[idx / NUM_SUBBINS]--;
+    handle->fragmentation.free_fragment_size[idx / NUM_SUBBINS] -= getSize(fragment);
+    noteModification(handle, fragment);
+}
+
+/// Invalidates the header of a fragment that has been merged into its left neighbor to prevent double-free.
+/// If the incremental validation or compaction was about to visit the dropped fragment, it proceeds from the neighbor
+/// instead.
+O1HEAP_PRIVATE void drop(O1HeapInstance* const handle, Fragment* const fragment, const Fragment* const neighbor)
+{
+    O1HEAP_ASSERT(handle != NULL);
+    O1HEAP_ASSERT((fragment != NULL) && (neighbor != NULL));
+    O1HEAP_ASSERT(((size_t) neighbor) < ((size_t) fragment));
+    setSize(fragment, 0U);
+    if (handle->validation.fragment == fragment)
+    {
+        handle->validation.fragment = neighbor;
+    }
+    if (handle->movable.fragment == fragment)
+    {
+        handle->movable.fragment = (Fragment*) neighbor;
+    }
+}
+
+/// The root fragment is placed past the header (the instance or the region) such that the allocated memory is aligned
+/// at FRAGMENT_SIZE_MIN rather than just O1HEAP_ALIGNMENT, which enables o1heapAllocateAligned().
+/// This may cost O1HEAP_ALIGNMENT bytes.
+O1HEAP_PRIVATE size_t getRootFragmentOffset(const void* const base, const size_t header_size)
+{
+    size_t out = header_size;
+    if (((((size_t) base) + out + O1HEAP_ALIGNMENT) % FRAGMENT_SIZE_MIN) != 0U)
+    {
+        out += O1HEAP_ALIGNMENT;
+    }
+    return out;
+}
+
+/// Empties all bins; the free memory statistics are zeroed accordingly.
+O1HEAP_PRIVATE void clearBins(O1HeapInstance* const handle)
+{
+    O1HEAP_ASSERT(handle != NULL);
+    handle->nonempty_bin_mask = 0U;
+    for (size_t i = 0; i < (NUM_BINS_MAX * NUM_SUBBINS); i++)
+    {
+        handle->bins[i] = NULL;
+    }
+    for (size_t i = 0; i < NUM_BINS_MAX; i++)
+    {
+#if O1HEAP_SUBBIN_BITS > 0U
+        handle->nonempty_subbin_mask[i] = 0U;
+#endif
+        handle->fragmentation.free_fragment_count[i] = 0U;
+        handle->fragmentation.free_fragment_size[i]  = 0U;
+    }
+    handle->diagnostics.largest_allocatable = 0U;
+}
+
+/// Makes the specified fragment the only one in its region (the instance or an additional region) and bins it.
+O1HEAP_PRIVATE void initRootFragment(O1HeapInstance* const handle, Fragment* const frag, const size_t capacity)
+{
+    O1HEAP_ASSERT(handle != NULL);
+    O1HEAP_ASSERT(frag != NULL);
+    O1HEAP_ASSERT((((size_t) frag) % O1HEAP_ALIGNMENT) == 0U);
+    O1HEAP_ASSERT(((((size_t) frag) + O1HEAP_ALIGNMENT) % FRAGMENT_SIZE_MIN) == 0U);
+    O1HEAP_ASSERT((capacity >= FRAGMENT_SIZE_MIN) && ((capacity % FRAGMENT_SIZE_MIN) == 0U));
+    setNext(frag, NULL);
+    setPrev(frag, NULL);
+    setSize(frag, capacity);
+    setUsed(frag, false);
+    setZeroed(frag, false);
+    rebin(handle, frag);
+}
+
+/// Checks up to O1HEAP_FLOOR_PROBE_LIMIT fragments at the head of the bin where the specified size belongs
+/// (the floor bin) and returns the first one that is at least as large, without removing it from the bin.
+/// Returns NULL if there is no such fragment, if the size is the lower bound of its bin (then every fragment in the bin
+/// fits, so there is nothing to probe), or if the probing is disabled. Updates the probe diagnostics.
+O1HEAP_PRIVATE Fragment* probeFloorBin(O1HeapInstance* const handle, const size_t size)
+{
+    O1HEAP_ASSERT(handle != NULL);
+    Fragment* out = NULL;
+#if O1HEAP_FLOOR_PROBE_LIMIT > 0U
+    if (O1HEAP_LIKELY((size <= FRAGMENT_SIZE_MAX) && (roundUpToBin(size) != size)))
+    {
+        Fragment* frag = handle->bins[getBinIndex(size)];
+        if (frag != NULL)
+        {
+            handle->diagnostics.floor_probe_count++;
+            for (size_t i = 0U; (i < O1HEAP_FLOOR_PROBE_LIMIT) && (frag != NULL) && (out == NULL); i++)
+            {
+                O1HEAP_ASSERT(!isUsed(frag));
+                if (getSize(frag) >= size)
+                {
+                    out = frag;
+                }
+                frag = getNextFree(frag);
+            }
+        }
+        if (out != NULL)
+        {
+            handle->diagnostics.floor_probe_hit_count++;
+        }
+    }
+#else
+    (void) handle;
+    (void) size;
+#endif
+    return out;
+}
+
+/// Takes the first fragment from the smallest non-empty bin where every fragment is at least as large as the
+/// specified size, and removes it from the bin. Returns NULL if there is no such fragment.
+/// If the floor bin probing is enabled, the result may be smaller than roundUpToBin(size); see probeFloorBin().
+O1HEAP_PRIVATE Fragment* takeFreeBinned(O1HeapInstance* const handle, const size_t size)
+{
+    O1HEAP_ASSERT(handle != NULL);
+    O1HEAP_ASSERT(size >= FRAGMENT_SIZE_MIN);
+    O1HEAP_ASSERT((size % FRAGMENT_SIZE_MIN) == 0U);
+    Fragment* out = probeFloorBin(handle, size);
+
+    // Fragments larger than FRAGMENT_SIZE_MAX do not exist; the check also prevents an overflow when rounding up.
+    size_t bin_index = NUM_BINS_MAX * NUM_SUBBINS;
+    if (O1HEAP_LIKELY((out == NULL) && (size <= FRAGMENT_SIZE_MAX)))
+    {
+        const size_t optimal_bin_index = getBinIndex(roundUpToBin(size));  // Use CEIL when fetching.
+        O1HEAP_ASSERT(optimal_bin_index < (NUM_BINS_MAX * NUM_SUBBINS));
+#if O1HEAP_SUBBIN_BITS > 0U
+        // Find the smallest suitable second-level bin within the same first-level bin. If there is none,
+        // use the smallest non-empty second-level bin of the smallest non-empty first-level bin above it.
+        // Note that (pow2(fl) << 1U) - 1U wraps around to SIZE_MAX correctly if fl is the last first-level bin.
+        uint_fast8_t fl          = (uint_fast8_t) (optimal_bin_index / NUM_SUBBINS);
+        uint32_t     sl_suitable = handle->nonempty_subbin_mask[fl] & (UINT32_MAX << (optimal_bin_index % NUM_SUBBINS));
+        if (sl_suitable == 0U)
+        {
+            const size_t fl_suitable = handle->nonempty_bin_mask & ~((pow2(fl) << 1U) - 1U);
+            if (fl_suitable != 0U)
+            {
+                fl          = log2Floor(fl_suitable & ~(fl_suitable - 1U));  // Clear all bits but the lowest.
+                sl_suitable = handle->nonempty_subbin_mask[fl];
+                O1HEAP_ASSERT(sl_suitable != 0U);
+            }
+        }
+        if (O1HEAP_LIKELY(sl_suitable != 0U))
+        {
+            bin_index = (((size_t) fl) * NUM_SUBBINS) + log2Floor(sl_suitable & ~(sl_suitable - 1U));
+        }
+#else
+        // Find the smallest non-empty bin we can use.
+        const size_t suitable_bins = handle->nonempty_bin_mask & ~(pow2((uint_fast8_t) optimal_bin_index) - 1U);
+        if (O1HEAP_LIKELY(suitable_bins != 0U))
+        {
+            bin_index = log2Floor(suitable_bins & ~(suitable_bins - 1U));  // Clear all bits but the lowest.
+        }
+#endif
+        O1HEAP_ASSERT(bin_index >= optimal_bin_index);
+    }
+    if (O1HEAP_LIKELY(bin_index < (NUM_BINS_MAX * NUM_SUBBINS)))
+    {
+        // The bin we found shall not be empty, otherwise it's a state divergence (memory corruption?).
+        out = handle->bins[bin_index];
+        O1HEAP_ASSERT(out != NULL);
+    }
+    if (O1HEAP_LIKELY(out != NULL))
+    {
+        O1HEAP_ASSERT(getSize(out) >= size);
+        O1HEAP_ASSERT((getSize(out) % FRAGMENT_SIZE_MIN) == 0U);
+        O1HEAP_ASSERT(!isUsed(out));
+        unbin(handle, out);
+    }
+    return out;
+}
+
+/// Accounts for the memory allocated with the specified tag in the diagnostics, including the peaks and the reserve.
+O1HEAP_PRIVATE void addAllocated(O1HeapInstance* const handle, const uint8_t tag, const size_t size)
+{
+    O1HEAP_ASSERT(handle != NULL);
+    O1HEAP_ASSERT(tag < O1HEAP_TAG_COUNT);
+    O1HEAP_ASSERT((handle->diagnostics.allocated % FRAGMENT_SIZE_MIN) == 0U);
+    handle->diagnostics.allocated += size;
+    O1HEAP_ASSERT(handle->diagnostics.allocated <= handle->diagnostics.capacity);
+    if (O1HEAP_LIKELY(handle->diagnostics.peak_allocated < handle->diagnostics.allocated))
+    {
+        handle->diagnostics.peak_allocated = handle->diagnostics.allocated;
+    }
+    if ((handle->diagnostics.capacity - handle->diagnostics.allocated) < handle->reserve)
+    {
+        handle->diagnostics.reserve_hit_count++;
+    }
+    O1HeapTagDiagnostics* const td = &handle->tag_diagnostics[tag];
+    td->allocated += size;
+    if (O1HEAP_LIKELY(td->peak_allocated < td->allocated))
+    {
+        td->peak_allocated = td->allocated;
+    }
+}
+
+/// The opposite of addAllocated().
+O1HEAP_PRIVATE void subtractAllocated(O1HeapInstance* const handle, const uint8_t tag, const size_t size)
+{
+    O1HEAP_ASSERT(handle != NULL);
+    O1HEAP_ASSERT(tag < O1HEAP_TAG_COUNT);
+    O1HEAP_ASSERT(handle->diagnostics.allocated >= size);  // Heap corruption check.
+    O1HEAP_ASSERT(handle->tag_diagnostics[tag].allocated >= size);
+    handle->diagnostics.allocated -= size;
+    handle->tag_diagnostics[tag].allocated -= size;
+}
+
+/// True if the memory use of the tag can grow by the specified size without exceeding its quota.
+O1HEAP_PRIVATE bool isWithinQuota(const O1HeapInstance* const handle, const uint8_t tag, const size_t size)
+{
+    O1HEAP_ASSERT(handle != NULL);
+    O1HEAP_ASSERT(tag < O1HEAP_TAG_COUNT);
+    const O1HeapTagDiagnostics* const td = &handle->tag_diagnostics[tag];
+    return (td->allocated <= td->quota) && (size <= (td->quota - td->allocated));
+}
+
+/// True if the request of the specified priority may allocate the specified size without intruding into the reserve.
+/// A request that exceeds the free memory is not denied here because it is going to fail regardless of the reserve.
+O1HEAP_PRIVATE bool isWithinReserve(const O1HeapInstance* const handle, const uint8_t priority, const size_t size)
+{
+    O1HEAP_ASSERT(handle != NULL);
+    const size_t free_size = handle->diagnostics.capacity - handle->diagnostics.allocated;
+    return (priority >= handle->reserve_min_priority) || (size > free_size) || ((free_size - size) >= handle->reserve);
+}
+
+/// Splits off the part of the free fragment that is not needed to accommodate the specified fragment size,
+/// marks the fragment used with the specified tag, and updates the diagnostics. The used part is carved from the low
+/// end of the fragment, or from its high end if 'top' is set (see O1HeapLifetime); the rest remains free.
+/// The fragment shall be already removed from its bin.
+/// Returns the pointer to the allocated memory.
+O1HEAP_PRIVATE void* claim(O1HeapInstance* const handle,
+                           Fragment* const       frag,
+                           const size_t          fragment_size,
+                           const uint8_t         tag,
+                           const bool            top)
+{
+    O1HEAP_ASSERT(handle != NULL);
+    O1HEAP_ASSERT(frag != NULL);
+    O1HEAP_ASSERT(!isUsed(frag));
+    O1HEAP_ASSERT(getSize(frag) >= fragment_size);
+
+    // Split the fragment if it is too large.
+    Fragment*    used     = frag;
+    const size_t leftover = getSize(frag) - fragment_size;
+    O1HEAP_ASSERT(leftover < handle->diagnostics.capacity);  // Overflow check.
+    O1HEAP_ASSERT(leftover % FRAGMENT_SIZE_MIN == 0U);       // Alignment check.
+    if (O1HEAP_LIKELY(leftover >= FRAGMENT_SIZE_MIN) && top)  // [ ------ frag ------ ] => [ frag ][ used ]
+    {
+        used = (Fragment*) (void*) (((char*) frag) + leftover);
+        O1HEAP_ASSERT(((size_t) used) % O1HEAP_ALIGNMENT == 0U);
+        setSize(used, fragment_size);
+        setUsed(used, false);
+        setZeroed(used, isZeroed(frag));
+        interlink(used, getNext(frag));
+        interlink(frag, used);
+        setSize(frag, leftover);
+        rebin(handle, frag);
+    }
+    else if (O1HEAP_LIKELY(leftover >= FRAGMENT_SIZE_MIN))  // [ ------ frag ------ ] => [ used ][ frag ]
+    {
+        Fragment* const new_frag = (Fragment*) (void*) (((char*) frag) + fragment_size);
+        O1HEAP_ASSERT(((size_t) new_frag) % O1HEAP_ALIGNMENT == 0U);
+        setSize(frag, fragment_size);
+        setSize(new_frag, leftover);
+        setUsed(new_frag, false);
+        setZeroed(new_frag, isZeroed(frag));
+        interlink(new_frag, getNext(frag));
+        interlink(frag, new_frag);
+        rebin(handle, new_frag);
+    }
+    else
+    {
+        O1HEAP_ASSERT(getSize(frag) == fragment_size);  // The fragment is used entirely.
+    }
+
+    addAllocated(handle, tag, fragment_size);
+
+    // Finalize the fragment we just allocated.
+    setUsed(used, true);
+    setTag(used, tag);
+    setMovable(used, false);
+    return ((char*) used) + O1HEAP_ALIGNMENT;
+}
+
+/// The smallest fragment that can accommodate the amount: the amount plus the overhead rounded up to
+/// FRAGMENT_SIZE_MIN but not to the bin. Used when searching for a free fragment; see probeFloorBin().
+O1HEAP_PRIVATE size_t getFragmentSizeNeeded(const size_t amount)
+{
+    return (amount + O1HEAP_ALIGNMENT + FRAGMENT_SIZE_MIN - 1U) & ~(FRAGMENT_SIZE_MIN - 1U);
+}
+
+/// Like claim() but the fragment may be smaller than the fragment size if it was found by probeFloorBin().
+/// Such fragment is claimed entirely, so the allocated size never exceeds the ordinary fragment size.
+O1HEAP_PRIVATE void* claimFit(O1HeapInstance* const handle,
+                              Fragment* const       frag,
+                              const size_t          fragment_size,
+                              const uint8_t         tag,
+                              const bool            top)
+{
+    return claim(handle, frag, (getSize(frag) < fragment_size) ? getSize(frag) : fragment_size, tag, top);
+}
+
+/// Updates the request statistics after an attempt to allocate the specified amount of memory.
+/// The pointer is the memory returned by tryAllocate() or similar, or NULL if the attempt has failed.
+/// The prefix is the amount of memory allocated on top of the request for the library's own needs, which is
+/// placed at the beginning of the memory; like the fragment header, it is not counted as the rounding waste.
+O1HEAP_PRIVATE void updateRequestDiagnostics(O1HeapInstance* const handle,
+                                             const size_t          amount,
+                                             const size_t          prefix,
+                                             const void* const     ptr)
+{
+    O1HEAP_ASSERT(handle != NULL);
+    if (O1HEAP_LIKELY(handle->diagnostics.peak_request_size < amount))
+    {
+        handle->diagnostics.peak_request_size = amount;
+    }
+    if ((handle->histogram != NULL) && (amount > 0U))
+    {
+        handle->histogram->request_count[log2Floor(amount)]++;
+    }
+    if (O1HEAP_LIKELY(ptr != NULL))
+    {
+        const size_t size = getSize((const Fragment*) (const void*) (((const char*) ptr) - O1HEAP_ALIGNMENT));
+        O1HEAP_ASSERT(size >= (amount + prefix + O1HEAP_ALIGNMENT));
+        handle->diagnostics.rounding_waste += size - amount - prefix - O1HEAP_ALIGNMENT;
+        if (handle->histogram != NULL)
+        {
+            handle->histogram->fragment_count[log2Floor(size / FRAGMENT_SIZE_MIN)]++;
+        }
+    }
+    if (O1HEAP_LIKELY((ptr == NULL) && (amount > 0U)))
+    {
+        handle->diagnostics.oom_count++;
+    }
+}
+
+/// Converts a pointer returned by the allocator into its fragment and checks it for heap corruption in debug builds.
+O1HEAP_PRIVATE Fragment* getFragment(const O1HeapInstance* const handle, void* const pointer)
+{
+    O1HEAP_ASSERT(handle != NULL);
+    O1HEAP_ASSERT(pointer != NULL);
+    Fragment* const frag = (Fragment*) (void*) (((char*) pointer) - O1HEAP_ALIGNMENT);
+    O1HEAP_ASSERT(((size_t) frag) % sizeof(Fragment*) == 0U);
+    // The bounds can only be checked cheaply if there are no additional regions.
+    O1HEAP_ASSERT((handle->regions != NULL) ||
+                  (((size_t) frag) >= (((size_t) handle) + getRootFragmentOffset(handle, INSTANCE_SIZE_PADDED))));
+    O1HEAP_ASSERT((handle->regions != NULL) ||
+                  (((size_t) frag) <= (((size_t) handle) + getRootFragmentOffset(handle, INSTANCE_SIZE_PADDED) +
+                                       handle->diagnostics.capacity - FRAGMENT_SIZE_MIN)));
+    O1HEAP_ASSERT(isUsed(frag));  // Catch double-free
+    O1HEAP_ASSERT(((size_t) getNext(frag)) % sizeof(Fragment*) == 0U);
+    O1HEAP_ASSERT(((size_t) getPrev(frag)) % sizeof(Fragment*) == 0U);
+    O1HEAP_ASSERT(getSize(frag) >= FRAGMENT_SIZE_MIN);
+    O1HEAP_ASSERT(getSize(frag) <= handle->diagnostics.capacity);
+    O1HEAP_ASSERT((getSize(frag) % FRAGMENT_SIZE_MIN) == 0U);
+    (void) handle;  // Only used in the assertion checks.
+    return frag;
+}
+
+/// Shrinks the allocated fragment in place by splitting off its tail, which is merged with the right neighbor
+/// if the latter is free. The new size shall be a multiple of FRAGMENT_SIZE_MIN not greater than the current one.
+O1HEAP_PRIVATE void shrink(O1HeapInstance* const handle, Fragment* const frag, const size_t new_size)
+{
+    O1HEAP_ASSERT(handle != NULL);
+    O1HEAP_ASSERT(frag != NULL);
+    O1HEAP_ASSERT(isUsed(frag));
+    O1HEAP_ASSERT(new_size >= FRAGMENT_SIZE_MIN);
+    O1HEAP_ASSERT((new_size % FRAGMENT_SIZE_MIN) == 0U);
+    O1HEAP_ASSERT(new_size <= getSize(frag));
+    const size_t leftover = getSize(frag) - new_size;
+    if (leftover > 0U)
+    {
+        O1HEAP_ASSERT(leftover % FRAGMENT_SIZE_MIN == 0U);
+        Fragment* const tail = (Fragment*) (void*) (((char*) frag) + new_size);
+        O1HEAP_ASSERT(((size_t) tail) % O1HEAP_ALIGNMENT == 0U);
+        Fragment* const next = getNext(frag);
+        setSize(tail, leftover);
+        setUsed(tail, false);
+        setZeroed(tail, false);
+        if ((next != NULL) && (!isUsed(next)))  // [ this ][ next ] => [ this ][ --- tail --- ]
+        {
+            unbin(handle, next);
+            setSize(tail, getSize(tail) + getSize(next));
+            drop(handle, next, tail);
+            interlink(tail, getNext(next));
+        }
+        else
+        {
+            interlink(tail, next);
+        }
+        interlink(frag, tail);
+        rebin(handle, tail);
+        setSize(frag, new_size);
+        subtractAllocated(handle, getTag(frag), leftover);
+    }
+}
+
+/// Grows the allocated fragment in place by absorbing the head of its right neighbor if the latter is free and large
+/// enough; the remainder of the neighbor, if any, is returned to the heap. Returns false if growing is not possible.
+O1HEAP_PRIVATE bool grow(O1HeapInstance* const handle, Fragment* const frag, const size_t new_size)
+{
+    O1HEAP_ASSERT(handle != NULL);
+    O1HEAP_ASSERT(frag != NULL);
+    O1HEAP_ASSERT(isUsed(frag));
+    O1HEAP_ASSERT((new_size % FRAGMENT_SIZE_MIN) == 0U);
+    O1HEAP_ASSERT(new_size > getSize(frag));
+    const size_t    increment = new_size - getSize(frag);
+    Fragment* const next      = getNext(frag);
+    const bool      ok        = (next != NULL) && (!isUsed(next)) && (getSize(next) >= increment);
+    if (ok)
+    {
+        noteModification(handle, frag);  // The fragment extends past its former end, possibly into the frame.
+        unbin(handle, next);
+        const size_t    leftover = getSize(next) - increment;
+        Fragment* const after    = getNext(next);
+        drop(handle, next, frag);
+        O1HEAP_ASSERT(leftover % FRAGMENT_SIZE_MIN == 0U);
+        if (O1HEAP_LIKELY(leftover >= FRAGMENT_SIZE_MIN))  // [ this ][ - next - ] => [ -- this -- ][ next ]
+        {
+            Fragment* const new_frag = (Fragment*) (void*) (((char*) frag) + new_size);
+            O1HEAP_ASSERT(((size_t) new_frag) % O1HEAP_ALIGNMENT == 0U);
+            setSize(new_frag, leftover);
+            setUsed(new_frag, false);
+            setZeroed(new_frag, isZeroed(next));  // The header of the neighbor is not in the remainder.
+            interlink(new_frag, after);
+            interlink(frag, new_frag);
+            rebin(handle, new_frag);
+        }
+        else  // [ this ][ next ] => [ --- this --- ]
+        {
+            interlink(frag, after);
+        }
+        setSize(frag, new_size);
+        addAllocated(handle, getTag(frag), increment);
+    }
+    return ok;
+}
+
+/// Returns the allocated fragment to the heap, merging it with its free neighbors.
+O1HEAP_PRIVATE void release(O1HeapInstance* const handle, Fragment* const frag)
+{
+    O1HEAP_ASSERT(handle != NULL);
+    O1HEAP_ASSERT(frag != NULL);
+    O1HEAP_ASSERT(isUsed(frag));
+
+    // Even if we're going to drop the fragment later, mark it free anyway to prevent double-free.
+    setUsed(frag, false);
+    setZeroed(frag, false);
+
+    // Update the diagnostics. It must be done before merging because it invalidates the fragment size information.
+    subtractAllocated(handle, getTag(frag), getSize(frag));
+    noteModification(handle, frag);  // The fragment may be merged into a free neighbor within the frame.
+
+    // Merge with siblings and insert the returned fragment into the appropriate bin and update metadata.
+    Fragment* const prev       = getPrev(frag);
+    Fragment* const next       = getNext(frag);
+    const bool      join_left  = (prev != NULL) && (!isUsed(prev));
+    const bool      join_right = (next != NULL) && (!isUsed(next));
+    if (join_left && join_right)  // [ prev ][ this ][ next ] => [ ------- prev ------- ]
+    {
+        unbin(handle, prev);
+        unbin(handle, next);
+        setSize(prev, getSize(prev) + getSize(frag) + getSize(next));
+        setZeroed(prev, false);
+        drop(handle, frag, prev);
+        drop(handle, next, prev);
+        O1HEAP_ASSERT((getSize(prev) % FRAGMENT_SIZE_MIN) == 0U);
+        interlink(prev, getNext(next));
+        rebin(handle, prev);
+    }
+    else if (join_left)  // [ prev ][ this ][ next ] => [ --- prev --- ][ next ]
+    {
+        unbin(handle, prev);
+        setSize(prev, getSize(prev) + getSize(frag));
+        setZeroed(prev, false);
+        drop(handle, frag, prev);
+        O1HEAP_ASSERT((getSize(prev) % FRAGMENT_SIZE_MIN) == 0U);
+        interlink(prev, next);
+        rebin(handle, prev);
+    }
+    else if (join_right)  // [ prev ][ this ][ next ] => [ prev ][ --- this --- ]
+    {
+        unbin(handle, next);
+        setSize(frag, getSize(frag) + getSize(next));
+        drop(handle, next, frag);
+        O1HEAP_ASSERT((getSize(frag) % FRAGMENT_SIZE_MIN) == 0U);
+        interlink(frag, getNext(next));
+        rebin(handle, frag);
+    }
+    else
+    {
+        rebin(handle, frag);
+    }
+}
+
+/// Releases a bounded number of fragments queued by o1heapFreeDeferred(). This is only done by the owner of the heap.
+/// The entire lock-free stack is detached at once, so the producers do not contend with the owner for its nodes.
+O1HEAP_PRIVATE void drainDeferred(O1HeapInstance* const handle)
+{
+    O1HEAP_ASSERT(handle != NULL);
+#if ATOMICS_AVAILABLE
+    if ((handle->deferred_local == NULL) && (O1HEAP_ATOMIC_LOAD(&handle->deferred) != NULL))
+    {
+        handle->deferred_local = O1HEAP_ATOMIC_EXCHANGE(&handle->deferred, NULL);
+    }
+    size_t count = 0U;
+    while ((count < O1HEAP_DEFERRED_DRAIN_LIMIT) && (handle->deferred_local != NULL))
+    {
+        Fragment* const frag   = handle->deferred_local;
+        handle->deferred_local = getNextFree(frag);
+        release(handle, frag);
+        count++;
+    }
+    if (count > 0U)
+    {
+        (void) O1HEAP_ATOMIC_FETCH_SUB(&handle->diagnostics.deferred_depth, count);
+    }
+#else
+    O1HEAP_ASSERT(handle->deferred_local == NULL);
+    (void) handle;
+#endif
+}
+
+/// Coalesces the most recently freed fragment that awaits coalescing with its neighbors and rebins it.
+O1HEAP_PRIVATE void releasePending(O1HeapInstance* const handle)
+{
+    O1HEAP_ASSERT(handle != NULL);
+    O1HEAP_ASSERT(handle->pending != NULL);
+    O1HEAP_ASSERT(handle->diagnostics.pending_depth > 0U);
+    Fragment* const frag = handle->pending;
+    handle->pending      = getNextFree(frag);
+    handle->diagnostics.pending_depth--;
+    release(handle, frag);
+}
+
+/// Same as takeFreeBinned() but if there is no suitable fragment, the fragments that await coalescing are released
+/// one by one until a suitable fragment emerges or none are left. Hence, the deferred coalescing does not cause
+/// allocation failures that would not occur if the fragments were coalesced immediately.
+O1HEAP_PRIVATE Fragment* takeFree(O1HeapInstance* const handle, const size_t size)
+{
+    Fragment* out = takeFreeBinned(handle, size);
+    while ((out == NULL) && (handle->pending != NULL))
+    {
+        releasePending(handle);
+        out = takeFreeBinned(handle, size);
+    }
+    return out;
+}
+
+/// Same as isWithinQuota() but if the quota would be exceeded, the fragments that await coalescing are released
+/// one by one until the request is within the quota or none are left, because they are still accounted for as used.
+/// Hence, the deferred coalescing does not cause quota failures that would not occur otherwise; see takeFree().
+O1HEAP_PRIVATE bool checkQuota(O1HeapInstance* const handle, const uint8_t tag, const size_t size)
+{
+    bool out = isWithinQuota(handle, tag, size);
+    while ((!out) && (handle->pending != NULL))
+    {
+        releasePending(handle);
+        out = isWithinQuota(handle, tag, size);
+    }
+    return out;
+}
+
+/// Same as checkQuota() but for the reserve; see isWithinReserve().
+O1HEAP_PRIVATE bool checkReserve(O1HeapInstance* const handle, const uint8_t priority, const size_t size)
+{
+    bool out = isWithinReserve(handle, priority, size);
+    while ((!out) && (handle->pending != NULL))
+    {
+        releasePending(handle);
+        out = isWithinReserve(handle, priority, size);
+    }
+    return out;
+}
+
+/// Attaches the region to the heap; see o1heapAddRegion().
+O1HEAP_PRIVATE bool addRegion(O1HeapInstance* const handle, void* const base, const size_t size)
+{
+    O1HEAP_ASSERT(handle != NULL);
+    O1HEAP_ASSERT(handle->diagnostics.capacity <= FRAGMENT_SIZE_MAX);
+    bool out = false;
+    if ((base != NULL) && ((((size_t) base) % O1HEAP_ALIGNMENT) == 0U) &&
+        (size >= (getRootFragmentOffset(base, REGION_SIZE_PADDED) + FRAGMENT_SIZE_MIN)))
+    {
+        // The total capacity of all regions is limited the same way as the capacity of a single-region heap.
+        const size_t root_offset = getRootFragmentOffset(base, REGION_SIZE_PADDED);
+        const size_t headroom    = FRAGMENT_SIZE_MAX - handle->diagnostics.capacity;
+        size_t       capacity    = size - root_offset;
+        if (capacity > headroom)
+        {
+            capacity = headroom;
+        }
+        capacity -= capacity % FRAGMENT_SIZE_MIN;
+        if ((capacity >= FRAGMENT_SIZE_MIN) && isWithinLinkRange(handle, base, root_offset + capacity))
+        {
+            Region* const region = (Region*) base;
+            region->next         = handle->regions;
+            region->capacity     = capacity;
+            handle->regions      = region;
+
+            // The root fragment of the region is not linked with the fragments of the other regions.
+            initRootFragment(handle, (Fragment*) (void*) (((char*) base) + root_offset), capacity);
+
+            handle->diagnostics.capacity += capacity;
+            O1HEAP_ASSERT(handle->diagnostics.capacity <= FRAGMENT_SIZE_MAX);
+            out = true;
+        }
+    }
+    return out;
+}
+
+/// Attempts to allocate the amount with the specified tag and priority; see o1heapAllocatePrioritized().
+/// If 'top' is set, the memory is carved from the high end of the free fragment; see claim().
+/// The prefix is added to the amount; see updateRequestDiagnostics(). The request statistics are not updated.
+O1HEAP_PRIVATE void* tryAllocate(O1HeapInstance* const handle,
+                                 const size_t          amount,
+                                 const size_t          prefix,
+                                 const uint8_t         tag,
+                                 const uint8_t         priority,
+                                 const bool            top)
+{
+    O1HEAP_ASSERT(handle != NULL);
+    O1HEAP_ASSERT(tag < O1HEAP_TAG_COUNT);
+    void* out = NULL;
+    // If the amount approaches approx. SIZE_MAX/2, an undetected integer overflow may occur.
+    // To avoid that, we do not attempt allocation if the amount exceeds the hard limit.
+    // We perform multiple redundant checks to account for a possible unaccounted overflow.
+    // The prefix does not exceed the header, and the capacity is at least FRAGMENT_SIZE_MIN, so there is no underflow.
+    O1HEAP_ASSERT(prefix <= O1HEAP_ALIGNMENT);
+    if (O1HEAP_LIKELY((amount > 0U) && (amount <= (handle->diagnostics.capacity - O1HEAP_ALIGNMENT - prefix))))
+    {
+        // Add the header size and align the allocation size to the power of 2 (or to the sub-bin if enabled).
+        // See "Timing-Predictable Memory Allocation In Hard Real-Time Systems", Herter, page 27.
+        const size_t fragment_size = roundUpToBin(amount + prefix + O1HEAP_ALIGNMENT);
+        O1HEAP_ASSERT(fragment_size <= FRAGMENT_SIZE_MAX);
+        O1HEAP_ASSERT(fragment_size >= FRAGMENT_SIZE_MIN);
+        O1HEAP_ASSERT(fragment_size >= amount + prefix + O1HEAP_ALIGNMENT);
+        O1HEAP_ASSERT(roundUpToBin(fragment_size) == fragment_size);  // Is the lower bound of a bin.
+
+        // The quota and the reserve are checked against the ordinary fragment size even if a smaller one is found.
+        if (!checkQuota(handle, tag, fragment_size))
+        {
+            handle->tag_diagnostics[tag].quota_fail_count++;
+        }
+        else if (!checkReserve(handle, priority, fragment_size))
+        {
+            handle->diagnostics.reserve_denial_count++;
+        }
+        else
+        {
+            // The floor bin probing may find a fragment smaller than the fragment size; see claimFit().
+            Fragment* const frag = takeFree(handle, getFragmentSizeNeeded(amount + prefix));
+            if (O1HEAP_LIKELY(frag != NULL))
+            {
+                out = claimFit(handle, frag, fragment_size, tag, top);
+            }
+        }
+    }
+    return out;
+}
+
+/// Attempts to allocate the amount at the specified alignment, which shall be a power of two that exceeds
+/// FRAGMENT_SIZE_MIN; see o1heapAllocateAligned(). The request statistics are not updated.
+O1HEAP_PRIVATE void* tryAllocateAligned(O1HeapInstance* const handle, const size_t alignment, const size_t amount)
+{
+    O1HEAP_ASSERT(handle != NULL);
+    O1HEAP_ASSERT((alignment > FRAGMENT_SIZE_MIN) && ((alignment & (alignment - 1U)) == 0U));
+    void* out = NULL;
+
+    // Same overflow considerations as in o1heapAllocate(). The alignment is limited by the heap capacity,
+    // hence the summation below cannot overflow because the capacity does not exceed FRAGMENT_SIZE_MAX.
+    if (O1HEAP_LIKELY((amount > 0U) && (amount <= (handle->diagnostics.capacity - O1HEAP_ALIGNMENT)) &&
+                      (alignment <= handle->diagnostics.capacity)))
+    {
+        const size_t fragment_size = roundUpToBin(amount + O1HEAP_ALIGNMENT);
+        O1HEAP_ASSERT(fragment_size <= FRAGMENT_SIZE_MAX);
+        O1HEAP_ASSERT(fragment_size >= FRAGMENT_SIZE_MIN);
+
+        // The allocated memory is always aligned at FRAGMENT_SIZE_MIN, so the misaligned slack preceding the
+        // aligned address is a multiple of FRAGMENT_SIZE_MIN and it is less than the alignment.
+        // The slack is returned to the heap, so it is not taken into account when checking the reserve.
+        Fragment* frag = NULL;
+        if (O1HEAP_LIKELY(checkReserve(handle, 0U, fragment_size)))
+        {
+            frag = takeFree(handle, fragment_size + (alignment - FRAGMENT_SIZE_MIN));
+        }
+        else
+        {
+            handle->diagnostics.reserve_denial_count++;
+        }
+        if (O1HEAP_LIKELY(frag != NULL))
+        {
+            const size_t misalignment = (((size_t) frag) + O1HEAP_ALIGNMENT) % alignment;
+            const size_t slack        = (misalignment > 0U) ? (alignment - misalignment) : 0U;
+            O1HEAP_ASSERT((slack % FRAGMENT_SIZE_MIN) == 0U);
+            O1HEAP_ASSERT((slack + fragment_size) <= getSize(frag));
+            if (slack > 0U)  // [ ------ frag ------ ] => [ frag ][ -- aligned -- ]
+            {
+                Fragment* const aligned = (Fragment*) (void*) (((char*) frag) + slack);
+                setSize(aligned, getSize(frag) - slack);
+                setUsed(aligned, false);
+                setZeroed(aligned, isZeroed(frag));
+                interlink(aligned, getNext(frag));
+                interlink(frag, aligned);
+                setSize(frag, slack);
+                rebin(handle, frag);  // The slack cannot be merged because the left neighbor is not free.
+                frag = aligned;
+            }
+            out = claim(handle, frag, fragment_size, 0U, false);
+            O1HEAP_ASSERT((((size_t) out) % alignment) == 0U);
+        }
+    }
+    return out;
+}
+
+/// Invokes the pressure callback unless it is missing or already running. Returns the result of the callback.
+O1HEAP_PRIVATE bool notifyPressure(O1HeapInstance* const handle, const O1HeapPressureEvent event, const size_t amount)
+{
+    O1HEAP_ASSERT(handle != NULL);
+    PressureMonitor* const pm  = &handle->pressure;
+    bool                   out = false;
+    if ((pm->callback != NULL) && (!pm->busy))
+    {
+        pm->busy = true;
+        out      = pm->callback(pm->context, event, amount);
+        pm->busy = false;
+    }
+    return out;
+}
+
+/// Reports the crossing of a watermark since the last check, if any; see o1heapSetPressureCallback().
+/// This is to be invoked when the heap is in a consistent state, i.e., before returning from a public function.
+O1HEAP_PRIVATE void checkPressure(O1HeapInstance* const handle)
+{
+    O1HEAP_ASSERT(handle != NULL);
+    PressureMonitor* const pm = &handle->pressure;
+    if ((pm->callback != NULL) && (!pm->busy))
+    {
+        if ((!pm->high) && (handle->diagnostics.allocated > pm->high_watermark))
+        {
+            pm->high = true;
+            (void) notifyPressure(handle, O1HEAP_PRESSURE_HIGH, 0U);
+        }
+        else if (pm->high && (handle->diagnostics.allocated <= pm->low_watermark))
+        {
+            pm->high = false;
+            (void) notifyPressure(handle, O1HEAP_PRESSURE_LOW, 0U);
+        }
+    }
+}
+
+/// Serves the allocation request, retrying once if the pressure callback may have freed some memory; see tryAllocate().
+/// The request is registered in the diagnostics and reported to the pressure callback without the prefix.
+O1HEAP_PRIVATE void* allocate(O1HeapInstance* const handle,
+                              const size_t          amount,
+                              const size_t          prefix,
+                              const uint8_t         tag,
+                              const uint8_t         priority,
+                              const bool            top)
+{
+    O1HEAP_ASSERT(handle != NULL);
+    O1HEAP_ASSERT(handle->diagnostics.capacity <= FRAGMENT_SIZE_MAX);
+    void* out = NULL;
+    if (O1HEAP_LIKELY(tag < O1HEAP_TAG_COUNT))
+    {
+        drainDeferred(handle);
+        out = tryAllocate(handle, amount, prefix, tag, priority, top);
+        if ((out == NULL) && (amount > 0U))
+        {
+            if (notifyPressure(handle, O1HEAP_PRESSURE_OOM, amount))
+            {
+                handle->diagnostics.oom_count++;  // The failed attempt is accounted for before the retry.
+                out = tryAllocate(handle, amount, prefix, tag, priority, top);
+            }
+        }
+        updateRequestDiagnostics(handle, amount, prefix, out);
+        checkPressure(handle);
+    }
+    return out;
+}
+
+/// Marks all entries of the table of the movable allocations vacant and restarts the compaction.
+O1HEAP_PRIVATE void vacateMovableTable(MovableTable* const table)
+{
+    O1HEAP_ASSERT(table != NULL);
+    O1HEAP_ASSERT((table->entries != NULL) || (table->count == 0U));
+    for (size_t i = 0U; i < table->count; i++)
+    {
+        table->entries[i].pointer = NULL;
+        table->entries[i].pins    = (i + 1U < table->count) ? (i + 2U) : 0U;  // The handle is the index plus one.
+    }
+    table->vacant   = (table->count > 0U) ? 1U : 0U;
+    table->live     = 0U;
+    table->fragment = NULL;
+}
+
+// ---------------------------------------- PUBLIC API IMPLEMENTATION ----------------------------------------
+
+O1HeapInstance* o1heapInit(void* const base, const size_t size)
+{
+    O1HeapInstance* out = NULL;
+    if ((base != NULL) && ((((size_t) base) % O1HEAP_ALIGNMENT) == 0U) &&
+        (size >= (getRootFragmentOffset(base, INSTANCE_SIZE_PADDED) + FRAGMENT_SIZE_MIN)))
+    {
+        // Allocate the core heap metadata structure in the beginning of the arena.
+        O1HEAP_ASSERT(((size_t) base) % sizeof(O1HeapInstance*) == 0U);
+        out                   = (O1HeapInstance*) base;
+        out->deferred         = NULL;
+        out->deferred_local   = NULL;
+        out->pending          = NULL;
+        out->regions          = NULL;
+        out->parent           = NULL;
+        out->free_list_policy     = O1HEAP_FREE_LIST_MRU;
+        out->histogram            = NULL;
+        out->reserve              = 0U;
+        out->reserve_min_priority = 0U;
+
+        out->pressure.callback       = NULL;
+        out->pressure.context        = NULL;
+        out->pressure.high_watermark = SIZE_MAX;
+        out->pressure.low_watermark  = 0U;
+        out->pressure.high           = false;
+        out->pressure.busy           = false;
+
+        out->movable.entries  = NULL;
+        out->movable.count    = 0U;
+        out->movable.vacant   = 0U;
+        out->movable.live     = 0U;
+        out->movable.fragment = NULL;
+        out->movable.region   = 0U;
+
+        out->validation.fragment   = NULL;
+        out->validation.region     = 0U;
+        out->validation.used_size  = 0U;
+        out->validation.free_size  = 0U;
+        out->validation.free_count = 0U;
+        out->validation.unmodified = false;
+        out->checkpoint.fragment   = NULL;
+        out->checkpoint.next       = NULL;
+        out->checkpoint.size       = 0U;
+        out->checkpoint.allocated  = 0U;
+        out->checkpoint.intact     = false;
+        clearBins(out);
+
+        // Limit and align the capacity.
+        const size_t root_offset = getRootFragmentOffset(base, INSTANCE_SIZE_PADDED);
+        size_t       capacity    = size - root_offset;
+        if (capacity > FRAGMENT_SIZE_MAX)
+        {
+            capacity = FRAGMENT_SIZE_MAX;
+        }
+        while ((capacity % FRAGMENT_SIZE_MIN) != 0)
+        {
+            O1HEAP_ASSERT(capacity > 0U);
+            capacity--;
+        }
+        O1HEAP_ASSERT((capacity % FRAGMENT_SIZE_MIN) == 0);
+        O1HEAP_ASSERT((capacity >= FRAGMENT_SIZE_MIN) && (capacity <= FRAGMENT_SIZE_MAX));
+
+        // Initialize the diagnostics. The free memory statistics are updated when the root fragment is binned.
+        // The statistics that are not initialized here have been zeroed by clearBins().
+        out->diagnostics.capacity              = capacity;
+        out->diagnostics.allocated             = 0U;
+        out->diagnostics.peak_allocated        = 0U;
+        out->diagnostics.peak_request_size     = 0U;
+        out->diagnostics.peak_reset_count      = 0U;
+        out->diagnostics.validation_pass_count = 0U;
+        out->diagnostics.oom_count             = 0U;
+        out->diagnostics.realloc_shrink_count  = 0U;
+        out->diagnostics.realloc_grow_count    = 0U;
+        out->diagnostics.realloc_move_count    = 0U;
+        out->diagnostics.floor_probe_count     = 0U;
+        out->diagnostics.floor_probe_hit_count = 0U;
+        out->diagnostics.reserve_hit_count     = 0U;
+        out->diagnostics.reserve_denial_count  = 0U;
+        out->diagnostics.deferred_depth        = 0U;
+        out->diagnostics.pending_depth         = 0U;
+        out->diagnostics.rounding_waste        = 0U;
+        for (size_t i = 0U; i < O1HEAP_TAG_COUNT; i++)
+        {
+            out->tag_diagnostics[i].allocated        = 0U;
+            out->tag_diagnostics[i].peak_allocated   = 0U;
+            out->tag_diagnostics[i].quota            = SIZE_MAX;
+            out->tag_diagnostics[i].quota_fail_count = 0U;
+        }
+
+        initRootFragment(out, (Fragment*) (void*) (((char*) base) + root_offset), capacity);
+        O1HEAP_ASSERT(out->nonempty_bin_mask != 0U);
+    }
+
+    return out;
+}
+
+void* o1heapAllocate(O1HeapInstance* const handle, const size_t amount)
+{
+    return o1heapAllocateTagged(handle, amount, 0U);
+}
+
+void* o1heapAllocateTagged(O1HeapInstance* const handle, const size_t amount, const uint8_t tag)
+{
+    return o1heapAllocatePrioritized(handle, amount, tag, 0U);
+}
+
+void* o1heapAllocatePrioritized(O1HeapInstance* const handle,
+                                const size_t          amount,
+                                const uint8_t         tag,
+                                const uint8_t         priority)
+{
+    return allocate(handle, amount, 0U, tag, priority, false);
+}
+
+void* o1heapAllocateHinted(O1HeapInstance* const handle, const size_t amount, const O1HeapLifetime lifetime)
+{
+    O1HEAP_ASSERT((lifetime == O1HEAP_LIFETIME_SHORT) || (lifetime == O1HEAP_LIFETIME_LONG));
+    return allocate(handle, amount, 0U, 0U, 0U, lifetime == O1HEAP_LIFETIME_LONG);
+}
+
+O1HeapInstance* o1heapInitZeroed(void* const base, const size_t size)
+{
+    O1HeapInstance* const out = o1heapInit(base, size);
+    if (out != NULL)
+    {
+        // The initialization does not write past the free list links of the root fragment.
+        Fragment* const frag = (Fragment*) (void*) (((char*) base) + getRootFragmentOffset(base, INSTANCE_SIZE_PADDED));
+        O1HEAP_ASSERT(out->bins[getBinIndex(getSize(frag))] == frag);
+        setZeroed(frag, true);
+    }
+    return out;
+}
+
+bool o1heapAddRegion(O1HeapInstance* const handle, void* const base, const size_t size)
+{
+    O1HEAP_ASSERT(handle != NULL);
+    bool out = false;
+    // The regions of a child heap are returned to its parent by o1heapChildDestroy(), so they shall come from it.
+    if (handle->parent == NULL)
+    {
+        out = addRegion(handle, base, size);
+    }
+    return out;
+}
+
+void* o1heapAllocateZeroed(O1HeapInstance* const handle, const size_t amount)
+{
+    void* const out = o1heapAllocate(handle, amount);
+    if (out != NULL)
+    {
+        // The flag is inherited from the free fragment the memory was allocated from.
+        const Fragment* const frag = getFragment(handle, out);
+        if (isZeroed(frag))
+        {
+            (void) memset(out, 0, sizeof(Fragment) - O1HEAP_ALIGNMENT);  // Only the free list links may be dirty.
+        }
+        else
+        {
+            (void) memset(out, 0, amount);
+        }
+    }
+    return out;
+}
+
+void* o1heapAllocateAligned(O1HeapInstance* const handle, const size_t alignment, const size_t amount)
+{
+    O1HEAP_ASSERT(handle != NULL);
+    O1HEAP_ASSERT(handle->diagnostics.capacity <= FRAGMENT_SIZE_MAX);
+    void* out = NULL;
+
+    const bool valid = (alignment > 0U) && ((alignment & (alignment - 1U)) == 0U);
+    if (valid && (alignment <= FRAGMENT_SIZE_MIN))
+    {
+        out = o1heapAllocate(handle, amount);  // The allocated memory is always aligned at FRAGMENT_SIZE_MIN.
+    }
+    else if (valid)
+    {
+        out = tryAllocateAligned(handle, alignment, amount);
+        if ((out == NULL) && (amount > 0U))
+        {
+            if (notifyPressure(handle, O1HEAP_PRESSURE_OOM, amount))
+            {
+                handle->diagnostics.oom_count++;  // The failed attempt is accounted for before the retry.
+                out = tryAllocateAligned(handle, alignment, amount);
+            }
+        }
+        updateRequestDiagnostics(handle, amount, 0U, out);
+        checkPressure(handle);
+    }
+    else
+    {
+        O1HEAP_ASSERT(out == NULL);  // Invalid alignment is not an allocation request, hence no diagnostics update.
+    }
+    return out;
+}
+
+size_t o1heapAllocateBatch(O1HeapInstance* const handle, const size_t amount, const size_t count, void** const out)
+{
+    O1HEAP_ASSERT(handle != NULL);
+    O1HEAP_ASSERT(handle->diagnostics.capacity <= FRAGMENT_SIZE_MAX);
+    O1HEAP_ASSERT((out != NULL) || (count == 0U));
+    size_t    num_allocated = 0U;
+    Fragment* frag          = NULL;
+
+    // Same overflow considerations as in o1heapAllocate(). The total size of the batch is limited by the capacity.
+    if (O1HEAP_LIKELY((amount > 0U) && (amount <= (handle->diagnostics.capacity - O1HEAP_ALIGNMENT)) && (count > 0U)))
+    {
+        const size_t fragment_size = roundUpToBin(amount + O1HEAP_ALIGNMENT);
+        O1HEAP_ASSERT(fragment_size <= FRAGMENT_SIZE_MAX);
+        O1HEAP_ASSERT(fragment_size >= FRAGMENT_SIZE_MIN);
+        // If the batch would intrude into the reserve, the items are allocated one by one until denied.
+        if ((count <= (handle->diagnostics.capacity / fragment_size)) &&
+            isWithinReserve(handle, 0U, fragment_size * count))
+        {
+            frag = takeFree(handle, fragment_size * count);
+        }
+        if (O1HEAP_LIKELY(frag != NULL))  // [ ------------ frag ------------ ] => [ 0 ][ 1 ][ ... ][ n-1 ][ frag ]
+        {
+            const size_t    leftover = getSize(frag) - (fragment_size * count);
+            Fragment* const after    = getNext(frag);
+            const bool      zeroed   = isZeroed(frag);
+            Fragment*       left     = NULL;
+            O1HEAP_ASSERT(leftover % FRAGMENT_SIZE_MIN == 0U);
+            for (; num_allocated < count; num_allocated++)
+            {
+                Fragment* const item = (Fragment*) (void*) (((char*) frag) + (fragment_size * num_allocated));
+                O1HEAP_ASSERT(((size_t) item) % O1HEAP_ALIGNMENT == 0U);
+                setSize(item, fragment_size);
+                setUsed(item, true);
+                setZeroed(item, false);
+                setTag(item, 0U);
+                setMovable(item, false);
+                if (left != NULL)  // The prev link of the first item is kept intact.
+                {
+                    interlink(left, item);
+                }
+                left               = item;
+                out[num_allocated] = ((char*) item) + O1HEAP_ALIGNMENT;
+            }
+            if (O1HEAP_LIKELY(leftover >= FRAGMENT_SIZE_MIN))
+            {
+                Fragment* const new_frag = (Fragment*) (void*) (((char*) frag) + (fragment_size * count));
+                setSize(new_frag, leftover);
+                setUsed(new_frag, false);
+                setZeroed(new_frag, zeroed);
+                interlink(left, new_frag);
+                interlink(new_frag, after);
+                rebin(handle, new_frag);
+            }
+            else
+            {
+                interlink(left, after);
+            }
+
+            // Update the memory use once for the entire batch; the request statistics are updated per item.
+            addAllocated(handle, 0U, fragment_size * count);
+            for (size_t i = 0U; i < count; i++)
+            {
+                updateRequestDiagnostics(handle, amount, 0U, out[i]);
+            }
+        }
+    }
+
+    // There is no single fragment to accommodate the entire batch, so fall back to allocating the items one by one.
+    if (frag == NULL)
+    {
+        for (; num_allocated < count; num_allocated++)
+        {
+            out[num_allocated] = o1heapAllocate(handle, amount);
+            if (out[num_allocated] == NULL)
+            {
+                break;
+            }
+        }
+    }
+    for (size_t i = num_allocated; i < count; i++)
+    {
+        out[i] = NULL;
+    }
+    checkPressure(handle);
+    return num_allocated;
+}
+
+void o1heapFree(O1HeapInstance* const handle, void* const pointer)
+{
+    O1HEAP_ASSERT(handle != NULL);
+    O1HEAP_ASSERT(handle->diagnostics.capacity <= FRAGMENT_SIZE_MAX);
+    drainDeferred(handle);
+    if (O1HEAP_LIKELY(pointer != NULL))  // NULL pointer is a no-op.
+    {
+#if O1HEAP_DEFERRED_COALESCING
+        // The fragment remains marked used until it is coalesced, so that its neighbors do not attempt to merge.
+        Fragment* const frag = getFragment(handle, pointer);
+        setNextFree(frag, handle->pending);
+        handle->pending = frag;
+        handle->diagnostics.pending_depth++;
+#else
+        release(handle, getFragment(handle, pointer));
+#endif
+    }
+    checkPressure(handle);
+}
+
+size_t o1heapMaintain(O1HeapInstance* const handle, const size_t max_steps)
+{
+    O1HEAP_ASSERT(handle != NULL);
+    for (size_t i = 0U; (i < max_steps) && (handle->pending != NULL); i++)
+    {
+        releasePending(handle);
+    }
+    checkPressure(handle);
+    return handle->diagnostics.pending_depth;
+}
+
+void o1heapSetFreeListPolicy(O1HeapInstance* const handle, const O1HeapFreeListPolicy policy)
+{
+    O1HEAP_ASSERT(handle != NULL);
+    O1HEAP_ASSERT((policy == O1HEAP_FREE_LIST_MRU) || (policy == O1HEAP_FREE_LIST_FIFO) ||
+                  (policy == O1HEAP_FREE_LIST_ADDRESS_ORDERED));
+    handle->free_list_policy = policy;
+}
+
+void o1heapSetRequestHistogram(O1HeapInstance* const handle, O1HeapRequestHistogram* const histogram)
+{
+    O1HEAP_ASSERT(handle != NULL);
+    handle->histogram = histogram;
+}
+
+void o1heapResetPeaks(O1HeapInstance* const handle)
+{
+    O1HEAP_ASSERT(handle != NULL);
+    handle->diagnostics.peak_allocated    = handle->diagnostics.allocated;
+    handle->diagnostics.peak_request_size = 0U;
+    handle->diagnostics.peak_reset_count++;
+    for (size_t i = 0U; i < O1HEAP_TAG_COUNT; i++)
+    {
+        handle->tag_diagnostics[i].peak_allocated = handle->tag_diagnostics[i].allocated;
+    }
+}
+
+bool o1heapSetTagQuota(O1HeapInstance* const handle, const uint8_t tag, const size_t quota)
+{
+    O1HEAP_ASSERT(handle != NULL);
+    const bool out = tag < O1HEAP_TAG_COUNT;
+    if (out)
+    {
+        handle->tag_diagnostics[tag].quota = quota;
+    }
+    return out;
+}
+
+uint8_t o1heapGetTag(const O1HeapInstance* const handle, void* const pointer)
+{
+    return getTag(getFragment(handle, pointer));
+}
+
+O1HeapTagDiagnostics o1heapGetTagDiagnostics(const O1HeapInstance* const handle, const uint8_t tag)
+{
+    O1HEAP_ASSERT(handle != NULL);
+    O1HeapTagDiagnostics out = {0U, 0U, 0U, 0U};
+    if (tag < O1HEAP_TAG_COUNT)
+    {
+        out = handle->tag_diagnostics[tag];
+    }
+    return out;
+}
+
+void o1heapSetReserve(O1HeapInstance* const handle, const size_t reserve, const uint8_t min_priority)
+{
+    O1HEAP_ASSERT(handle != NULL);
+    handle->reserve              = reserve;
+    handle->reserve_min_priority = min_priority;
+}
+
+void o1heapSetPressureCallback(O1HeapInstance* const       handle,
+                               const O1HeapPressureCallback callback,
+                               void* const                  context,
+                               const size_t                 high_watermark,
+                               const size_t                 low_watermark)
+{
+    O1HEAP_ASSERT(handle != NULL);
+    O1HEAP_ASSERT(low_watermark <= high_watermark);
+    handle->pressure.callback       = callback;
+    handle->pressure.context        = context;
+    handle->pressure.high_watermark = high_watermark;
+    handle->pressure.low_watermark  = low_watermark;
+    handle->pressure.high           = false;
+}
+
+void o1heapReset(O1HeapInstance* const handle)
+{
+    O1HEAP_ASSERT(handle != NULL);
+    clearBins(handle);
+    // There are no concurrent o1heapFreeDeferred() calls by contract, so the stack can be discarded non-atomically.
+    handle->deferred                   = NULL;
+    handle->deferred_local             = NULL;
+    handle->pending                    = NULL;
+    handle->validation.fragment        = NULL;
+    handle->checkpoint.fragment        = NULL;
+    handle->diagnostics.allocated      = 0U;
+    handle->diagnostics.deferred_depth = 0U;
+    handle->diagnostics.pending_depth  = 0U;
+    for (size_t i = 0U; i < O1HEAP_TAG_COUNT; i++)
+    {
+        handle->tag_diagnostics[i].allocated = 0U;
+    }
+    vacateMovableTable(&handle->movable);
+
+    // Each region is restored to a single free fragment; the capacity of the arena is what remains of the total.
+    size_t arena_capacity = handle->diagnostics.capacity;
+    for (Region* reg = handle->regions; reg != NULL; reg = reg->next)
+    {
+        O1HEAP_ASSERT(arena_capacity > reg->capacity);
+        arena_capacity -= reg->capacity;
+        const size_t offset = getRootFragmentOffset(reg, REGION_SIZE_PADDED);
+        initRootFragment(handle, (Fragment*) (void*) (((char*) reg) + offset), reg->capacity);
+    }
+    const size_t offset = getRootFragmentOffset(handle, INSTANCE_SIZE_PADDED);
+    initRootFragment(handle, (Fragment*) (void*) (((char*) handle) + offset), arena_capacity);
+    checkPressure(handle);
+}
+
+bool o1heapMark(O1HeapInstance* const handle)
+{
+    O1HEAP_ASSERT(handle != NULL);
+    while (handle->pending != NULL)  // The fragments queued before the checkpoint are outside of the frame.
+    {
+        releasePending(handle);
+    }
+    Checkpoint* const cp = &handle->checkpoint;
+    cp->fragment         = NULL;
+    if (O1HEAP_LIKELY(handle->nonempty_bin_mask != 0U))
+    {
+        // The frame is the first fragment of the largest non-empty bin.
+        const uint_fast8_t fl = log2Floor(handle->nonempty_bin_mask);
+#if O1HEAP_SUBBIN_BITS > 0U
+        const size_t idx = (((size_t) fl) * NUM_SUBBINS) + log2Floor(handle->nonempty_subbin_mask[fl]);
+#else
+        const size_t idx = fl;
+#endif
+        Fragment* const frag = handle->bins[idx];
+        O1HEAP_ASSERT(frag != NULL);
+        // The frame shall be at either end of its bin list, see o1heapRollback(). It may be in the middle under
+        // O1HEAP_FREE_LIST_FIFO, so it is rebinned; this happens before the checkpoint is taken.
+        unbin(handle, frag);
+        rebin(handle, frag);
+        cp->fragment  = frag;
+        cp->next      = getNext(frag);
+        cp->size      = getSize(frag);
+        cp->allocated = handle->diagnostics.allocated;
+        for (size_t i = 0U; i < O1HEAP_TAG_COUNT; i++)
+        {
+            cp->tag_allocated[i] = handle->tag_diagnostics[i].allocated;
+        }
+        cp->intact    = true;
+    }
+    return cp->fragment != NULL;
+}
+
+bool o1heapRollback(O1HeapInstance* const handle)
+{
+    O1HEAP_ASSERT(handle != NULL);
+    Checkpoint* const cp = &handle->checkpoint;
+#if ATOMICS_AVAILABLE
+    const size_t deferred_depth = O1HEAP_ATOMIC_LOAD(&handle->diagnostics.deferred_depth);
+#else
+    const size_t deferred_depth = 0U;
+#endif
+    bool pending_within_frame = true;
+    for (const Fragment* frag = handle->pending; frag != NULL; frag = getNextFree(frag))
+    {
+        pending_within_frame = pending_within_frame && isWithinFrame(cp, frag);
+    }
+    const bool out = (cp->fragment != NULL) && cp->intact && pending_within_frame && (deferred_depth == 0U);
+    if (out)
+    {
+        // The fragments that await coalescing are all within the frame, so they are discarded along with it.
+        handle->pending                   = NULL;
+        handle->diagnostics.pending_depth = 0U;
+
+        // Since the checkpoint, the bins have been modified only within the frame, which was at an end of its bin.
+        // The fragments are always inserted at either end of a bin list, so the free fragments within the frame
+        // are found at the ends of the lists, around the fragments outside of the frame that were free at the time
+        // of the checkpoint; the latter are left intact.
+        for (size_t idx = 0U; idx < (NUM_BINS_MAX * NUM_SUBBINS); idx++)
+        {
+            while ((handle->bins[idx] != NULL) && isWithinFrame(cp, handle->bins[idx]))
+            {
+                unbin(handle, handle->bins[idx]);
+            }
+            while ((handle->bins[idx] != NULL) && isWithinFrame(cp, getPrevFree(handle->bins[idx])))
+            {
+                unbin(handle, getPrevFree(handle->bins[idx]));
+            }
+        }
+        // Everything allocated within the frame is discarded by restoring the frame to its original state.
+        Fragment* const frag = cp->fragment;
+        setSize(frag, cp->size);
+        setUsed(frag, false);
+        setZeroed(frag, false);
+        interlink(frag, cp->next);
+        rebin(handle, frag);
+        O1HEAP_ASSERT(cp->intact);
+        handle->diagnostics.allocated = cp->allocated;
+        for (size_t i = 0U; i < O1HEAP_TAG_COUNT; i++)
+        {
+            handle->tag_diagnostics[i].allocated = cp->tag_allocated[i];
+        }
+        handle->validation.fragment = NULL;  // It may be within the frame, so a new pass is started.
+        handle->movable.fragment    = NULL;
+        checkPressure(handle);
+    }
+    return out;
+}
+
+bool o1heapFreeDeferred(O1HeapInstance* const handle, void* const pointer)
+{
+    O1HEAP_ASSERT(handle != NULL);
+    bool out = true;
+    if (O1HEAP_LIKELY(pointer != NULL))
+    {
+#if ATOMICS_AVAILABLE
+        // The heap may be modified concurrently, so getFragment() cannot be used (see o1heapCacheFree()).
+        Fragment* const frag = (Fragment*) (void*) (((char*) pointer) - O1HEAP_ALIGNMENT);
+        O1HEAP_ASSERT(isUsed(frag));
+        O1HEAP_ASSERT(getSize(frag) >= FRAGMENT_SIZE_MIN);
+        O1HEAP_ASSERT((getSize(frag) % FRAGMENT_SIZE_MIN) == 0U);
+        // The depth is incremented first to ensure that it does not underflow when the owner drains the stack.
+        (void) O1HEAP_ATOMIC_FETCH_ADD(&handle->diagnostics.deferred_depth, 1U);
+        Fragment* head = O1HEAP_ATOMIC_LOAD(&handle->deferred);
+        do
+        {
+            setNextFree(frag, head);
+        } while (!O1HEAP_ATOMIC_COMPARE_EXCHANGE(&handle->deferred, &head, frag));
+#else
+        (void) handle;
+        out = false;
+#endif
+    }
+    return out;
+}
+
+void o1heapFreeBatch(O1HeapInstance* const handle, void* const* const pointers, const size_t count)
+{
+    O1HEAP_ASSERT(handle != NULL);
+    O1HEAP_ASSERT(handle->diagnostics.capacity <= FRAGMENT_SIZE_MAX);
+    O1HEAP_ASSERT((pointers != NULL) || (count == 0U));
+
+    // First, mark all fragments free but keep them out of the bins. Such pending fragments are distinguished from
+    // the binned free fragments by their free list link pointing to themselves.
+    for (size_t i = 0U; i < count; i++)
+    {
+        if (pointers[i] != NULL)  // NULL pointer is a no-op.
+        {
+            Fragment* const frag = getFragment(handle, pointers[i]);
+            setUsed(frag, false);  // Duplicate pointers will trigger the double-free assertion check.
+            setZeroed(frag, false);
+            setNextFree(frag, frag);
+            subtractAllocated(handle, getTag(frag), getSize(frag));
+            noteModification(handle, frag);
+        }
+    }
+
+    // Then, starting from the leftmost fragment of every run of adjacent free fragments, merge the run in one pass
+    // and rebin the result. Each fragment is merged at most once, so the total amount of work is linear.
+    for (size_t i = 0U; i < count; i++)
+    {
+        Fragment* const frag = (pointers[i] != NULL) ? ((Fragment*) (void*) (((char*) pointers[i]) - O1HEAP_ALIGNMENT))
+                                                     : NULL;
+        Fragment* const prev = (frag != NULL) ? getPrev(frag) : NULL;
+        // Skip the fragments that have already been merged into a run or will be merged when their left neighbor is
+        // processed. The headers of the dropped fragments remain intact apart from the invalidated size.
+        const bool start = (frag != NULL) && (getSize(frag) > 0U) &&
+                           ((prev == NULL) || isUsed(prev) || (getNextFree(prev) != prev));
+        if (start)
+        {
+            O1HEAP_ASSERT(!isUsed(frag) && (getNextFree(frag) == frag));
+            Fragment* run = frag;
+            if ((prev != NULL) && (!isUsed(prev)))  // The left neighbor is an ordinary free fragment.
+            {
+                unbin(handle, prev);
+                setSize(prev, getSize(prev) + getSize(frag));
+                setZeroed(prev, false);
+                drop(handle, frag, prev);
+                interlink(prev, getNext(frag));
+                run = prev;
+            }
+            Fragment* next = getNext(run);
+            while ((next != NULL) && (!isUsed(next)))  // Either pending or an ordinary free fragment.
+            {
+                if (getNextFree(next) != next)
+                {
+                    unbin(handle, next);
+                }
+                setSize(run, getSize(run) + getSize(next));
+                drop(handle, next, run);
+                interlink(run, getNext(next));
+                next = getNext(run);
+            }
+            O1HEAP_ASSERT((getSize(run) % FRAGMENT_SIZE_MIN) == 0U);
+            rebin(handle, run);
+        }
+    }
+    checkPressure(handle);
+}
+
+void* o1heapReallocate(O1HeapInstance* const handle, void* const pointer, const size_t amount)
+{
+    O1HEAP_ASSERT(handle != NULL);
+    O1HEAP_ASSERT(handle->diagnostics.capacity <= FRAGMENT_SIZE_MAX);
+    void* out = NULL;
+    if (pointer == NULL)
+    {
+        out = o1heapAllocate(handle, amount);
+    }
+    else if (amount == 0U)
+    {
+        o1heapFree(handle, pointer);
+    }
+    else
+    {
+        Fragment* const frag     = getFragment(handle, pointer);
+        const size_t    old_size = getSize(frag);
+
+        // The same overflow considerations apply as in o1heapAllocate(). Oversized requests are handed over to it
+        // via the relocation path below so that the failure is accounted for in the diagnostics in the same way.
+        if (O1HEAP_LIKELY(amount <= (handle->diagnostics.capacity - O1HEAP_ALIGNMENT)))
+        {
+            const size_t fragment_size = roundUpToBin(amount + O1HEAP_ALIGNMENT);
+            O1HEAP_ASSERT(fragment_size <= FRAGMENT_SIZE_MAX);
+            O1HEAP_ASSERT(fragment_size >= FRAGMENT_SIZE_MIN);
+            if (fragment_size <= old_size)
+            {
+                shrink(handle, frag, fragment_size);
+                handle->diagnostics.realloc_shrink_count++;
+                out = pointer;
+            }
+            else if ((!checkQuota(handle, getTag(frag), fragment_size - old_size)) ||
+                     (!checkReserve(handle, 0U, fragment_size - old_size)))
+            {
+                O1HEAP_ASSERT(getSize(frag) == old_size);  // The relocation below will be denied as well.
+            }
+            else if (grow(handle, frag, fragment_size))
+            {
+                handle->diagnostics.realloc_grow_count++;
+                out = pointer;
+            }
+            else
+            {
+                O1HEAP_ASSERT(getSize(frag) == old_size);  // Left intact; the data will be moved below.
+            }
+            if (out != NULL)
+            {
+                updateRequestDiagnostics(handle, amount, 0U, out);
+            }
+        }
+
+        // Allocate a new fragment and move the data there. The old fragment is retained if the allocation fails.
+        if (out == NULL)
+        {
+            out = o1heapAllocateTagged(handle, amount, getTag(frag));
+            if (out != NULL)
+            {
+                const size_t old_amount = old_size - O1HEAP_ALIGNMENT;
+                (void) memcpy(out, pointer, (amount < old_amount) ? amount : old_amount);
+                o1heapFree(handle, pointer);
+                handle->diagnostics.realloc_move_count++;
+            }
+        }
+    }
+    checkPressure(handle);
+    return out;
+}
+
+bool o1heapDoInvariantsHold(const O1HeapInstance* const handle)
+{
+    O1HEAP_ASSERT(handle != NULL);
+    bool valid = true;
+
+    // Check the bin mask consistency.
+    for (size_t i = 0; i < NUM_BINS_MAX; i++)  // Dear compiler, feel free to unroll this loop.
+    {
+        const bool mask_bit_set = (handle->nonempty_bin_mask & pow2((uint_fast8_t) i)) != 0U;
+#if O1HEAP_SUBBIN_BITS > 0U
+        const uint32_t subbin_mask  = handle->nonempty_subbin_mask[i];
+        const bool     bin_nonempty = subbin_mask != 0U;
+        for (size_t j = 0; j < NUM_SUBBINS; j++)
+        {
+            const bool sub_mask_bit_set = (subbin_mask & (((uint32_t) 1U) << j)) != 0U;
+            valid = valid && (sub_mask_bit_set == (handle->bins[(i * NUM_SUBBINS) + j] != NULL));
+        }
+#else
+        const bool bin_nonempty = handle->bins[i] != NULL;
+#endif
+        valid = valid && (mask_bit_set == bin_nonempty);
+    }
+
+    // Create a local copy of the diagnostics struct.
+    const O1HeapDiagnostics diag = handle->diagnostics;
+
+    // Capacity check.
+    valid = valid && (diag.capacity <= FRAGMENT_SIZE_MAX) && (diag.capacity >= FRAGMENT_SIZE_MIN) &&
+            ((diag.capacity % FRAGMENT_SIZE_MIN) == 0U);
+
+    // Allocation info check.
+    valid = valid && (diag.allocated <= diag.capacity) && ((diag.allocated % FRAGMENT_SIZE_MIN) == 0U) &&
+            (diag.peak_allocated <= diag.capacity) && (diag.peak_allocated >= diag.allocated) &&
+            ((diag.peak_allocated % FRAGMENT_SIZE_MIN) == 0U);
+
+    // Peak request check
+    valid = valid && ((diag.peak_request_size < diag.capacity) || (diag.oom_count > 0U));
+    if ((diag.peak_request_size == 0U) && (diag.peak_reset_count == 0U))
+    {
+        valid = valid && (diag.peak_allocated == 0U) && (diag.allocated == 0U) && (diag.oom_count == 0U);
+    }
+    else if (diag.peak_request_size > 0U)
+    {
+        valid = valid &&  // Overflow on summation is possible but safe to ignore.
+                (((diag.peak_request_size + O1HEAP_ALIGNMENT) <= diag.peak_allocated) || (diag.oom_count > 0U));
+    }
+
+    // Floor probe check.
+    valid = valid && (diag.floor_probe_hit_count <= diag.floor_probe_count);
+    valid = valid && (diag.reserve_denial_count <= diag.oom_count);
+
+    // Pending coalescing check.
+    valid = valid && ((handle->pending == NULL) == (diag.pending_depth == 0U));
+
+    // Free memory statistics check.
+    for (size_t i = 0; i < NUM_BINS_MAX; i++)
+    {
+        const bool   bin_nonempty = (handle->nonempty_bin_mask & pow2((uint_fast8_t) i)) != 0U;
+        const size_t count        = handle->fragmentation.free_fragment_count[i];
+        const size_t size         = handle->fragmentation.free_fragment_size[i];
+        valid = valid && (bin_nonempty == (count > 0U)) && (bin_nonempty == (size > 0U)) &&
+                (size >= (count * (FRAGMENT_SIZE_MIN << i)));
+    }
+    if (handle->nonempty_bin_mask != 0U)
+    {
+        valid = valid && ((diag.largest_allocatable + O1HEAP_ALIGNMENT) ==
+                          (FRAGMENT_SIZE_MIN << log2Floor(handle->nonempty_bin_mask)));
+    }
+    else
+    {
+        valid = valid && (diag.largest_allocatable == 0U);
+    }
+
+    // Allocation tag statistics check.
+    size_t tag_allocated_total = 0U;
+    for (size_t i = 0; i < O1HEAP_TAG_COUNT; i++)
+    {
+        const O1HeapTagDiagnostics* const td = &handle->tag_diagnostics[i];
+        valid               = valid && (td->allocated <= td->peak_allocated) && (td->peak_allocated <= diag.capacity);
+        tag_allocated_total = tag_allocated_total + td->allocated;
+    }
+    valid = valid && (tag_allocated_total == diag.allocated);
+
+    return valid;
+}
+
+O1HeapDiagnostics o1heapGetDiagnostics(const O1HeapInstance* const handle)
+{
+    O1HEAP_ASSERT(handle != NULL);
+    O1HeapDiagnostics out = handle->diagnostics;
+#if ATOMICS_AVAILABLE
+    out.deferred_depth = O1HEAP_ATOMIC_LOAD(&handle->diagnostics.deferred_depth);  // May be updated concurrently.
+#endif
+    return out;
+}
+
+void o1heapGetFragmentation(const O1HeapInstance* const handle, O1HeapFragmentation* const out)
+{
+    O1HEAP_ASSERT(handle != NULL);
+    O1HEAP_ASSERT(out != NULL);
+    *out = handle->fragmentation;
+}
+
+// ---------------------------------------- HEAP TRAVERSAL ----------------------------------------
+
+/// Returns the first fragment of the region at the specified index, see O1HeapFragmentInfo.
+O1HEAP_PRIVATE const Fragment* getRegionFirstFragment(const O1HeapInstance* const handle,
+                                                      const size_t                region,
+                                                      const size_t                region_count)
+{
+    O1HEAP_ASSERT(handle != NULL);
+    O1HEAP_ASSERT(region <= region_count);
+    const Fragment* out = NULL;
+    if (region == 0U)
+    {
+        out = (const Fragment*) (const void*) (((const char*) handle) +
+                                               getRootFragmentOffset(handle, INSTANCE_SIZE_PADDED));
+    }
+    else
+    {
+        // The regions are listed most recent first.
+        const Region* reg = handle->regions;
+        for (size_t i = region; i < region_count; i++)
+        {
+            O1HEAP_ASSERT(reg != NULL);
+            reg = reg->next;
+        }
+        O1HEAP_ASSERT(reg != NULL);
+        out = (const Fragment*) (const void*) (((const char*) reg) + getRootFragmentOffset(reg, REGION_SIZE_PADDED));
+    }
+    O1HEAP_ASSERT(getPrev(out) == NULL);
+    return out;
+}
+
+/// Stores the value into the buffer in the little-endian byte order.
+O1HEAP_PRIVATE void storeLittleEndian(uint8_t* const destination, const uint64_t value, const size_t width)
+{
+    O1HEAP_ASSERT(destination != NULL);
+    O1HEAP_ASSERT(width <= sizeof(value));
+    for (size_t i = 0U; i < width; i++)
+    {
+        destination[i] = (uint8_t) (value >> (i * 8U));
+    }
+}
+
+/// The context of writeSnapshotRecord(); the records are written only while they fit into the buffer.
+typedef struct
+{
+    uint8_t* buffer;
+    size_t   size;
+    size_t   position;
+} SnapshotWriter;
+
+O1HEAP_PRIVATE bool writeSnapshotRecord(void* const context, const O1HeapFragmentInfo* const info)
+{
+    SnapshotWriter* const writer = (SnapshotWriter*) context;
+    O1HEAP_ASSERT((writer != NULL) && (info != NULL));
+    if ((writer->buffer != NULL) && ((writer->position + O1HEAP_SNAPSHOT_RECORD_SIZE) <= writer->size))
+    {
+        uint8_t* const record = &writer->buffer[writer->position];
+        O1HEAP_ASSERT((info->size % FRAGMENT_SIZE_MIN) == 0U);
+        storeLittleEndian(&record[0], info->offset, 8U);
+        storeLittleEndian(&record[8], info->size | (info->used ? 1U : 0U), 8U);
+        storeLittleEndian(&record[16], info->region, 4U);
+        storeLittleEndian(&record[20], info->tag, 4U);
+    }
+    writer->position += O1HEAP_SNAPSHOT_RECORD_SIZE;
+    return true;
+}
+
+size_t o1heapTraverse(const O1HeapInstance* const handle, const O1HeapTraverseCallback callback, void* const context)
+{
+    O1HEAP_ASSERT(handle != NULL);
+    O1HEAP_ASSERT(callback != NULL);
+    size_t region_count = 0U;
+    for (const Region* reg = handle->regions; reg != NULL; reg = reg->next)
+    {
+        region_count++;
+    }
+    size_t out     = 0U;
+    bool   proceed = true;
+    for (size_t region = 0U; proceed && (region <= region_count); region++)
+    {
+        const Fragment* const first = getRegionFirstFragment(handle, region, region_count);
+        for (const Fragment* frag = first; proceed && (frag != NULL); frag = getNext(frag))
+        {
+            O1HeapFragmentInfo info;
+            info.pointer = ((const char*) frag) + O1HEAP_ALIGNMENT;
+            info.offset  = (size_t) (((const char*) frag) - ((const char*) first));
+            info.size    = getSize(frag);
+            info.region  = region;
+            info.used    = isUsed(frag);
+            info.tag     = info.used ? getTag(frag) : 0U;
+            proceed      = callback(context, &info);
+            out++;
+        }
+    }
+    return out;
+}
+
+size_t o1heapSnapshot(const O1HeapInstance* const handle, void* const buffer, const size_t size)
+{
+    O1HEAP_ASSERT(handle != NULL);
+    SnapshotWriter writer;
+    writer.buffer   = (uint8_t*) buffer;
+    writer.size     = size;
+    writer.position = O1HEAP_SNAPSHOT_HEADER_SIZE;  // The header is written last, once the record count is known.
+
+    const size_t   count  = o1heapTraverse(handle, &writeSnapshotRecord, &writer);
+    uint8_t* const header = writer.buffer;
+    if ((header != NULL) && (writer.position <= size))
+    {
+        storeLittleEndian(&header[0], O1HEAP_SNAPSHOT_MAGIC, 4U);
+        storeLittleEndian(&header[4], O1HEAP_SNAPSHOT_VERSION, 4U);
+        storeLittleEndian(&header[8], handle->diagnostics.capacity, 8U);
+        storeLittleEndian(&header[16], handle->diagnostics.allocated, 8U);
+        storeLittleEndian(&header[24], count, 8U);
+        storeLittleEndian(&header[32], O1HEAP_ALIGNMENT, 4U);
+        storeLittleEndian(&header[36], 0U, 4U);
+    }
+    return writer.position;
+}
+
+/// True if the size is valid for a fragment of the heap. The size shall be checked before its bin index is computed,
+/// because getBinIndex() asserts the validity of its argument, whereas corrupted sizes are to be reported instead.
+O1HEAP_PRIVATE bool isValidFragmentSize(const O1HeapInstance* const handle, const size_t size)
+{
+    O1HEAP_ASSERT(handle != NULL);
+    return (size >= FRAGMENT_SIZE_MIN) && ((size % FRAGMENT_SIZE_MIN) == 0U) && (size <= handle->diagnostics.capacity);
+}
+
+/// Checks the linkage of the fragment with its neighbors, the coalescing of free fragments, and the membership
+/// of the fragment in its bin (if it is free). Only the fragment and its immediate neighbors are accessed.
+/// The checks are ordered such that a corruption is reported rather than trips an assertion check.
+O1HEAP_PRIVATE bool validateFragment(const O1HeapInstance* const handle, const Fragment* const frag)
+{
+    O1HEAP_ASSERT((handle != NULL) && (frag != NULL));
+    const size_t          size = getSize(frag);
+    const Fragment* const next = getNext(frag);
+    const Fragment* const prev = getPrev(frag);
+
+    bool valid = isValidFragmentSize(handle, size);
+    // The neighbors are adjacent and link back to this fragment.
+    valid = valid && ((next == NULL) || ((((const char*) frag) + size) == ((const char*) next)));
+    valid = valid && ((next == NULL) || (getPrev(next) == frag));
+    valid = valid && ((prev == NULL) || ((((size_t) prev) < ((size_t) frag)) && (getNext(prev) == frag)));
+    valid = valid && ((prev == NULL) || ((((const char*) prev) + getSize(prev)) == ((const char*) frag)));
+    valid = valid && ((!isUsed(frag)) || (getTag(frag) < O1HEAP_TAG_COUNT));
+    if (valid && (!isUsed(frag)))
+    {
+        // Adjacent free fragments are always merged.
+        valid = ((next == NULL) || isUsed(next)) && ((prev == NULL) || isUsed(prev));
+        // The fragment is linked into the list of its bin; the first fragment of the list points back to the last one.
+        const size_t          idx       = getBinIndex(size);
+        const Fragment* const head      = handle->bins[idx];
+        const Fragment* const prev_free = getPrevFree(frag);
+        const Fragment* const next_free = getNextFree(frag);
+        valid = valid && ((handle->nonempty_bin_mask & pow2((uint_fast8_t) (idx / NUM_SUBBINS))) != 0U);
+#if O1HEAP_SUBBIN_BITS > 0U
+        const uint32_t subbin_mask = handle->nonempty_subbin_mask[idx / NUM_SUBBINS];
+        valid = valid && ((subbin_mask & (((uint32_t) 1U) << (idx % NUM_SUBBINS))) != 0U);
+#endif
+        valid = valid && (head != NULL) && (prev_free != NULL) && (!isUsed(prev_free)) &&
+                isValidFragmentSize(handle, getSize(prev_free)) && (getBinIndex(getSize(prev_free)) == idx);
+        valid = valid && ((head == frag) ? (getNextFree(prev_free) == NULL) : (getNextFree(prev_free) == frag));
+        valid = valid && ((next_free != NULL) || (getPrevFree(head) == frag));
+        valid = valid && ((next_free == NULL) ||
+                          ((!isUsed(next_free)) && (getPrevFree(next_free) == frag) &&
+                           isValidFragmentSize(handle, getSize(next_free)) &&
+                           (getBinIndex(getSize(next_free)) == idx)));
+    }
+    return valid;
+}
+
+bool o1heapValidateStep(O1HeapInstance* const handle, const size_t max_fragments)
+{
+    O1HEAP_ASSERT(handle != NULL);
+    ValidationCursor* const cursor       = &handle->validation;
+    size_t                  region_count = 0U;
+    for (const Region* reg = handle->regions; reg != NULL; reg = reg->next)
+    {
+        region_count++;
+    }
+    bool valid = true;
+    for (size_t i = 0U; valid && (i < max_fragments); i++)
+    {
+        if (cursor->fragment == NULL)  // Start a new pass.
+        {
+            cursor->fragment   = getRegionFirstFragment(handle, 0U, region_count);
+            cursor->region     = 0U;
+            cursor->used_size  = 0U;
+            cursor->free_size  = 0U;
+            cursor->free_count = 0U;
+            cursor->unmodified = true;
+        }
+        const Fragment* const frag = cursor->fragment;
+        valid                      = validateFragment(handle, frag);
+        if (isUsed(frag))
+        {
+            cursor->used_size += getSize(frag);
+        }
+        else
+        {
+            cursor->free_size += getSize(frag);
+            cursor->free_count++;
+        }
+        cursor->fragment = getNext(frag);
+        if ((cursor->fragment == NULL) && (cursor->region < region_count))  // Proceed to the next region.
+        {
+            cursor->region++;
+            cursor->fragment = getRegionFirstFragment(handle, cursor->region, region_count);
+        }
+        if (cursor->fragment == NULL)  // End of the pass.
+        {
+            // The totals are only comparable if the heap has not been modified since the beginning of the pass.
+            if (cursor->unmodified)
+            {
+                size_t free_count = 0U;
+                for (size_t k = 0U; k < NUM_BINS_MAX; k++)
+                {
+                    free_count += handle->fragmentation.free_fragment_count[k];
+                }
+                valid = valid && (cursor->used_size == handle->diagnostics.allocated) &&
+                        ((cursor->used_size + cursor->free_size) == handle->diagnostics.capacity) &&
+                        (cursor->free_count == free_count);
+            }
+            handle->diagnostics.validation_pass_count++;
+        }
+    }
+    if (!valid)
+    {
+        cursor->fragment = NULL;  // The links cannot be trusted, so the next pass starts over.
+    }
+    return valid;
+}
+
+// ---------------------------------------- MOVABLE ALLOCATIONS ----------------------------------------
+
+/// Returns the table entry of the movable allocation given its handle, which shall be valid.
+O1HEAP_PRIVATE O1HeapMovableEntry* getMovableEntry(const O1HeapInstance* const handle, const O1HeapMovable movable)
+{
+    O1HEAP_ASSERT(handle != NULL);
+    O1HEAP_ASSERT((movable > 0U) && (movable <= handle->movable.count));
+    O1HeapMovableEntry* const out = &handle->movable.entries[movable - 1U];
+    O1HEAP_ASSERT(out->pointer != NULL);  // Catch the use of a vacant entry.
+    return out;
+}
+
+/// The handle of a movable allocation is stored in the first O1HEAP_ALIGNMENT bytes of its memory, which are
+/// hidden from the application; this is how the table entry is found when the fragment is moved.
+O1HEAP_PRIVATE O1HeapMovable* getMovableHandleSlot(Fragment* const frag)
+{
+    O1HEAP_ASSERT(frag != NULL);
+    O1HEAP_ASSERT(isUsed(frag) && isMovable(frag));
+    return (O1HeapMovable*) (void*) (((char*) frag) + O1HEAP_ALIGNMENT);
+}
+
+/// Moves the used fragment that follows the free fragment to the address of the latter; the free fragment is moved
+/// past the used one and merged with its right neighbor if it is also free. Returns the resulting free fragment.
+O1HEAP_PRIVATE Fragment* slide(O1HeapInstance* const handle, Fragment* const free_frag, Fragment* const used_frag)
+{
+    O1HEAP_ASSERT(handle != NULL);
+    O1HEAP_ASSERT((free_frag != NULL) && (!isUsed(free_frag)));
+    O1HEAP_ASSERT((used_frag != NULL) && isUsed(used_frag) && isMovable(used_frag));
+    O1HEAP_ASSERT(getNext(free_frag) == used_frag);
+    // The headers are going to be overwritten, so everything needed is read beforehand.
+    const size_t    free_size = getSize(free_frag);
+    const size_t    used_size = getSize(used_frag);
+    const uint8_t   tag       = getTag(used_frag);
+    Fragment* const prev      = getPrev(free_frag);
+    Fragment* const after     = getNext(used_frag);
+    noteModification(handle, used_frag);  // The right neighbor of the frame must not move, see o1heapRollback().
+    unbin(handle, free_frag);
+
+    // The memory may overlap if the free fragment is smaller than the used one.
+    Fragment* const moved = free_frag;
+    (void) memmove(((char*) moved) + O1HEAP_ALIGNMENT,
+                   ((const char*) used_frag) + O1HEAP_ALIGNMENT,
+                   used_size - O1HEAP_ALIGNMENT);
+    setSize(moved, used_size);
+    setUsed(moved, true);
+    setZeroed(moved, false);
+    setTag(moved, tag);
+    setMovable(moved, true);
+
+    Fragment* const rest = (Fragment*) (void*) (((char*) moved) + used_size);
+    O1HEAP_ASSERT(((size_t) rest) % O1HEAP_ALIGNMENT == 0U);
+    setSize(rest, free_size);
+    setUsed(rest, false);
+    setZeroed(rest, false);
+    interlink(prev, moved);
+    interlink(moved, rest);
+    interlink(rest, after);
+    if ((after != NULL) && (!isUsed(after)))
+    {
+        unbin(handle, after);
+        setSize(rest, free_size + getSize(after));
+        drop(handle, after, rest);
+        interlink(rest, getNext(after));
+    }
+    rebin(handle, rest);
+
+    if (handle->validation.fragment == used_frag)  // The header at the old address is no longer valid.
+    {
+        handle->validation.fragment = moved;
+    }
+    O1HeapMovableEntry* const entry = getMovableEntry(handle, *getMovableHandleSlot(moved));
+    O1HEAP_ASSERT(entry->pointer == (((char*) used_frag) + (O1HEAP_ALIGNMENT * 2U)));
+    O1HEAP_ASSERT(entry->pins == 0U);
+    entry->pointer = ((char*) moved) + (O1HEAP_ALIGNMENT * 2U);
+    return rest;
+}
+
+bool o1heapSetMovableTable(O1HeapInstance* const handle, O1HeapMovableEntry* const entries, const size_t count)
+{
+    O1HEAP_ASSERT(handle != NULL);
+    MovableTable* const table = &handle->movable;
+    const bool          out   = table->live == 0U;
+    if (out)
+    {
+        table->entries = (count > 0U) ? entries : NULL;
+        table->count   = (entries != NULL) ? count : 0U;
+        vacateMovableTable(table);
+    }
+    return out;
+}
+
+O1HeapMovable o1heapAllocateMovable(O1HeapInstance* const handle, const size_t amount)
+{
+    O1HEAP_ASSERT(handle != NULL);
+    MovableTable* const table = &handle->movable;
+    O1HeapMovable       out   = 0U;
+    if (table->vacant != 0U)
+    {
+        // The hidden handle is accounted for as a part of the per-fragment overhead rather than of the request.
+        void* const memory = allocate(handle, amount, O1HEAP_ALIGNMENT, 0U, 0U, false);
+        if ((memory != NULL) && (table->vacant == 0U))  // The pressure callback has taken the last vacant entry.
+        {
+            o1heapFree(handle, memory);
+        }
+        else if (memory != NULL)
+        {
+            out                             = table->vacant;
+            O1HeapMovableEntry* const entry = &table->entries[out - 1U];
+            O1HEAP_ASSERT(entry->pointer == NULL);
+            table->vacant = entry->pins;
+            table->live++;
+            Fragment* const frag = getFragment(handle, memory);
+            setMovable(frag, true);
+            *getMovableHandleSlot(frag) = out;
+            entry->pointer              = ((char*) memory) + O1HEAP_ALIGNMENT;
+            entry->pins                 = 0U;
+        }
+    }
+    return out;
+}
+
+void o1heapFreeMovable(O1HeapInstance* const handle, const O1HeapMovable movable)
+{
+    O1HEAP_ASSERT(handle != NULL);
+    if (O1HEAP_LIKELY(movable != 0U))
+    {
+        MovableTable* const       table = &handle->movable;
+        O1HeapMovableEntry* const entry = getMovableEntry(handle, movable);
+        O1HEAP_ASSERT(entry->pins == 0U);
+        void* const     memory = ((char*) entry->pointer) - O1HEAP_ALIGNMENT;
+        Fragment* const frag   = getFragment(handle, memory);
+        O1HEAP_ASSERT(isMovable(frag) && (*getMovableHandleSlot(frag) == movable));
+        // The fragment may await coalescing marked used under O1HEAP_DEFERRED_COALESCING; it shall not be moved.
+        setMovable(frag, false);
+        entry->pointer = NULL;
+        entry->pins    = table->vacant;
+        table->vacant  = movable;
+        O1HEAP_ASSERT(table->live > 0U);
+        table->live--;
+        o1heapFree(handle, memory);
+    }
+}
+
+void* o1heapPin(O1HeapInstance* const handle, const O1HeapMovable movable)
+{
+    O1HeapMovableEntry* const entry = getMovableEntry(handle, movable);
+    entry->pins++;
+    return entry->pointer;
+}
+
+void o1heapUnpin(O1HeapInstance* const handle, const O1HeapMovable movable)
+{
+    O1HeapMovableEntry* const entry = getMovableEntry(handle, movable);
+    O1HEAP_ASSERT(entry->pins > 0U);
+    entry->pins--;
+}
+
+size_t o1heapCompactStep(O1HeapInstance* const handle, const size_t max_steps)
+{
+    O1HEAP_ASSERT(handle != NULL);
+    MovableTable* const table        = &handle->movable;
+    size_t              region_count = 0U;
+    for (const Region* reg = handle->regions; reg != NULL; reg = reg->next)
+    {
+        region_count++;
+    }
+    size_t out = 0U;
+    for (size_t i = 0U; (i < max_steps) && (table->live > 0U); i++)
+    {
+        if (table->fragment == NULL)  // Start a new pass.
+        {
+            table->fragment = (Fragment*) getRegionFirstFragment(handle, 0U, region_count);
+            table->region   = 0U;
+        }
+        Fragment* const frag = table->fragment;
+        Fragment* const next = getNext(frag);
+        if ((!isUsed(frag)) && (next != NULL) && isUsed(next) && isMovable(next) &&
+            (getMovableEntry(handle, *getMovableHandleSlot(next))->pins == 0U))
+        {
+            table->fragment = slide(handle, frag, next);  // The free fragment may slide further on the next step.
+            out++;
+        }
+        else
+        {
+            table->fragment = next;
+            if ((table->fragment == NULL) && (table->region < region_count))  // Proceed to the next region.
+            {
+                table->region++;
+                table->fragment = (Fragment*) getRegionFirstFragment(handle, table->region, region_count);
+            }
+        }
+    }
+    return out;
+}
 
-    // Create a local copy of the diagnostics struct.
-    const O1HeapDiagnostics diag = handle->diagnostics;
+// ---------------------------------------- THREAD CACHE ----------------------------------------
 
-    // Capacity check.
-    valid = valid && (diag.capacity <= FRAGMENT_SIZE_MAX) && (diag.capacity >= FRAGMENT_SIZE_MIN) &&
-            ((diag.capacity % FRAGMENT_SIZE_MIN) == 0U);
+/// Returns the index of the size class that serves the specified amount; the amount shall be cacheable.
+O1HEAP_PRIVATE size_t getCacheClass(const O1HeapCache* const cache, const size_t amount)
+{
+    O1HEAP_ASSERT(cache != NULL);
+    O1HEAP_ASSERT((amount > 0U) && (amount <= cache->max_amount));
+    const size_t out = log2Floor(roundUpToPowerOf2(amount + O1HEAP_ALIGNMENT) / FRAGMENT_SIZE_MIN);
+    O1HEAP_ASSERT(out < cache->num_classes);
+    (void) cache;  // Only used in the assertion checks.
+    return out;
+}
 
-    // Allocation info check.
-    valid = valid && (diag.allocated <= diag.capacity) && ((diag.allocated % FRAGMENT_SIZE_MIN) == 0U) &&
-            (diag.peak_allocated <= diag.capacity) && (diag.peak_allocated >= diag.allocated) &&
-            ((diag.peak_allocated % FRAGMENT_SIZE_MIN) == 0U);
+O1HeapCache* o1heapCacheInit(O1HeapInstance* const handle, const size_t max_amount, const size_t depth)
+{
+    O1HEAP_ASSERT(handle != NULL);
+    O1HeapCache* out = NULL;
+    if ((max_amount > 0U) && (max_amount <= (handle->diagnostics.capacity - O1HEAP_ALIGNMENT)) && (depth > 0U))
+    {
+        const size_t largest     = roundUpToPowerOf2(max_amount + O1HEAP_ALIGNMENT);
+        const size_t num_classes = ((size_t) log2Floor(largest / FRAGMENT_SIZE_MIN)) + 1U;
+        O1HEAP_ASSERT((num_classes > 0U) && (num_classes <= NUM_BINS_MAX));
+        // The stack storage cannot exceed the capacity; this check also prevents an overflow below.
+        if (depth <= (handle->diagnostics.capacity / (num_classes * sizeof(void*))))
+        {
+            const size_t footprint = sizeof(O1HeapCache) + (num_classes * sizeof(size_t)) +  //
+                                     (num_classes * depth * sizeof(void*));
+            out = (O1HeapCache*) o1heapAllocate(handle, footprint);
+        }
+        if (out != NULL)
+        {
+            out->heap        = handle;
+            out->max_amount  = (FRAGMENT_SIZE_MIN << (num_classes - 1U)) - O1HEAP_ALIGNMENT;
+            out->depth       = depth;
+            out->num_classes = num_classes;
+            out->fill        = (size_t*) (void*) (((char*) out) + sizeof(O1HeapCache));
+            out->stacks      = (void**) (void*) (((char*) out->fill) + (num_classes * sizeof(size_t)));
+            O1HEAP_ASSERT(out->max_amount >= max_amount);
+            for (size_t i = 0U; i < num_classes; i++)
+            {
+                out->fill[i] = 0U;
+            }
+        }
+    }
+    return out;
+}
 
-    // Peak request check
-    valid = valid && ((diag.peak_request_size < diag.capacity) || (diag.oom_count > 0U));
-    if (diag.peak_request_size == 0U)
+void o1heapCacheDestroy(O1HeapCache* const cache)
+{
+    O1HEAP_ASSERT(cache != NULL);
+    for (size_t i = 0U; i < cache->num_classes; i++)
     {
-        valid = valid && (diag.peak_allocated == 0U) && (diag.allocated == 0U) && (diag.oom_count == 0U);
+        O1HEAP_ASSERT(cache->fill[i] <= cache->depth);
+        o1heapFreeBatch(cache->heap, &cache->stacks[i * cache->depth], cache->fill[i]);
+        cache->fill[i] = 0U;
+    }
+    o1heapFree(cache->heap, cache);
+}
+
+void* o1heapCacheAllocate(O1HeapCache* const cache, const size_t amount)
+{
+    O1HEAP_ASSERT(cache != NULL);
+    void* out = NULL;
+    if (O1HEAP_LIKELY((amount > 0U) && (amount <= cache->max_amount)))
+    {
+        const size_t cls = getCacheClass(cache, amount);
+        O1HEAP_ASSERT(cache->fill[cls] <= cache->depth);
+        if (O1HEAP_LIKELY(cache->fill[cls] > 0U))
+        {
+            cache->fill[cls]--;
+            out = cache->stacks[(cls * cache->depth) + cache->fill[cls]];
+            O1HEAP_ASSERT(out != NULL);
+        }
+    }
+    return out;
+}
+
+void* o1heapCacheRefill(O1HeapCache* const cache, const size_t amount)
+{
+    O1HEAP_ASSERT(cache != NULL);
+    void* out = NULL;
+    if ((amount > 0U) && (amount <= cache->max_amount))
+    {
+        const size_t  cls   = getCacheClass(cache, amount);
+        const size_t  half  = (cache->depth + 1U) / 2U;
+        size_t* const fill  = &cache->fill[cls];
+        void** const  stack = &cache->stacks[cls * cache->depth];
+        O1HEAP_ASSERT(*fill <= cache->depth);
+        if (*fill < half)  // Request the full class size so that every fragment can serve any request of its class.
+        {
+            const size_t class_amount = (FRAGMENT_SIZE_MIN << cls) - O1HEAP_ALIGNMENT;
+            *fill += o1heapAllocateBatch(cache->heap, class_amount, half - *fill, &stack[*fill]);
+        }
+        if (O1HEAP_LIKELY(*fill > 0U))
+        {
+            (*fill)--;
+            out = stack[*fill];
+        }
     }
     else
     {
-        valid = valid &&  // Overflow on summation is possible but safe to ignore.
-                (((diag.peak_request_size + O1HEAP_ALIGNMENT) <= diag.peak_allocated) || (diag.oom_count > 0U));
+        out = o1heapAllocate(cache->heap, amount);
+    }
+    return out;
+}
+
+bool o1heapCacheFree(O1HeapCache* const cache, void* const pointer)
+{
+    O1HEAP_ASSERT(cache != NULL);
+    bool out = true;
+    if (O1HEAP_LIKELY(pointer != NULL))
+    {
+        // The heap may be modified concurrently, so getFragment() cannot be used because it checks the links,
+        // which are updated when the neighbors are freed. The size, the used flag, and the tag are only modified
+        // by the owner.
+        const Fragment* const frag = (const Fragment*) (const void*) (((const char*) pointer) - O1HEAP_ALIGNMENT);
+        O1HEAP_ASSERT(isUsed(frag));
+        O1HEAP_ASSERT(getSize(frag) >= FRAGMENT_SIZE_MIN);
+        O1HEAP_ASSERT((getSize(frag) % FRAGMENT_SIZE_MIN) == 0U);
+        const size_t cls = log2Floor(getSize(frag) / FRAGMENT_SIZE_MIN);
+        // The cache hands out untagged memory, so a tagged fragment would be charged to its tag after reuse.
+        out = (getTag(frag) == 0U) && (cls < cache->num_classes) && (cache->fill[cls] < cache->depth);
+        if (O1HEAP_LIKELY(out))
+        {
+            cache->stacks[(cls * cache->depth) + cache->fill[cls]] = pointer;
+            cache->fill[cls]++;
+        }
+    }
+    return out;
+}
+
+void o1heapCacheFlush(O1HeapCache* const cache, void* const pointer)
+{
+    O1HEAP_ASSERT(cache != NULL);
+    size_t cls = cache->num_classes;
+    if (pointer != NULL)
+    {
+        const Fragment* const frag = getFragment(cache->heap, pointer);
+        if (getTag(frag) == 0U)  // Tagged fragments bypass the cache, see o1heapCacheFree().
+        {
+            cls = log2Floor(getSize(frag) / FRAGMENT_SIZE_MIN);
+        }
+    }
+    if (cls < cache->num_classes)
+    {
+        const size_t  keep  = cache->depth / 2U;
+        size_t* const fill  = &cache->fill[cls];
+        void** const  stack = &cache->stacks[cls * cache->depth];
+        O1HEAP_ASSERT(*fill <= cache->depth);
+        if (*fill > keep)  // Release the oldest fragments because the recently used ones are likely to be cache-hot.
+        {
+            const size_t excess = *fill - keep;
+            o1heapFreeBatch(cache->heap, stack, excess);
+            for (size_t i = 0U; i < keep; i++)
+            {
+                stack[i] = stack[i + excess];
+            }
+            *fill = keep;
+        }
+        O1HEAP_ASSERT(*fill < cache->depth);
+        stack[*fill] = pointer;
+        (*fill)++;
+    }
+    else
+    {
+        o1heapFree(cache->heap, pointer);
+    }
+}
+
+// ---------------------------------------- CONCURRENT HEAP ----------------------------------------
+
+O1HEAP_PRIVATE bool tryLockShard(Shard* const shard)
+{
+    O1HEAP_ASSERT(shard != NULL);
+#if ATOMICS_AVAILABLE
+    return !O1HEAP_ATOMIC_EXCHANGE(&shard->lock, true);
+#else
+    O1HEAP_ASSERT(false);  // Unreachable because the concurrent heap cannot be initialized.
+    (void) shard;
+    return false;
+#endif
+}
+
+O1HEAP_PRIVATE void lockShard(Shard* const shard)
+{
+    while (!tryLockShard(shard))
+    {
+        // Busy-wait; the critical sections are short and bounded.
+    }
+}
+
+O1HEAP_PRIVATE void unlockShard(Shard* const shard)
+{
+    O1HEAP_ASSERT(shard != NULL);
+#if ATOMICS_AVAILABLE
+    (void) O1HEAP_ATOMIC_EXCHANGE(&shard->lock, false);
+#else
+    O1HEAP_ASSERT(false);
+    (void) shard;
+#endif
+}
+
+/// Attempts to serve the request from the shard, which shall be locked by the caller. Returns NULL if the shard
+/// cannot serve the request; the failure is not registered in the diagnostics.
+O1HEAP_PRIVATE void* allocateFromShard(Shard* const shard, const size_t amount, const size_t fragment_size)
+{
+    O1HEAP_ASSERT(shard != NULL);
+    void*           out  = NULL;
+    Fragment* const frag = takeFree(shard->heap, getFragmentSizeNeeded(amount));
+    if (frag != NULL)
+    {
+        out = claimFit(shard->heap, frag, fragment_size, 0U, false);
+        updateRequestDiagnostics(shard->heap, amount, 0U, out);
+    }
+    return out;
+}
+
+O1HeapConcurrent* o1heapConcurrentInit(void* const base, const size_t size, const size_t shard_count)
+{
+    O1HeapConcurrent* out = NULL;
+#if ATOMICS_AVAILABLE
+    if ((base != NULL) && ((((size_t) base) % O1HEAP_ALIGNMENT) == 0U) && (shard_count > 0U) &&
+        (shard_count <= (size / sizeof(Shard))))
+    {
+        const size_t footprint = (sizeof(O1HeapConcurrent) + (shard_count * sizeof(Shard)) + O1HEAP_ALIGNMENT - 1U) &
+                                 ~(O1HEAP_ALIGNMENT - 1U);
+        if (size > footprint)
+        {
+            out              = (O1HeapConcurrent*) base;
+            out->shards      = (Shard*) (void*) (((char*) base) + sizeof(O1HeapConcurrent));
+            out->shard_count = shard_count;
+            out->span        = ((size - footprint) / shard_count) & ~(O1HEAP_ALIGNMENT - 1U);
+            out->arena       = ((char*) base) + footprint;
+            for (size_t i = 0U; (i < shard_count) && (out != NULL); i++)
+            {
+                out->shards[i].heap = o1heapInit(out->arena + (i * out->span), out->span);
+                out->shards[i].lock = false;
+                if (out->shards[i].heap == NULL)
+                {
+                    out = NULL;  // The shards are too small.
+                }
+            }
+        }
+    }
+#else
+    (void) base;
+    (void) size;
+    (void) shard_count;
+#endif
+    return out;
+}
+
+void* o1heapConcurrentAllocate(O1HeapConcurrent* const handle, const size_t hint, const size_t amount)
+{
+    O1HEAP_ASSERT(handle != NULL);
+    O1HEAP_ASSERT(handle->shard_count > 0U);
+    void* out = NULL;
+
+    // The capacity is the same for all shards and it is never modified, so it can be read without locking.
+    if (O1HEAP_LIKELY((amount > 0U) && (amount <= (handle->shards[0].heap->diagnostics.capacity - O1HEAP_ALIGNMENT))))
+    {
+        const size_t fragment_size = roundUpToBin(amount + O1HEAP_ALIGNMENT);
+        O1HEAP_ASSERT(fragment_size >= FRAGMENT_SIZE_MIN);
+        // Within each group of shards, the first pass skips the shards that are busy; the second pass waits for
+        // only those that have been skipped, so a shard that has been found unable to serve the request is not
+        // locked again. Hence, each shard is visited at most twice, holding one lock at a time.
+        for (size_t base = 0U; (base < handle->shard_count) && (out == NULL); base += SHARD_GROUP_SIZE)
+        {
+            const size_t group   = ((handle->shard_count - base) < SHARD_GROUP_SIZE) ? (handle->shard_count - base)
+                                                                                     : SHARD_GROUP_SIZE;
+            size_t       skipped = 0U;
+            for (size_t i = 0U; (i < group) && (out == NULL); i++)
+            {
+                Shard* const shard = &handle->shards[(hint + base + i) % handle->shard_count];
+                if (tryLockShard(shard))
+                {
+                    out = allocateFromShard(shard, amount, fragment_size);
+                    unlockShard(shard);
+                }
+                else
+                {
+                    skipped |= pow2((uint_fast8_t) i);
+                }
+            }
+            for (size_t i = 0U; (i < group) && (out == NULL) && (skipped != 0U); i++)
+            {
+                if ((skipped & pow2((uint_fast8_t) i)) != 0U)
+                {
+                    Shard* const shard = &handle->shards[(hint + base + i) % handle->shard_count];
+                    lockShard(shard);
+                    out = allocateFromShard(shard, amount, fragment_size);
+                    unlockShard(shard);
+                }
+            }
+        }
+    }
+
+    // The failure is accounted for by the preferred shard only.
+    if (out == NULL)
+    {
+        Shard* const shard = &handle->shards[hint % handle->shard_count];
+        lockShard(shard);
+        updateRequestDiagnostics(shard->heap, amount, 0U, NULL);
+        unlockShard(shard);
+    }
+    return out;
+}
+
+void o1heapConcurrentFree(O1HeapConcurrent* const handle, void* const pointer)
+{
+    O1HEAP_ASSERT(handle != NULL);
+    if (O1HEAP_LIKELY(pointer != NULL))
+    {
+        O1HEAP_ASSERT(((char*) pointer) > handle->arena);
+        const size_t index = ((size_t) (((char*) pointer) - handle->arena)) / handle->span;
+        O1HEAP_ASSERT(index < handle->shard_count);
+        Shard* const shard = &handle->shards[index];
+        lockShard(shard);
+        o1heapFree(shard->heap, pointer);
+        unlockShard(shard);
     }
+}
 
+bool o1heapConcurrentDoInvariantsHold(O1HeapConcurrent* const handle)
+{
+    O1HEAP_ASSERT(handle != NULL);
+    bool valid = true;
+    for (size_t i = 0U; i < handle->shard_count; i++)
+    {
+        lockShard(&handle->shards[i]);
+        valid = valid && o1heapDoInvariantsHold(handle->shards[i].heap);
+        unlockShard(&handle->shards[i]);
+    }
     return valid;
 }
 
-O1HeapDiagnostics o1heapGetDiagnostics(const O1HeapInstance* const handle)
+O1HeapDiagnostics o1heapConcurrentGetDiagnostics(O1HeapConcurrent* const handle)
+{
+    O1HEAP_ASSERT(handle != NULL);
+    O1HeapDiagnostics out = {0};
+    for (size_t i = 0U; i < handle->shard_count; i++)
+    {
+        lockShard(&handle->shards[i]);
+        const O1HeapDiagnostics diag = handle->shards[i].heap->diagnostics;
+        unlockShard(&handle->shards[i]);
+        out.capacity += diag.capacity;
+        out.allocated += diag.allocated;
+        out.peak_allocated += diag.peak_allocated;
+        out.oom_count += diag.oom_count;
+        out.realloc_shrink_count += diag.realloc_shrink_count;
+        out.realloc_grow_count += diag.realloc_grow_count;
+        out.realloc_move_count += diag.realloc_move_count;
+        out.floor_probe_count += diag.floor_probe_count;
+        out.floor_probe_hit_count += diag.floor_probe_hit_count;
+        out.reserve_hit_count += diag.reserve_hit_count;
+        out.reserve_denial_count += diag.reserve_denial_count;
+        out.deferred_depth += diag.deferred_depth;
+        out.pending_depth += diag.pending_depth;
+        out.rounding_waste += diag.rounding_waste;
+        if (out.largest_allocatable < diag.largest_allocatable)
+        {
+            out.largest_allocatable = diag.largest_allocatable;
+        }
+        if (out.peak_request_size < diag.peak_request_size)
+        {
+            out.peak_request_size = diag.peak_request_size;
+        }
+    }
+    return out;
+}
+
+void o1heapConcurrentGetFragmentation(O1HeapConcurrent* const handle, O1HeapFragmentation* const out)
+{
+    O1HEAP_ASSERT(handle != NULL);
+    O1HEAP_ASSERT(out != NULL);
+    for (size_t k = 0U; k < NUM_BINS_MAX; k++)
+    {
+        out->free_fragment_count[k] = 0U;
+        out->free_fragment_size[k]  = 0U;
+    }
+    for (size_t i = 0U; i < handle->shard_count; i++)
+    {
+        lockShard(&handle->shards[i]);
+        const O1HeapFragmentation* const frag = &handle->shards[i].heap->fragmentation;
+        for (size_t k = 0U; k < NUM_BINS_MAX; k++)
+        {
+            out->free_fragment_count[k] += frag->free_fragment_count[k];
+            out->free_fragment_size[k] += frag->free_fragment_size[k];
+        }
+        unlockShard(&handle->shards[i]);
+    }
+}
+
+// ---------------------------------------- SLAB ALLOCATOR ----------------------------------------
+
+/// The classes are 8, 16, 24, 32, and 48 bytes; the amount shall be within the range served by the slab allocator.
+O1HEAP_PRIVATE uint8_t getSlabClass(const size_t amount)
+{
+    O1HEAP_ASSERT((amount > 0U) && (amount <= O1HEAP_SLAB_AMOUNT_MAX));
+    return (amount <= 32U) ? (uint8_t) ((amount - 1U) / 8U) : (uint8_t) (SLAB_CLASS_COUNT - 1U);
+}
+
+O1HEAP_PRIVATE size_t getSlabClassSize(const uint8_t cls)
+{
+    O1HEAP_ASSERT(cls < SLAB_CLASS_COUNT);
+    return (cls < (SLAB_CLASS_COUNT - 1U)) ? ((((size_t) cls) + 1U) * 8U) : O1HEAP_SLAB_AMOUNT_MAX;
+}
+
+/// Removes the slab from the list of slabs that have free slots.
+O1HEAP_PRIVATE void unlinkSlab(O1HeapSlab* const slab, Slab* const s)
+{
+    O1HEAP_ASSERT((slab != NULL) && (s != NULL));
+    if (s->next != NULL)
+    {
+        s->next->prev = s->prev;
+    }
+    if (s->prev != NULL)
+    {
+        s->prev->next = s->next;
+    }
+    else
+    {
+        O1HEAP_ASSERT(slab->partial[s->cls] == s);
+        slab->partial[s->cls] = s->next;
+    }
+    s->next = NULL;
+    s->prev = NULL;
+}
+
+/// Adds the slab to the beginning of the list of slabs that have free slots.
+O1HEAP_PRIVATE void linkSlab(O1HeapSlab* const slab, Slab* const s)
+{
+    O1HEAP_ASSERT((slab != NULL) && (s != NULL));
+    O1HEAP_ASSERT((s->next == NULL) && (s->prev == NULL));
+    s->next = slab->partial[s->cls];
+    if (s->next != NULL)
+    {
+        s->next->prev = s;
+    }
+    slab->partial[s->cls] = s;
+}
+
+O1HeapSlab* o1heapSlabInit(O1HeapInstance* const handle, const size_t slab_size)
 {
     O1HEAP_ASSERT(handle != NULL);
-    const O1HeapDiagnostics out = handle->diagnostics;
+    O1HeapSlab* out = NULL;
+    if ((slab_size >= (O1HEAP_ALIGNMENT + SLAB_HEADER_SIZE_PADDED + O1HEAP_SLAB_AMOUNT_MAX)) &&
+        (slab_size <= SLAB_SIZE_MAX) && (slab_size <= handle->diagnostics.capacity) &&
+        ((slab_size & (slab_size - 1U)) == 0U))
+    {
+        out = (O1HeapSlab*) o1heapAllocate(handle, sizeof(O1HeapSlab));
+    }
+    if (out != NULL)
+    {
+        out->heap      = handle;
+        out->slab_size = slab_size;
+        for (uint8_t i = 0U; i < SLAB_CLASS_COUNT; i++)
+        {
+            out->slots[i]   = (slab_size - O1HEAP_ALIGNMENT - SLAB_HEADER_SIZE_PADDED) / getSlabClassSize(i);
+            out->partial[i] = NULL;
+            O1HEAP_ASSERT((out->slots[i] > 0U) && (out->slots[i] <= UINT16_MAX));
+        }
+    }
+    return out;
+}
+
+void o1heapSlabDestroy(O1HeapSlab* const slab)
+{
+    O1HEAP_ASSERT(slab != NULL);
+    for (uint8_t i = 0U; i < SLAB_CLASS_COUNT; i++)
+    {
+        O1HEAP_ASSERT(slab->partial[i] == NULL);  // Empty slabs are released immediately, so none shall remain.
+    }
+    o1heapFree(slab->heap, slab);
+}
+
+void* o1heapSlabAllocate(O1HeapSlab* const slab, const size_t amount)
+{
+    O1HEAP_ASSERT(slab != NULL);
+    void* out = NULL;
+    if (O1HEAP_LIKELY((amount > 0U) && (amount <= O1HEAP_SLAB_AMOUNT_MAX)))
+    {
+        const uint8_t cls = getSlabClass(amount);
+        Slab*         s   = slab->partial[cls];
+        if (s == NULL)
+        {
+            // The alignment equals the fragment size, so the slab is the only occupant of its aligned block.
+            s = (Slab*) o1heapAllocateAligned(slab->heap, slab->slab_size, slab->slab_size - O1HEAP_ALIGNMENT);
+            if (s != NULL)
+            {
+                O1HEAP_ASSERT((((size_t) s) % slab->slab_size) == 0U);
+                s->next      = NULL;
+                s->prev      = NULL;
+                s->free_list = NULL;
+                s->used      = 0U;
+                s->fresh     = 0U;
+                s->cls       = cls;
+                linkSlab(slab, s);
+            }
+        }
+        if (s != NULL)
+        {
+            O1HEAP_ASSERT((s->cls == cls) && (s->used < slab->slots[cls]));
+            if (s->free_list != NULL)
+            {
+                out          = s->free_list;
+                s->free_list = *(void**) out;
+            }
+            else
+            {
+                O1HEAP_ASSERT(s->fresh == s->used);
+                out = ((char*) s) + SLAB_HEADER_SIZE_PADDED + (((size_t) s->fresh) * getSlabClassSize(cls));
+                s->fresh++;
+            }
+            s->used++;
+            if (s->used == slab->slots[cls])  // Full slabs are not tracked; they are found via the slot address.
+            {
+                unlinkSlab(slab, s);
+            }
+        }
+    }
+    return out;
+}
+
+void o1heapSlabFree(O1HeapSlab* const slab, void* const pointer)
+{
+    O1HEAP_ASSERT(slab != NULL);
+    if (O1HEAP_LIKELY(pointer != NULL))
+    {
+        const size_t offset = ((size_t) pointer) & (slab->slab_size - 1U);
+        Slab* const  s      = (Slab*) (void*) (((char*) pointer) - offset);
+        O1HEAP_ASSERT(offset >= SLAB_HEADER_SIZE_PADDED);
+        O1HEAP_ASSERT(s->cls < SLAB_CLASS_COUNT);
+        O1HEAP_ASSERT(((offset - SLAB_HEADER_SIZE_PADDED) % getSlabClassSize(s->cls)) == 0U);
+        O1HEAP_ASSERT(((offset - SLAB_HEADER_SIZE_PADDED) / getSlabClassSize(s->cls)) < s->fresh);
+        O1HEAP_ASSERT((s->used > 0U) && (s->used <= s->fresh));
+        if (s->used == slab->slots[s->cls])
+        {
+            linkSlab(slab, s);
+        }
+        *(void**) pointer = s->free_list;
+        s->free_list      = pointer;
+        s->used--;
+        if (s->used == 0U)
+        {
+            unlinkSlab(slab, s);
+            o1heapFree(slab->heap, s);
+        }
+    }
+}
+
+// ---------------------------------------- CHILD HEAP ----------------------------------------
+
+O1HeapInstance* o1heapChildInit(O1HeapInstance* const parent, const size_t size)
+{
+    O1HEAP_ASSERT(parent != NULL);
+    O1HeapInstance* out  = NULL;
+    void* const     base = o1heapAllocate(parent, size);
+    if (base != NULL)
+    {
+        out = o1heapInit(base, size);
+        if (out != NULL)
+        {
+            out->parent = parent;
+        }
+        else
+        {
+            o1heapFree(parent, base);
+        }
+    }
+    return out;
+}
+
+bool o1heapChildGrow(O1HeapInstance* const child, const size_t size)
+{
+    O1HEAP_ASSERT(child != NULL);
+    bool out = false;
+    if (child->parent != NULL)
+    {
+        void* const base = o1heapAllocate(child->parent, size);
+        if (base != NULL)
+        {
+            out = addRegion(child, base, size);
+            if (!out)
+            {
+                o1heapFree(child->parent, base);
+            }
+        }
+    }
     return out;
 }
+
+void o1heapChildDestroy(O1HeapInstance* const child)
+{
+    O1HEAP_ASSERT(child != NULL);
+    O1HEAP_ASSERT(child->parent != NULL);
+    O1HeapInstance* const parent = child->parent;
+    // The region headers and the instance are located at the beginning of the blocks allocated from the parent,
+    // so the blocks are freed without visiting the fragments allocated from the child.
+    Region* reg = child->regions;
+    while (reg != NULL)
+    {
+        Region* const next = reg->next;
+        o1heapFree(parent, reg);
+        reg = next;
+    }
+    o1heapFree(parent, child);
+}
@@ -19,6 +19,7 @@
 #ifndef O1HEAP_H_INCLUDED
 #define O1HEAP_H_INCLUDED
 
+#include <limits.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -30,12 +31,65 @@ extern "C" {
 /// The semantic version number of this distribution.
 #define O1HEAP_VERSION_MAJOR 2
 
-/// The guaranteed alignment depends on the platform pointer width.
-#define O1HEAP_ALIGNMENT (sizeof(void*) * 4U)
+/// Set this option to a non-zero value to use the compact fragment header format, which reduces the per-fragment
+/// overhead and the minimum fragment size on 64-bit platforms at the expense of limiting the heap capacity to 2 GiB.
+/// Since the option affects O1HEAP_ALIGNMENT, it shall be defined identically for all translation units that
+/// include this header, e.g., via the compiler flags; O1HEAP_CONFIG_HEADER cannot be used for that.
+/// The compact format offers no advantage on 32-bit platforms.
+#ifndef O1HEAP_COMPACT_HEADERS
+#    define O1HEAP_COMPACT_HEADERS 0
+#endif
+
+/// The guaranteed alignment depends on the platform pointer width, unless the compact headers are used.
+#if O1HEAP_COMPACT_HEADERS
+#    define O1HEAP_ALIGNMENT 16U
+#else
+#    define O1HEAP_ALIGNMENT (sizeof(void*) * 4U)
+#endif
 
 /// The definition is private, so the user code can only operate on pointers. This is done to enforce encapsulation.
 typedef struct O1HeapInstance O1HeapInstance;
 
+/// A per-thread allocation cache front-end over a shared heap instance, see o1heapCacheInit().
+/// The definition is private for the same reason as that of O1HeapInstance.
+typedef struct O1HeapCache O1HeapCache;
+
+/// A thread-safe heap composed of several independently locked shards, see o1heapConcurrentInit().
+typedef struct O1HeapConcurrent O1HeapConcurrent;
+
+/// A small-object slab allocator front-end over a heap instance, see o1heapSlabInit().
+typedef struct O1HeapSlab O1HeapSlab;
+
+/// The largest request that can be served by the slab allocator; see o1heapSlabAllocate().
+#define O1HEAP_SLAB_AMOUNT_MAX 48U
+
+/// The order in which the free fragments of the same bin are reused; see o1heapSetFreeListPolicy().
+typedef enum
+{
+    /// The most recently freed fragment is reused first, which is good for the CPU cache. This is the default.
+    O1HEAP_FREE_LIST_MRU = 0,
+    /// The least recently freed fragment is reused first.
+    O1HEAP_FREE_LIST_FIFO = 1,
+    /// A freed fragment is reused first if its address is lower than that of the first fragment in its bin;
+    /// otherwise, it is reused last. This favors the low addresses, keeping the working set dense.
+    O1HEAP_FREE_LIST_ADDRESS_ORDERED = 2,
+} O1HeapFreeListPolicy;
+
+/// The number of the free memory size classes reported in O1HeapFragmentation.
+#define O1HEAP_DIAGNOSTICS_BIN_COUNT (sizeof(size_t) * CHAR_BIT)
+
+/// The distribution of the allocation requests by size; see o1heapSetRequestHistogram().
+/// The bucket at index i of request_count counts the requests whose amount is in [2^i, 2^(i+1)) bytes;
+/// the requests for zero bytes are not counted. The bucket at index i of fragment_count counts the fragments
+/// allocated to serve the requests whose size, including the per-fragment overhead, is in
+/// [2^(i+1), 2^(i+2)) * O1HEAP_ALIGNMENT, which matches the size classes of O1HeapFragmentation.
+/// Failed requests are counted in request_count but not in fragment_count.
+typedef struct
+{
+    uint64_t request_count[O1HEAP_DIAGNOSTICS_BIN_COUNT];
+    uint64_t fragment_count[O1HEAP_DIAGNOSTICS_BIN_COUNT];
+} O1HeapRequestHistogram;
+
 /// Runtime diagnostic information. This information can be used to facilitate runtime self-testing,
 /// as required by certain safety-critical development guidelines.
 /// If assertion checks are not disabled, the library will perform automatic runtime self-diagnostics that trigger
@@ -53,27 +107,210 @@ typedef struct
     /// For example, if the application requested a fragment of size 1 byte, the value reported here may be 32 bytes.
     size_t allocated;
 
-    /// The maximum value of 'allocated' seen since initialization. This parameter is never decreased.
+    /// The maximum value of 'allocated' seen since initialization or since the last o1heapResetPeaks().
+    /// This parameter is never decreased except by o1heapResetPeaks().
     size_t peak_allocated;
 
     /// The largest amount of memory that the allocator has attempted to allocate (perhaps unsuccessfully)
-    /// since initialization (not including the rounding and the allocator's own per-fragment overhead,
-    /// so the total is larger). This parameter is never decreased. The initial value is zero.
+    /// since initialization or since the last o1heapResetPeaks() (not including the rounding and the allocator's own
+    /// per-fragment overhead, so the total is larger). This parameter is never decreased except by o1heapResetPeaks().
+    /// The initial value is zero.
     size_t peak_request_size;
 
+    /// The number of times o1heapResetPeaks() has been invoked. This parameter is never decreased.
+    uint64_t peak_reset_count;
+
+    /// The number of complete passes over the entire heap made by o1heapValidateStep(). This parameter is never
+    /// decreased.
+    uint64_t validation_pass_count;
+
     /// The number of times an allocation request could not be completed due to the lack of memory or
-    /// excessive fragmentation. OOM stands for "out of memory". This parameter is never decreased.
+    /// excessive fragmentation, due to the quota of its allocation tag (see O1HeapTagDiagnostics), or due to
+    /// the reserve (see reserve_denial_count). OOM stands for "out of memory". This parameter is never decreased.
     uint64_t oom_count;
+
+    /// The number of successful o1heapReallocate() calls served by each of the available strategies:
+    /// keeping or shrinking the fragment in place, growing it in place into its free right neighbor,
+    /// and moving the data into a newly allocated fragment. These parameters are never decreased.
+    uint64_t realloc_shrink_count;
+    uint64_t realloc_grow_count;
+    uint64_t realloc_move_count;
+
+    /// The number of times the floor bin was probed for a sufficient fit before taking a fragment from a larger bin,
+    /// and the number of probes that found one; the hit rate is their ratio. See O1HEAP_FLOOR_PROBE_LIMIT.
+    /// These parameters remain zero if the probing is disabled. These parameters are never decreased.
+    uint64_t floor_probe_count;
+    uint64_t floor_probe_hit_count;
+
+    /// The number of successful allocations that have left less free memory than the reserve, i.e., that have been
+    /// served from the reserve, and the number of requests denied because their priority was too low to use the
+    /// reserve; see o1heapSetReserve(). The denials are counted in oom_count as well.
+    /// These parameters remain zero if there is no reserve. These parameters are never decreased.
+    uint64_t reserve_hit_count;
+    uint64_t reserve_denial_count;
+
+    /// The number of fragments passed to o1heapFreeDeferred() that have not yet been returned to the heap.
+    /// Such fragments are still included in 'allocated'.
+    size_t deferred_depth;
+
+    /// The number of fragments passed to o1heapFree() that await coalescing; see o1heapMaintain().
+    /// Such fragments are still included in 'allocated'. This is always zero unless O1HEAP_DEFERRED_COALESCING is set.
+    size_t pending_depth;
+
+    /// The total number of bytes lost to rounding the fragment sizes up (not including the per-fragment overhead)
+    /// over all successful allocations since initialization. Its growth relative to the number of allocations
+    /// shows how well the requested sizes match the fragment sizes. This parameter is never decreased.
+    uint64_t rounding_waste;
+
+    /// The largest allocation request that is guaranteed to succeed at the moment; zero if there is no free memory.
+    /// It is the lower bound of the largest non-empty size class (see O1HeapFragmentation) minus the per-fragment
+    /// overhead.
+    /// A larger request may succeed as well if a suitable fragment is available, e.g., with the sub-bins or the
+    /// floor bin probing enabled, or if there are fragments that await coalescing.
+    /// A value that is approaching the largest request of the application signals the risk of an OOM.
+    size_t largest_allocatable;
 } O1HeapDiagnostics;
 
+/// The state of the free memory per size class, see o1heapGetFragmentation(). It is kept apart from
+/// O1HeapDiagnostics because of its size. The class at index i holds the free fragments whose size, including
+/// the per-fragment overhead, is in [2^(i+1), 2^(i+2)) * O1HEAP_ALIGNMENT.
+typedef struct
+{
+    /// The number and the total size of the free fragments per size class.
+    /// The total of the sizes equals (capacity - allocated), see O1HeapDiagnostics.
+    size_t free_fragment_count[O1HEAP_DIAGNOSTICS_BIN_COUNT];
+    size_t free_fragment_size[O1HEAP_DIAGNOSTICS_BIN_COUNT];
+} O1HeapFragmentation;
+
+/// The number of the allocation tags, see o1heapAllocateTagged(). The tags are stored in the spare bytes of
+/// the fragment header, so they do not increase the per-fragment overhead; the per-tag statistics are stored in the
+/// heap instance, so a larger number of tags increases its size. Since the option affects the layout of the instance,
+/// it shall be defined identically for all translation units that include this header. The value shall be in [1, 256].
+#ifndef O1HEAP_TAG_COUNT
+#    define O1HEAP_TAG_COUNT 8U
+#endif
+
+/// The memory use statistics and the quota of an allocation tag; see o1heapGetTagDiagnostics().
+typedef struct
+{
+    /// The total size of the fragments allocated with the tag including the per-fragment overhead, same as the
+    /// allocated value of O1HeapDiagnostics, which equals the sum over all tags.
+    size_t allocated;
+
+    /// The maximum of allocated since initialization or the last o1heapResetPeaks().
+    size_t peak_allocated;
+
+    /// An allocation with the tag fails if it would make allocated exceed the quota. SIZE_MAX means no quota.
+    size_t quota;
+
+    /// The number of the allocation requests with the tag that have failed because of the quota.
+    /// Such failures are also counted in the oom_count of O1HeapDiagnostics.
+    uint64_t quota_fail_count;
+} O1HeapTagDiagnostics;
+
+/// The description of a fragment reported by o1heapTraverse().
+typedef struct
+{
+    /// The memory of the fragment as seen by the application; if the fragment is used, this is the pointer that was
+    /// returned by the allocation function. The usable size of the memory is (size - O1HEAP_ALIGNMENT).
+    const void* pointer;
+
+    /// The offset of the fragment from the first fragment of its memory region.
+    size_t offset;
+
+    /// The size of the fragment including the per-fragment overhead.
+    size_t size;
+
+    /// Zero for the arena passed to o1heapInit(); N for the N-th region added via o1heapAddRegion().
+    size_t region;
+
+    /// True unless the fragment is free. The fragments passed to o1heapFreeDeferred() or o1heapFree() that have not
+    /// been returned to the heap yet are reported as used.
+    bool used;
+
+    /// The allocation tag of a used fragment, see o1heapAllocateTagged(); zero if the fragment is free.
+    uint8_t tag;
+} O1HeapFragmentInfo;
+
+/// Invoked by o1heapTraverse() for every fragment; the traversal stops early if the callback returns false.
+/// The callback shall not invoke the heap functions that modify the heap.
+typedef bool (*O1HeapTraverseCallback)(void* const context, const O1HeapFragmentInfo* const info);
+
+/// The events reported to the memory pressure callback; see o1heapSetPressureCallback().
+typedef enum
+{
+    /// An allocation request has failed; the callback may free some memory to have the request retried.
+    O1HEAP_PRESSURE_OOM = 0,
+    /// The allocated memory has risen above the high watermark.
+    O1HEAP_PRESSURE_HIGH = 1,
+    /// The allocated memory has fallen to the low watermark or below after O1HEAP_PRESSURE_HIGH.
+    O1HEAP_PRESSURE_LOW = 2,
+} O1HeapPressureEvent;
+
+/// The expected lifetime of an allocation, which determines where it is placed; see o1heapAllocateHinted().
+typedef enum
+{
+    /// The memory is carved from the low end of the chosen free fragment. This is the default placement.
+    O1HEAP_LIFETIME_SHORT = 0,
+    /// The memory is carved from the high end of the chosen free fragment. The long-lived allocations thereby
+    /// accumulate at the top of the arena, away from the churn of the short-lived ones at the bottom.
+    O1HEAP_LIFETIME_LONG = 1,
+} O1HeapLifetime;
+
+/// The handle of a movable allocation, see o1heapAllocateMovable(). Zero is not a valid handle.
+typedef size_t O1HeapMovable;
+
+/// An entry of the handle table of the movable allocations, see o1heapSetMovableTable().
+/// The fields are maintained by the heap and shall not be modified by the application.
+typedef struct
+{
+    /// The memory of the allocation; NULL if the entry is vacant.
+    void* pointer;
+
+    /// The number of the outstanding o1heapPin() calls; the next vacant entry (as a handle) if the entry is vacant.
+    size_t pins;
+} O1HeapMovableEntry;
+
+/// Invoked by the heap on the memory pressure events; see o1heapSetPressureCallback(). The amount is that of the
+/// failed request for O1HEAP_PRESSURE_OOM and zero otherwise. For O1HEAP_PRESSURE_OOM, the callback returns true
+/// if it may have freed some memory, so that the failed request is to be retried; otherwise, the result is ignored.
+typedef bool (*O1HeapPressureCallback)(void* const context, const O1HeapPressureEvent event, const size_t amount);
+
+/// The binary snapshot produced by o1heapSnapshot() is a header followed by one record per fragment, where all fields
+/// are unsigned little-endian integers regardless of the platform, so that the snapshots can be analyzed offline:
+///
+///     offset  size    header field
+///     0       4       O1HEAP_SNAPSHOT_MAGIC, i.e., the ASCII characters "O1HS"
+///     4       4       O1HEAP_SNAPSHOT_VERSION
+///     8       8       capacity, see O1HeapDiagnostics
+///     16      8       allocated, see O1HeapDiagnostics
+///     24      8       the number of records
+///     32      4       O1HEAP_ALIGNMENT
+///     36      4       zero
+///
+///     offset  size    record field
+///     0       8       the offset of the fragment, see O1HeapFragmentInfo
+///     8       8       the size of the fragment; bit 0 is set if the fragment is used (the size is always even)
+///     16      4       the region of the fragment, see O1HeapFragmentInfo
+///     20      4       the tag of the fragment, see O1HeapFragmentInfo
+///
+/// The records are ordered as reported by o1heapTraverse().
+#define O1HEAP_SNAPSHOT_MAGIC 0x5348314FUL
+#define O1HEAP_SNAPSHOT_VERSION 1U
+#define O1HEAP_SNAPSHOT_HEADER_SIZE 40U
+#define O1HEAP_SNAPSHOT_RECORD_SIZE 24U
+
 /// The arena base pointer shall be aligned at O1HEAP_ALIGNMENT, otherwise NULL is returned.
+/// Depending on the alignment of the base pointer, up to O1HEAP_ALIGNMENT bytes of the arena may be left unused
+/// to ensure that the memory returned by the allocator is aligned at (O1HEAP_ALIGNMENT*2).
 ///
 /// The total heap capacity cannot exceed approx. (SIZE_MAX/2). If the arena size allows for a larger heap,
 /// the excess will be silently truncated away (no error). This is not a realistic use case because a typical
 /// application is unlikely to be able to dedicate that much of the address space for the heap.
 ///
 /// The function initializes a new heap instance allocated in the provided arena, taking some of its space for its
-/// own needs (normally about 40..600 bytes depending on the architecture, but this parameter is not characterized).
+/// own needs (normally about 0.5..2 KiB depending on the architecture and the build configuration, but this parameter
+/// is not characterized).
 /// A pointer to the newly initialized instance is returned.
 ///
 /// If the provided space is insufficient, NULL is returned.
@@ -84,6 +321,25 @@ typedef struct
 /// The heap is not thread-safe; external synchronization may be required.
 O1HeapInstance* o1heapInit(void* const base, const size_t size);
 
+/// This is like o1heapInit() except that the arena is promised to be zero-filled (e.g., a static array in .bss).
+/// The allocator keeps track of the free memory that is known to be zero-filled, which allows
+/// o1heapAllocateZeroed() to avoid redundant zero-filling. If the arena is not zero-filled, the behavior is undefined.
+O1HeapInstance* o1heapInitZeroed(void* const base, const size_t size);
+
+/// Attaches an additional memory region to an existing heap instance. The region can be located anywhere in memory
+/// and its size is arbitrary; the regions shall not overlap with each other or with the arena of the instance.
+/// This allows one to build a heap from several non-contiguous memory blocks, such as on-chip SRAM and external RAM,
+/// or to donate the memory that has become available after the heap has been initialized.
+///
+/// The base pointer shall be aligned at O1HEAP_ALIGNMENT, otherwise false is returned. A small header is placed
+/// at the beginning of the region, and up to O1HEAP_ALIGNMENT bytes may be left unused for alignment as in
+/// o1heapInit(). Fragments are never merged across region boundaries, so the largest allocation is limited by
+/// the largest region. The capacity reported by the diagnostics includes all regions; the total capacity is
+/// limited as described for o1heapInit(). Regions cannot be detached once attached.
+///
+/// Returns false if the region is too small to be used. The function is executed in constant time.
+bool o1heapAddRegion(O1HeapInstance* const handle, void* const base, const size_t size);
+
 /// The semantics follows malloc() with additional guarantees the full list of which is provided below.
 ///
 /// If the allocation request is served successfully, a pointer to the newly allocated memory fragment is returned.
@@ -96,14 +352,251 @@ O1HeapInstance* o1heapInit(void* const base, const size_t size);
 /// The allocated memory is NOT zero-filled (because zero-filling is a variable-complexity operation).
 void* o1heapAllocate(O1HeapInstance* const handle, const size_t amount);
 
+/// The semantics follows calloc() except that the amount is specified in bytes rather than as a number of items.
+///
+/// The allocated memory is zero-filled. The allocator keeps track of the free fragments whose memory is known to be
+/// zero-filled (see o1heapInitZeroed()); if such a fragment is allocated, only a few bytes of the allocator's own
+/// metadata are cleared instead of the entire amount. Memory that has been freed is never assumed to be zero-filled.
+///
+/// The time complexity is the same as that of o1heapAllocate() plus zero-filling, which is linear in the amount
+/// unless the memory is known to be zero-filled, in which case the execution time is constant.
+void* o1heapAllocateZeroed(O1HeapInstance* const handle, const size_t amount);
+
+/// The semantics follows aligned_alloc() with additional guarantees the full list of which is provided below.
+///
+/// The alignment shall be a positive integer power of 2, otherwise NULL is returned.
+/// If the alignment does not exceed (O1HEAP_ALIGNMENT*2), the call is equivalent to o1heapAllocate(),
+/// because the memory returned by the allocator is always aligned at (O1HEAP_ALIGNMENT*2).
+/// Otherwise, the request is served from a free fragment that is at least (alignment-O1HEAP_ALIGNMENT*2) bytes larger
+/// than it would be for an ordinary request; the misaligned leading part of that fragment is returned to the heap.
+/// The allocated memory can be deallocated using o1heapFree() as usual.
+///
+/// If the allocation request cannot be served due to the lack of memory or its excessive fragmentation,
+/// a NULL pointer is returned.
+///
+/// The function is executed in constant time.
+/// The allocated memory is NOT zero-filled (because zero-filling is a variable-complexity operation).
+void* o1heapAllocateAligned(O1HeapInstance* const handle, const size_t alignment, const size_t amount);
+
+/// Same as o1heapAllocate() except that the memory is attributed to the specified allocation tag, such as the index
+/// of the subsystem that requests it. The tag is stored in the fragment header, so that the memory use per tag
+/// is maintained in constant time; see o1heapGetTagDiagnostics(). The memory allocated by the other allocation
+/// functions is attributed to tag zero; o1heapReallocate() retains the tag of the reallocated memory.
+///
+/// If the tag has a quota (see o1heapSetTagQuota()) that would be exceeded by the allocation, the request fails early
+/// and NULL is returned, so a runaway subsystem cannot exhaust the heap shared with other subsystems.
+/// NULL is also returned if the tag is not less than O1HEAP_TAG_COUNT; this is not counted as an allocation request.
+/// The function is executed in constant time.
+void* o1heapAllocateTagged(O1HeapInstance* const handle, const size_t amount, const uint8_t tag);
+
+/// Same as o1heapAllocateTagged() except that the request has the specified priority, which determines whether it
+/// may be served from the reserve; see o1heapSetReserve(). The requests made via the other allocation functions,
+/// including o1heapReallocate(), have the lowest priority, zero. If the request is denied because of the reserve,
+/// NULL is returned; this is counted in reserve_denial_count, see O1HeapDiagnostics.
+/// The function is executed in constant time.
+void* o1heapAllocatePrioritized(O1HeapInstance* const handle,
+                                const size_t          amount,
+                                const uint8_t         tag,
+                                const uint8_t         priority);
+
+/// Same as o1heapAllocate() except that the memory is placed according to its expected lifetime. Carving the
+/// long-lived allocations from the high end of the free fragments and the short-lived ones from the low end keeps
+/// the two apart, so that the memory released by the short-lived allocations coalesces into large free fragments
+/// instead of being pinned between the long-lived ones. The hint only affects the placement within the free fragment,
+/// which is chosen as usual, so a request succeeds under the same conditions as with o1heapAllocate().
+/// The memory moved by o1heapReallocate() is always placed as short-lived.
+/// The function is executed in constant time.
+void* o1heapAllocateHinted(O1HeapInstance* const handle, const size_t amount, const O1HeapLifetime lifetime);
+
+/// Allocates up to 'count' fragments of the same size at once and stores the pointers into the output array,
+/// which shall be large enough. Returns the number of allocated fragments; the rest of the array is set to NULL.
+/// The semantics of each item is the same as that of o1heapAllocate().
+///
+/// If there is a free fragment large enough to accommodate the entire batch, it is split into the requested
+/// fragments in a single pass, and the diagnostics are updated only once per batch. Otherwise, the items are
+/// allocated one by one until the first failure, so the batch may be served only partially.
+///
+/// The execution time is linear in the number of items and constant per item.
+size_t o1heapAllocateBatch(O1HeapInstance* const handle, const size_t amount, const size_t count, void** const out);
+
 /// The semantics follows free() with additional guarantees the full list of which is provided below.
 ///
 /// If the pointer does not point to a previously allocated block and is not NULL, the behavior is undefined.
 /// Builds where assertion checks are enabled may trigger an assertion failure for some invalid inputs.
 ///
+/// If the library is built with O1HEAP_DEFERRED_COALESCING, the fragment is not merged with its free neighbors
+/// but only queued for coalescing, see o1heapMaintain(); until then, it is not available for allocation.
+///
 /// The function is executed in constant time.
 void o1heapFree(O1HeapInstance* const handle, void* const pointer);
 
+/// Same as o1heapFree() except that the fragment is not returned to the heap immediately but pushed onto
+/// a lock-free stack stored inside the fragment itself. Unlike the other functions, this one is thread-safe and
+/// reentrant, so it can be invoked from any thread or from an interrupt/signal handler while the heap is being used
+/// by its owner. The owner of the heap releases up to O1HEAP_DEFERRED_DRAIN_LIMIT queued fragments on each
+/// subsequent o1heapAllocate() or o1heapFree() call; the latter can be invoked with NULL to just drain the queue.
+/// The number of queued fragments is reported via the diagnostics.
+///
+/// Returns false if the library is built without the atomic operations (see O1HEAP_ATOMIC_LOAD); in that case,
+/// the fragment is not freed and the application should resort to o1heapFree().
+/// The function is lock-free: its execution time is bounded unless it is contended by other producers.
+bool o1heapFreeDeferred(O1HeapInstance* const handle, void* const pointer);
+
+/// Deallocates the specified fragments at once. The semantics of each item is the same as that of o1heapFree().
+/// The same pointer shall not occur in the array more than once unless it is NULL.
+///
+/// The fragments that are adjacent to each other (regardless of their order in the array) are merged together
+/// before being returned to the heap, so each run of adjacent fragments is rebinned only once.
+///
+/// The execution time is linear in the number of items and constant per item.
+void o1heapFreeBatch(O1HeapInstance* const handle, void* const* const pointers, const size_t count);
+
+/// Coalesces up to max_steps fragments queued by o1heapFree() with their neighbors and returns them to the heap.
+/// This is intended for the idle loop of the application when the library is built with O1HEAP_DEFERRED_COALESCING;
+/// otherwise, there is nothing to do. Returns the number of fragments that still await coalescing.
+///
+/// The queued fragments remain accounted for as allocated (see pending_depth in O1HeapDiagnostics), so they also
+/// count against the tag quotas, the reserve, and the pressure watermarks until coalesced. However, the allocation
+/// functions coalesce the queued fragments on demand before reporting a failure, including a denial due to a quota or
+/// the reserve, so the allocation failures are not affected by the deferral, but such allocations take longer.
+///
+/// The execution time is linear in max_steps (or in the number of the queued fragments, whichever is smaller)
+/// and constant per step.
+size_t o1heapMaintain(O1HeapInstance* const handle, const size_t max_steps);
+
+/// Selects the order in which the free fragments of the same bin are reused; the default is O1HEAP_FREE_LIST_MRU.
+/// The policy applies to the fragments that are freed afterwards; the fragments that are already free are not
+/// reordered, so the policy can be changed at any time. All policies take constant time.
+/// Builds where assertion checks are enabled will trigger an assertion failure if the policy is not valid.
+void o1heapSetFreeListPolicy(O1HeapInstance* const handle, const O1HeapFreeListPolicy policy);
+
+/// Attaches the histogram that will be updated on every allocation request; NULL detaches the current histogram.
+/// No histogram is attached by default. The histogram is owned by the application and should be zero-initialized
+/// before it is attached; the library only increments its counters. It can be read or zeroed by the application
+/// at any time when the heap is not in use, e.g., to measure the distribution of the request sizes per operating phase.
+/// The update takes constant time.
+void o1heapSetRequestHistogram(O1HeapInstance* const handle, O1HeapRequestHistogram* const histogram);
+
+/// Resets the peak_allocated to the current value of allocated and the peak_request_size to zero,
+/// and increments peak_reset_count; see O1HeapDiagnostics. The peaks of the allocation tags are reset likewise,
+/// see O1HeapTagDiagnostics. Other diagnostics are not affected.
+/// This allows one to measure the peak memory use per operating phase without reinitializing the heap.
+/// The execution time is linear in O1HEAP_TAG_COUNT.
+void o1heapResetPeaks(O1HeapInstance* const handle);
+
+/// Sets the quota of the allocation tag in bytes including the per-fragment overhead, see O1HeapTagDiagnostics;
+/// SIZE_MAX removes the quota, which is the default. Lowering the quota below the current memory use of the tag
+/// does not affect the memory already allocated. Returns false if the tag is not less than O1HEAP_TAG_COUNT.
+/// The function is executed in constant time.
+bool o1heapSetTagQuota(O1HeapInstance* const handle, const uint8_t tag, const size_t quota);
+
+/// Returns the tag of the allocated memory, see o1heapAllocateTagged(). The pointer shall not be NULL.
+/// The function is executed in constant time.
+uint8_t o1heapGetTag(const O1HeapInstance* const handle, void* const pointer);
+
+/// Returns the memory use statistics and the quota of the allocation tag; a zeroed structure if the tag is not less
+/// than O1HEAP_TAG_COUNT. The function is executed in constant time.
+O1HeapTagDiagnostics o1heapGetTagDiagnostics(const O1HeapInstance* const handle, const uint8_t tag);
+
+/// Sets aside an emergency reserve for the requests whose priority is not less than the specified minimum priority,
+/// such as those of the safety-critical control functions; see o1heapAllocatePrioritized().
+/// A request of a lower priority is denied if serving it would leave less than 'reserve' bytes of free memory,
+/// so when the heap nears exhaustion, the low-priority requests fail first while the critical requests can still
+/// use the reserve. The reserve is an amount of free memory rather than a dedicated memory area, so the critical
+/// requests may still fail due to the fragmentation. Both parameters are zero by default, i.e., there is no reserve.
+/// Setting the reserve does not affect the memory already allocated.
+/// The function is executed in constant time, and so is the check of each request against the reserve.
+void o1heapSetReserve(O1HeapInstance* const handle, const size_t reserve, const uint8_t min_priority);
+
+/// Attaches the callback that is invoked with the context pointer on the memory pressure events, allowing the
+/// application to give memory back on demand, e.g., by flushing its caches or shedding load; NULL detaches it.
+/// No callback is attached by default.
+///
+/// O1HEAP_PRESSURE_OOM is reported when an allocation request fails, including the failures due to the quota or
+/// the reserve. If the callback returns true, the request is retried once. Each failed attempt is counted in
+/// oom_count, so a request that fails again after the retry is counted twice. Only o1heapAllocateAligned() and
+/// the functions based on o1heapAllocatePrioritized() retry the requests; the latter include o1heapAllocate(),
+/// o1heapAllocateTagged(), o1heapAllocateZeroed(), and o1heapReallocate().
+///
+/// O1HEAP_PRESSURE_HIGH is reported when the allocated memory rises above the high watermark, and
+/// O1HEAP_PRESSURE_LOW when it subsequently falls to the low watermark or below, which shall not exceed the high one.
+/// The watermarks are checked when a function that allocates or frees memory is about to return, so the callback
+/// always observes the heap in a consistent state.
+///
+/// The callback may use the heap, but it is not invoked recursively: the events that occur while the callback is
+/// running are not reported, except that the watermarks are checked again at the end of the next such function.
+/// The time complexity of the affected functions remains constant apart from the execution time of the callback.
+void o1heapSetPressureCallback(O1HeapInstance* const       handle,
+                               const O1HeapPressureCallback callback,
+                               void* const                  context,
+                               const size_t                 high_watermark,
+                               const size_t                 low_watermark);
+
+/// Returns the heap to the state it had right after o1heapInit() and the subsequent o1heapAddRegion() calls:
+/// all allocated memory is freed at once, without visiting the allocated fragments. The attached regions,
+/// the settings (the free list policy, the request histogram, the tag quotas, the reserve, the pressure callback),
+/// and the cumulative diagnostics (the peaks and the counters) are retained; the diagnostics that describe
+/// the current state are reset accordingly. The memory is not zero-filled.
+/// This is intended for the frame-scoped allocation, where all temporaries are freed at the end of the frame.
+///
+/// All pointers previously returned by the heap become invalid, including those held by the thread caches and slabs
+/// that draw from it. The fragments queued by o1heapFreeDeferred() are discarded, so there shall be no concurrent
+/// o1heapFreeDeferred() calls. The checkpoint recorded by o1heapMark(), if any, is discarded.
+/// The handles of the movable allocations become invalid as well, and all entries of their table are vacated.
+///
+/// The execution time is linear in the number of bins and regions (and in the number of entries of the table of
+/// the movable allocations, if attached), and constant with respect to the heap size and the number of allocated
+/// fragments.
+void o1heapReset(O1HeapInstance* const handle);
+
+/// Records a checkpoint that o1heapRollback() can return the heap to, freeing everything allocated since then at once.
+/// The checkpoint is taken at the largest free fragment, called the frame (e.g., the untouched tail of the arena);
+/// the rollback is possible as long as the heap has only been modified within the frame since the checkpoint.
+/// Returns false and records no checkpoint if there is no free memory. There is only one checkpoint per heap;
+/// recording a new one discards the previous one.
+///
+/// Before the checkpoint is recorded, the fragments queued by o1heapFree() under O1HEAP_DEFERRED_COALESCING are
+/// released, as by o1heapMaintain() with an unlimited number of steps; otherwise, the execution time is constant.
+bool o1heapMark(O1HeapInstance* const handle);
+
+/// Frees all memory allocated within the frame of the checkpoint recorded by o1heapMark() at once and restores
+/// the allocated memory to its value at the time of the checkpoint. All pointers into the frame become invalid.
+/// The table of the movable allocations is not updated, so those within the frame shall be freed beforehand.
+/// The checkpoint is retained, so the same checkpoint can be rolled back to at the end of each frame.
+///
+/// Returns false and does nothing if there is no checkpoint, if the heap has been modified outside of the frame
+/// since the checkpoint (e.g., if an allocation has been served from another free fragment, if memory allocated
+/// before the checkpoint has been freed, or if a region has been added), if there are fragments outside of the frame
+/// that await coalescing, or if there are fragments queued by o1heapFreeDeferred(). In that case, the application
+/// should free the memory individually. Therefore, the rollback is most useful if the frame was the only free
+/// fragment at the checkpoint, which is the case, e.g., right after o1heapInit() or o1heapReset().
+///
+/// The execution time is linear in the number of bins plus the number of free fragments within the frame (and
+/// the number of fragments that await coalescing), and does not depend on the number of fragments allocated within
+/// the frame.
+bool o1heapRollback(O1HeapInstance* const handle);
+
+/// The semantics follows realloc() with additional guarantees the full list of which is provided below.
+///
+/// If the pointer is NULL, the call is equivalent to o1heapAllocate().
+/// Otherwise, if the amount is zero, the call is equivalent to o1heapFree() and NULL is returned.
+/// If the pointer does not point to a previously allocated block and is not NULL, the behavior is undefined.
+///
+/// The fragment is resized in place without copying if the new fragment size does not exceed the old one
+/// (the excess is split off the tail and returned to the heap), or if the right neighbor of the fragment is free
+/// and large enough to accommodate the growth. Otherwise, a new fragment is allocated, the data is copied over,
+/// and the old fragment is freed. The returned pointer is guaranteed to be aligned at O1HEAP_ALIGNMENT.
+///
+/// If the request cannot be served due to the lack of memory or its excessive fragmentation,
+/// NULL is returned and the old fragment is left intact.
+///
+/// The memory retains its allocation tag, see o1heapAllocateTagged(). The growth is subject to the quota of the tag;
+/// while the data is being moved, both fragments are attributed to the tag, so the quota shall accommodate both.
+///
+/// The in-place resizing is executed in constant time. The data copying is a variable-complexity operation,
+/// so the worst case is linear in the size of the old fragment.
+void* o1heapReallocate(O1HeapInstance* const handle, void* const pointer, const size_t amount);
+
 /// Performs a basic sanity check on the heap.
 /// This function can be used as a weak but fast method of heap corruption detection.
 /// If the handle pointer is NULL, the behavior is undefined.
@@ -116,6 +609,241 @@ bool o1heapDoInvariantsHold(const O1HeapInstance* const handle);
 /// If the handle pointer is NULL, the behavior is undefined.
 O1HeapDiagnostics o1heapGetDiagnostics(const O1HeapInstance* const handle);
 
+/// Copies the per-class statistics of the free memory into the structure provided by the caller,
+/// see O1HeapFragmentation. The statistics are maintained as the fragments enter and leave the bins,
+/// so the execution time is constant. If any of the pointers is NULL, the behavior is undefined.
+void o1heapGetFragmentation(const O1HeapInstance* const handle, O1HeapFragmentation* const out);
+
+/// Validates the next max_fragments fragments of the heap, resuming where the previous call has stopped; once the last
+/// fragment of the last region is validated, the next call starts a new pass from the beginning of the heap,
+/// and validation_pass_count is incremented (see O1HeapDiagnostics). This allows one to check the entire heap
+/// thoroughly from a background task with a bounded latency per call, which is not possible with a full traversal
+/// on a large heap. Each fragment is checked for the linkage with its neighbors, the absence of adjacent free
+/// fragments (which would have been merged), and the consistency of its bin list if it is free. At the end of a pass,
+/// the total size of the fragments and the number of free fragments are compared against the diagnostics,
+/// unless the heap was modified during the pass.
+///
+/// The heap may be used freely between the calls; the position of the validation is kept in the heap instance
+/// and it is maintained by the allocator, so only one incremental validation can be performed per heap.
+/// The return value is falsity if a heap corruption is detected, in which case the next call starts a new pass;
+/// otherwise, it is truth. If max_fragments is zero, nothing is done and truth is returned.
+///
+/// The time complexity is linear in max_fragments and in the number of the regions; each fragment takes constant time.
+bool o1heapValidateStep(O1HeapInstance* const handle, const size_t max_fragments);
+
+/// Invokes the callback for every fragment of the heap, free and used, passing the context pointer along.
+/// The fragments of the arena passed to o1heapInit() are reported first, followed by the fragments of the regions
+/// added via o1heapAddRegion() in the order of their addition; the fragments of a region are reported in the order
+/// of their addresses. The return value is the number of the callback invocations.
+/// If the handle pointer or the callback is NULL, the behavior is undefined.
+///
+/// This function is intended for debugging and offline analysis of the fragmentation; it does not modify the heap.
+/// The time complexity is linear in the number of fragments (plus quadratic in the number of regions, which is small).
+size_t o1heapTraverse(const O1HeapInstance* const handle, const O1HeapTraverseCallback callback, void* const context);
+
+/// Writes the binary snapshot of the fragment layout into the buffer; the format is described next to
+/// O1HEAP_SNAPSHOT_MAGIC. The return value is the size of the complete snapshot in bytes. If the buffer is NULL or
+/// smaller than that, the snapshot is incomplete and its header is not written, so a larger buffer shall be supplied;
+/// calling this function with a NULL buffer is therefore a way to obtain the required size.
+/// The library does not perform any I/O; the application can write the snapshot into a file or a socket itself,
+/// e.g., periodically or upon a fault, for the offline analysis with the tools described in the documentation.
+///
+/// The time complexity is the same as that of o1heapTraverse().
+size_t o1heapSnapshot(const O1HeapInstance* const handle, void* const buffer, const size_t size);
+
+/// Attaches the application-owned table of 'count' entries that holds the handles of the movable allocations,
+/// see o1heapAllocateMovable(); the table shall outlive the heap. All entries are initialized as vacant.
+/// A NULL table or zero count detaches the table. Returns false and does nothing if there are movable allocations
+/// in the current table, which shall be freed first. The execution time is linear in the number of entries.
+bool o1heapSetMovableTable(O1HeapInstance* const handle, O1HeapMovableEntry* const entries, const size_t count);
+
+/// Allocates memory that the heap may move to another location to recover contiguous free space,
+/// see o1heapCompactStep(). Instead of a pointer, the application receives a handle, which refers to an entry of
+/// the table attached via o1heapSetMovableTable(); the memory is accessed between o1heapPin() and o1heapUnpin().
+/// The memory is aligned at O1HEAP_ALIGNMENT and its contents are preserved when it is moved. The handle is also
+/// stored in the allocation itself, which adds O1HEAP_ALIGNMENT bytes to the per-fragment overhead; the request
+/// statistics, such as peak_request_size, and the pressure callback see the requested amount without it.
+///
+/// Returns zero if there is no vacant entry in the table, if the amount is zero, or if there is not enough memory.
+/// The memory is allocated with the tag zero and the lowest priority. The function is executed in constant time.
+O1HeapMovable o1heapAllocateMovable(O1HeapInstance* const handle, const size_t amount);
+
+/// Frees the movable allocation and vacates its entry in the table. The allocation shall not be pinned.
+/// If the handle is zero, the function has no effect. The function is executed in constant time.
+void o1heapFreeMovable(O1HeapInstance* const handle, const O1HeapMovable movable);
+
+/// Returns the pointer to the memory of the movable allocation and prevents the allocation from being moved until
+/// the matching o1heapUnpin(). The calls may be nested. The pointer shall not be used once the allocation is unpinned,
+/// and it shall not be passed to the other functions, such as o1heapFree() or o1heapReallocate().
+/// The handle shall be valid. The function is executed in constant time.
+void* o1heapPin(O1HeapInstance* const handle, const O1HeapMovable movable);
+
+/// Undoes one o1heapPin(); once all of them are undone, the allocation may be moved by o1heapCompactStep().
+/// The function is executed in constant time.
+void o1heapUnpin(O1HeapInstance* const handle, const O1HeapMovable movable);
+
+/// Performs up to max_steps steps of the incremental compaction and returns the number of the allocations moved.
+/// Each step examines one fragment; if the fragment is free and followed by an unpinned movable allocation,
+/// the allocation is slid down to the beginning of the free fragment, which thereby moves up and merges with the free
+/// fragment that follows, if any; the table entry of the allocation is updated accordingly. The other allocations
+/// are never moved, so they confine the compaction to the spans of memory between them.
+/// Like o1heapValidateStep(), the compaction proceeds from where the previous invocation left off, cycling through
+/// all fragments of all regions; a full pass that moves nothing means that no further progress can be made.
+///
+/// The execution time is linear in max_steps and in the number of the regions, plus the time to copy the memory
+/// of the moved allocations, which is linear in their size. Hence, a small max_steps bounds the pause.
+size_t o1heapCompactStep(O1HeapInstance* const handle, const size_t max_steps);
+
+/// Creates a thread cache over the specified heap. The cache itself is allocated from the heap.
+/// The heap is not thread-safe, so every function that takes the heap lock below shall be invoked with the lock held
+/// by the application; the functions that do not take the lock may be invoked concurrently with any heap operations
+/// as long as each cache is only used by one thread at a time.
+///
+/// The cache keeps a stack of up to 'depth' free fragments per size class for every class that can serve a request
+/// of up to 'max_amount' bytes; larger requests bypass the cache. The cached fragments remain allocated from the
+/// point of view of the heap (they are accounted for in the diagnostics as such), so the amount of memory held
+/// by a cache is bounded; see the README for the corresponding worst-case memory consumption term.
+///
+/// Returns NULL if the arguments are invalid (zero depth or max_amount, or max_amount too large), or if there is
+/// not enough memory for the cache. Requires the heap lock. The function is executed in constant time.
+O1HeapCache* o1heapCacheInit(O1HeapInstance* const handle, const size_t max_amount, const size_t depth);
+
+/// Releases all fragments held by the cache and the cache itself back to the heap. The cache pointer is invalidated.
+/// Requires the heap lock. The execution time is linear in the number of cached fragments.
+void o1heapCacheDestroy(O1HeapCache* const cache);
+
+/// Attempts to serve the allocation request from the cache without touching the heap.
+/// Returns NULL if the cache has no fragment for the requested amount (including zero and the amounts above
+/// max_amount); in that case the application should take the heap lock and invoke o1heapCacheRefill().
+/// Does not require the heap lock. The function is executed in constant time.
+void* o1heapCacheAllocate(O1HeapCache* const cache, const size_t amount);
+
+/// Allocates memory from the heap, replenishing the cache stack of the corresponding size class along the way:
+/// if the stack is less than half-full, it is topped up to half of its depth using o1heapAllocateBatch().
+/// If the amount is not cacheable, the call is equivalent to o1heapAllocate().
+/// Returns NULL if the heap is out of memory. Requires the heap lock.
+/// The execution time is linear in the cache depth and constant per fragment.
+void* o1heapCacheRefill(O1HeapCache* const cache, const size_t amount);
+
+/// Attempts to return the fragment to the cache without touching the heap.
+/// Returns false if the cache is full or the fragment is too large to be cached; in that case the application
+/// should take the heap lock and invoke o1heapCacheFlush(). A NULL pointer is accepted (returns true).
+/// The pointer may originate from any cache over the same heap or from the heap itself.
+/// The memory allocated with a non-zero tag (see o1heapAllocateTagged()) is never cached, so that the fragments
+/// handed out by the cache are always untagged; such memory shall be returned via o1heapCacheFlush() instead.
+/// Does not require the heap lock. The function is executed in constant time.
+bool o1heapCacheFree(O1HeapCache* const cache, void* const pointer);
+
+/// Deallocates the fragment, flushing the cache stack of the corresponding size class along the way:
+/// if the stack is more than half-full, its oldest fragments are returned to the heap using o1heapFreeBatch(),
+/// and the specified fragment is pushed onto the stack instead of being freed.
+/// If the fragment is not cacheable (too large or tagged), the call is equivalent to o1heapFree().
+/// Requires the heap lock.
+/// The execution time is linear in the cache depth and constant per fragment.
+void o1heapCacheFlush(O1HeapCache* const cache, void* const pointer);
+
+/// Initializes a thread-safe heap in the specified arena. The arena is split into 'shard_count' equal shards,
+/// each of which is an independent heap guarded by its own spinlock, so that the threads that use different shards
+/// do not contend with each other. The per-shard overhead is the same as that of o1heapInit().
+/// The alignment requirements and the behavior in case of invalid arguments are the same as for o1heapInit().
+/// NULL is also returned if the library is built without the atomic operations (see O1HEAP_ATOMIC_LOAD).
+/// The concurrent heap shall only be accessed via the functions below.
+O1HeapConcurrent* o1heapConcurrentInit(void* const base, const size_t size, const size_t shard_count);
+
+/// The semantics is the same as that of o1heapAllocate(). The function is thread-safe.
+/// The hint is an arbitrary integer that selects the preferred shard, such as the index of the current thread or CPU;
+/// giving different threads different hints reduces contention. If the preferred shard cannot serve the request,
+/// the other shards are tried in order without waiting; the shards that are locked by other threads are skipped and
+/// waited for afterwards, one at a time. The shards are visited in groups of (sizeof(size_t) * CHAR_BIT), so
+/// the skipped shards are revisited after the rest of their group rather than after all shards.
+/// Failed requests are registered in the diagnostics of the preferred shard only.
+///
+/// The number of shard visits is at most twice the number of shards, each visit taking constant time,
+/// not counting the time spent waiting for the locks.
+void* o1heapConcurrentAllocate(O1HeapConcurrent* const handle, const size_t hint, const size_t amount);
+
+/// The semantics is the same as that of o1heapFree(). The function is thread-safe.
+/// The fragment can be freed by any thread regardless of which shard it was allocated from;
+/// the owning shard is found by address in constant time.
+void o1heapConcurrentFree(O1HeapConcurrent* const handle, void* const pointer);
+
+/// Same as o1heapDoInvariantsHold() applied to every shard. The function is thread-safe.
+bool o1heapConcurrentDoInvariantsHold(O1HeapConcurrent* const handle);
+
+/// Returns the diagnostics aggregated over all shards. The function is thread-safe.
+/// The peak request size is the maximum over all shards; the other values are summed up, so peak_allocated
+/// is an upper bound because the shards may have reached their peaks at different times.
+O1HeapDiagnostics o1heapConcurrentGetDiagnostics(O1HeapConcurrent* const handle);
+
+/// Same as o1heapGetFragmentation() with the statistics summed up over all shards. The function is thread-safe.
+void o1heapConcurrentGetFragmentation(O1HeapConcurrent* const handle, O1HeapFragmentation* const out);
+
+/// Creates a slab allocator front-end over the heap. The slab allocator serves small requests of up to
+/// O1HEAP_SLAB_AMOUNT_MAX bytes without the per-fragment overhead of the heap: each request is rounded up to
+/// the nearest of the exact size classes 8, 16, 24, 32, or 48 bytes and served from a slab -- a heap fragment
+/// of 'slab_size' bytes (overhead included) that is split into equal slots of the same class. A new slab is
+/// allocated from the heap when no slab of the class has a free slot, and it is returned to the heap as soon as
+/// its last slot is freed. The slab allocator is not thread-safe, same as the heap itself.
+///
+/// The slab size shall be an integer power of 2, large enough to accommodate at least one slot of the largest
+/// class, not larger than 65536 bytes, and not larger than the capacity of the heap. Larger slabs reduce the
+/// per-slab overhead and the number of heap calls at the cost of a coarser granularity of the memory returned
+/// to the heap; a few kibibytes is a sensible choice. The slabs are allocated using o1heapAllocateAligned()
+/// with the alignment equal to the slab size, see the README for the corresponding worst-case memory consumption.
+///
+/// Returns NULL if the slab size is invalid or if there is not enough memory for the slab allocator itself.
+/// The function is executed in constant time.
+O1HeapSlab* o1heapSlabInit(O1HeapInstance* const handle, const size_t slab_size);
+
+/// Releases the slab allocator back to the heap. The slab allocator pointer is invalidated.
+/// All memory allocated from the slab allocator shall be freed beforehand, so that no slabs are left.
+/// The function is executed in constant time.
+void o1heapSlabDestroy(O1HeapSlab* const slab);
+
+/// Allocates a slot of the smallest size class that can accommodate the requested amount.
+/// The memory is aligned at the largest integer power of 2 that divides the class size or at O1HEAP_ALIGNMENT,
+/// whichever is smaller. The slot is taken from a slab of the class that has a free slot;
+/// if there is none, a new slab is allocated from the heap.
+///
+/// Returns NULL if the amount is zero or exceeds O1HEAP_SLAB_AMOUNT_MAX, or if the heap is out of memory;
+/// in the latter case the failure is registered in the diagnostics of the heap as usual.
+/// The function is executed in constant time.
+/// The allocated memory is NOT zero-filled.
+void* o1heapSlabAllocate(O1HeapSlab* const slab, const size_t amount);
+
+/// Frees the memory allocated by o1heapSlabAllocate() from the same slab allocator; other pointers shall not be
+/// passed here. If the slab that contains the slot becomes empty, it is returned to the heap.
+/// A NULL pointer is accepted (no-op). The function is executed in constant time.
+void o1heapSlabFree(O1HeapSlab* const slab, void* const pointer);
+
+/// Creates a child heap in a block of 'size' bytes allocated from the parent heap. The child is an ordinary heap
+/// that can be used with all functions that take O1HeapInstance, except that o1heapAddRegion() always returns false
+/// for it; use o1heapChildGrow() instead. A child heap can be a parent to other child heaps in turn.
+/// This is intended for groups of objects that die together, such as the per-connection state of a server:
+/// they are allocated from a child heap, which is then destroyed at once instead of freeing the objects one by one.
+///
+/// Returns NULL if the parent cannot allocate the block or if the block is too small to host a heap,
+/// see o1heapInit(); the parent is left unchanged in that case. The capacity of the child is smaller than the size
+/// of the block due to the overheads of the parent fragment and of the child instance.
+/// The function is executed in constant time.
+O1HeapInstance* o1heapChildInit(O1HeapInstance* const parent, const size_t size);
+
+/// Grows the child heap by allocating another block of 'size' bytes from its parent and attaching it to the child
+/// as a new region, see o1heapAddRegion(). Fragments are never merged across blocks, so the largest allocation
+/// that the child can serve is limited by the largest block.
+///
+/// Returns false if the heap is not a child, if the parent cannot allocate the block, or if the block cannot be
+/// attached; the parent is left unchanged in that case. The function is executed in constant time.
+bool o1heapChildGrow(O1HeapInstance* const child, const size_t size);
+
+/// Returns every block of the child heap to its parent, invoking o1heapFree() once per block. All memory allocated
+/// from the child (including that of its own child heaps, if any) is released implicitly, and all pointers into
+/// the child become invalid, including the child handle itself. The fragments allocated from the child are not
+/// visited, so the execution time is linear in the number of blocks and does not depend on the number of allocations.
+///
+/// Builds where assertion checks are enabled will trigger an assertion failure if the heap is not a child.
+void o1heapChildDestroy(O1HeapInstance* const child);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,350 @@
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+// documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions
+// of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+// WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+// OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+// Copyright (c) 2020 Pavel Kirienko
+// Authors: Pavel Kirienko <pavel.kirienko@zubax.com>
+
+// Compares the free list policies (see o1heapSetFreeListPolicy()) by replaying allocation traces while counting
+// the cache and TLB misses using perf_event_open(2); hence, this benchmark is Linux-only.
+//
+// Usage: bench_free_list_policy [trace-file...]
+//
+// Each line of a trace file is either "a <id> <size>", which allocates <size> bytes, fills them, and associates the
+// memory with the arbitrary integer <id>; or "f <id>", which reads the memory associated with <id> and frees it.
+// Blank lines and lines starting with '#' are ignored. If no trace files are given, a synthetic trace is used that
+// models a stream of messages of random size that are released approximately in the order of their arrival.
+// The counters may be unavailable depending on the hardware and on the value of kernel.perf_event_paranoid.
+
+#include "o1heap.h"
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+constexpr std::size_t ArenaSize = 256UL * 1024UL * 1024UL;
+
+/// The trace is preprocessed such that the replay loop does not touch any data structures other than the heap
+/// and the allocated memory; the identifiers are mapped to dense slot indexes.
+struct Operation final
+{
+    bool        allocate = false;
+    std::size_t slot     = 0;
+    std::size_t size     = 0;
+};
+
+struct Trace final
+{
+    std::string            name;
+    std::vector<Operation> operations;
+    std::size_t            slot_count = 0;
+};
+
+/// A hardware event counter that reports nothing if the event is not supported or not permitted.
+class Counter final
+{
+public:
+    Counter(const std::uint32_t type, const std::uint64_t config)
+    {
+        perf_event_attr attr{};
+        attr.size           = sizeof(attr);
+        attr.type           = type;
+        attr.config         = config;
+        attr.disabled       = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv     = 1;
+        fd_ = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+    ~Counter()
+    {
+        if (fd_ >= 0)
+        {
+            (void) close(fd_);
+        }
+    }
+    Counter(const Counter&)                    = delete;
+    Counter(Counter&&)                         = delete;
+    auto operator=(const Counter&) -> Counter& = delete;
+    auto operator=(Counter&&) -> Counter&      = delete;
+
+    [[nodiscard]] auto isAvailable() const { return fd_ >= 0; }
+
+    void start() const
+    {
+        if (fd_ >= 0)
+        {
+            (void) ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+            (void) ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+
+    [[nodiscard]] auto stop() const -> std::optional<std::uint64_t>
+    {
+        std::optional<std::uint64_t> out;
+        std::uint64_t                value = 0;
+        if (fd_ >= 0)
+        {
+            (void) ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+            if (read(fd_, &value, sizeof(value)) == static_cast<ssize_t>(sizeof(value)))
+            {
+                out = value;
+            }
+        }
+        return out;
+    }
+
+private:
+    int fd_ = -1;
+};
+
+constexpr auto makeCacheEventConfig(const std::uint64_t cache) -> std::uint64_t
+{
+    return cache | (static_cast<std::uint64_t>(PERF_COUNT_HW_CACHE_OP_READ) << 8U) |
+           (static_cast<std::uint64_t>(PERF_COUNT_HW_CACHE_RESULT_MISS) << 16U);
+}
+
+auto loadTrace(const std::string& path) -> Trace
+{
+    Trace         out{path, {}, 0};
+    std::ifstream file(path);
+    if (!file)
+    {
+        throw std::runtime_error("Cannot open " + path);
+    }
+    std::unordered_map<std::uint64_t, std::size_t> slots;
+    std::vector<std::size_t>                       free_slots;
+    std::string                                    line;
+    while (std::getline(file, line))
+    {
+        std::istringstream stream(line);
+        std::string        kind;
+        std::uint64_t      id = 0;
+        if ((!(stream >> kind)) || (kind.front() == '#'))
+        {
+            continue;
+        }
+        if (!(stream >> id))
+        {
+            throw std::runtime_error("Malformed line in " + path + ": " + line);
+        }
+        if (kind == "a")
+        {
+            std::size_t size = 0;
+            if ((!(stream >> size)) || (slots.count(id) != 0U))
+            {
+                throw std::runtime_error("Malformed allocation in " + path + ": " + line);
+            }
+            std::size_t slot = out.slot_count;
+            if (free_slots.empty())
+            {
+                out.slot_count++;
+            }
+            else
+            {
+                slot = free_slots.back();
+                free_slots.pop_back();
+            }
+            slots[id] = slot;
+            out.operations.push_back({true, slot, size});
+        }
+        else if ((kind == "f") && (slots.count(id) != 0U))
+        {
+            out.operations.push_back({false, slots.at(id), 0});
+            free_slots.push_back(slots.at(id));
+            slots.erase(id);
+        }
+        else
+        {
+            throw std::runtime_error("Malformed line in " + path + ": " + line);
+        }
+    }
+    return out;
+}
+
+auto makeSyntheticTrace() -> Trace
+{
+    constexpr std::size_t MessageCount = 1'000'000;
+    constexpr std::size_t InFlightMax  = 512;
+    constexpr std::size_t Reordering   = 16;  ///< A message is freed among the oldest ones in flight.
+
+    Trace                                 out{"synthetic-stream", {}, InFlightMax + 1U};
+    std::mt19937                          random_generator(42U);  // NOLINT: fixed seed for reproducibility.
+    std::lognormal_distribution<double>   size_distribution(6.0, 1.0);
+    std::uniform_int_distribution<size_t> reorder_distribution(0, Reordering - 1U);
+    std::deque<std::size_t>               in_flight;
+    std::vector<std::size_t>              free_slots(out.slot_count);
+    std::iota(std::begin(free_slots), std::end(free_slots), 0U);
+    for (std::size_t i = 0; i < MessageCount; i++)
+    {
+        const auto slot = free_slots.back();
+        free_slots.pop_back();
+        const auto size = std::clamp(static_cast<std::size_t>(size_distribution(random_generator)), 1UL, 8192UL);
+        out.operations.push_back({true, slot, size});
+        in_flight.push_back(slot);
+        if (in_flight.size() > InFlightMax)
+        {
+            const auto it = std::begin(in_flight) +
+                            static_cast<std::ptrdiff_t>(reorder_distribution(random_generator) % in_flight.size());
+            out.operations.push_back({false, *it, 0});
+            free_slots.push_back(*it);
+            in_flight.erase(it);
+        }
+    }
+    return out;
+}
+
+struct Result final
+{
+    double        time_ms      = 0;
+    std::optional<std::uint64_t> cache_misses;
+    std::optional<std::uint64_t> l1d_misses;
+    std::optional<std::uint64_t> dtlb_misses;
+    std::uint64_t                oom_count = 0;
+};
+
+auto formatCount(const std::optional<std::uint64_t>& value) -> std::string
+{
+    return value ? std::to_string(*value) : "n/a";
+}
+
+auto replay(const Trace& trace, std::byte* const arena, const O1HeapFreeListPolicy policy) -> Result
+{
+    O1HeapInstance* const heap = o1heapInit(arena, ArenaSize);
+    if (heap == nullptr)
+    {
+        throw std::runtime_error("Heap init failed");
+    }
+    o1heapSetFreeListPolicy(heap, policy);
+
+    const Counter cache_misses(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    const Counter l1d_misses(PERF_TYPE_HW_CACHE, makeCacheEventConfig(PERF_COUNT_HW_CACHE_L1D));
+    const Counter dtlb_misses(PERF_TYPE_HW_CACHE, makeCacheEventConfig(PERF_COUNT_HW_CACHE_DTLB));
+
+    std::vector<std::pair<void*, std::size_t>> slots(trace.slot_count, {nullptr, 0});
+    volatile std::uint8_t                      sink = 0;
+    const auto                                 started_at = std::chrono::steady_clock::now();
+    cache_misses.start();
+    l1d_misses.start();
+    dtlb_misses.start();
+    for (const auto& op : trace.operations)
+    {
+        auto& [ptr, size] = slots.at(op.slot);
+        if (op.allocate)
+        {
+            ptr  = o1heapAllocate(heap, op.size);
+            size = (ptr != nullptr) ? op.size : 0U;
+            if (ptr != nullptr)
+            {
+                std::memset(ptr, static_cast<int>(op.slot & 0xFFU), size);
+            }
+        }
+        else
+        {
+            std::uint8_t acc = 0;
+            for (std::size_t i = 0; i < size; i++)
+            {
+                acc = static_cast<std::uint8_t>(acc + static_cast<const std::uint8_t*>(ptr)[i]);
+            }
+            sink = static_cast<std::uint8_t>(sink ^ acc);
+            o1heapFree(heap, ptr);
+            ptr = nullptr;
+        }
+    }
+    Result out{};
+    out.dtlb_misses  = dtlb_misses.stop();
+    out.l1d_misses   = l1d_misses.stop();
+    out.cache_misses = cache_misses.stop();
+    out.time_ms   = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started_at).count();
+    out.oom_count = o1heapGetDiagnostics(heap).oom_count;
+    return out;
+}
+}  // namespace
+
+auto main(const int argc, const char* const argv[]) -> int
+{
+    std::vector<Trace> traces;
+    try
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            traces.push_back(loadTrace(argv[i]));  // NOLINT: pointer arithmetic
+        }
+    }
+    catch (const std::exception& ex)
+    {
+        std::cerr << ex.what() << std::endl;
+        return 1;
+    }
+    if (traces.empty())
+    {
+        traces.push_back(makeSyntheticTrace());
+    }
+
+    const std::shared_ptr<std::byte> arena(static_cast<std::byte*>(std::aligned_alloc(4096U, ArenaSize)), &std::free);
+    std::memset(arena.get(), 0, ArenaSize);  // Pre-fault the pages to keep the page faults out of the measurement.
+    if (!Counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES).isAvailable())
+    {
+        std::cerr << "Warning: the hardware counters are unavailable; check kernel.perf_event_paranoid" << std::endl;
+    }
+
+    const std::array<std::pair<O1HeapFreeListPolicy, const char*>, 3> policies{{
+        {O1HEAP_FREE_LIST_MRU, "mru"},
+        {O1HEAP_FREE_LIST_FIFO, "fifo"},
+        {O1HEAP_FREE_LIST_ADDRESS_ORDERED, "address-ordered"},
+    }};
+    std::printf("%-24s %-16s %10s %14s %14s %14s %8s\n",
+                "trace",
+                "policy",
+                "time_ms",
+                "cache_misses",
+                "l1d_misses",
+                "dtlb_misses",
+                "oom");
+    for (const auto& trace : traces)
+    {
+        (void) replay(trace, arena.get(), O1HEAP_FREE_LIST_MRU);  // Warm up.
+        for (const auto& [policy, name] : policies)
+        {
+            const auto r = replay(trace, arena.get(), policy);
+            std::printf("%-24s %-16s %10.1f %14s %14s %14s %8llu\n",
+                        trace.name.c_str(),
+                        name,
+                        r.time_ms,
+                        formatCount(r.cache_misses).c_str(),
+                        formatCount(r.l1d_misses).c_str(),
+                        formatCount(r.dtlb_misses).c_str(),
+                        static_cast<unsigned long long>(r.oom_count));
+        }
+    }
+    return 0;
+}
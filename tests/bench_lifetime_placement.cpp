@@ -0,0 +1,353 @@
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+// documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions
+// of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+// WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+// OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+// Copyright (c) 2020 Pavel Kirienko
+// Authors: Pavel Kirienko <pavel.kirienko@zubax.com>
+
+// Compares the fragmentation with and without the lifetime hints (see o1heapAllocateHinted()) by replaying
+// allocation traces in an arena that is twice as large as the peak amount of memory in use by the trace.
+//
+// Usage: bench_lifetime_placement [trace-file...]
+//
+// Each line of a trace file is either "a <id> <size> [s|l]", which allocates <size> bytes with the short-lived (s)
+// or the long-lived (l) hint and associates the memory with the arbitrary integer <id>; or "f <id>", which frees the
+// memory associated with <id>. Blank lines and lines starting with '#' are ignored. The format is compatible with
+// bench_free_list_policy. If the hint is omitted, as in the traces recorded without the knowledge of the lifetimes,
+// it is derived from the trace itself: the allocation is long-lived if it outlives the next LongLivedThreshold
+// operations or is never freed. If no trace files are given, a synthetic trace is used that models a long-running
+// service: bursts of short-lived messages interleaved with sessions that are opened and closed occasionally.
+//
+// The fragmentation is defined as (1 - largest_free_fragment / free_memory); it is sampled every SamplingPeriod
+// operations and whenever an allocation fails, and its peak and mean are reported along with the number of failures.
+
+#include "o1heap.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+constexpr std::size_t LongLivedThreshold = 10'000;
+constexpr std::size_t SamplingPeriod     = 1'000;
+constexpr std::size_t ArenaFactor        = 2;
+
+/// The trace is preprocessed such that the identifiers are mapped to dense slot indexes.
+struct Operation final
+{
+    bool        allocate  = false;
+    bool        long_term = false;
+    std::size_t slot      = 0;
+    std::size_t size      = 0;
+};
+
+struct Trace final
+{
+    std::string            name;
+    std::vector<Operation> operations;
+    std::size_t            slot_count = 0;
+    std::size_t            peak_live  = 0;  ///< The peak total size of the fragments in use.
+};
+
+/// The size of the fragment that serves the request, which is assumed to be a power of two as in o1heap.
+auto getFragmentSize(const std::size_t amount) -> std::size_t
+{
+    std::size_t out = O1HEAP_ALIGNMENT * 2U;
+    while (out < (amount + O1HEAP_ALIGNMENT))
+    {
+        out *= 2U;
+    }
+    return out;
+}
+
+/// Finds the peak amount of memory in use; the hints are derived from the lifetimes unless given explicitly.
+void analyze(Trace& trace, const std::vector<bool>& explicit_hint)
+{
+    std::vector<std::size_t> allocated_at(trace.slot_count, 0);
+    std::size_t              live = 0;
+    for (std::size_t i = 0; i < trace.operations.size(); i++)
+    {
+        auto& op = trace.operations.at(i);
+        if (op.allocate)
+        {
+            allocated_at.at(op.slot) = i;
+            op.long_term             = explicit_hint.at(i) ? op.long_term : true;  // Never freed unless found below.
+            live += getFragmentSize(op.size);
+            trace.peak_live = std::max(trace.peak_live, live);
+        }
+        else
+        {
+            auto& alloc = trace.operations.at(allocated_at.at(op.slot));
+            if (!explicit_hint.at(allocated_at.at(op.slot)))
+            {
+                alloc.long_term = (i - allocated_at.at(op.slot)) > LongLivedThreshold;
+            }
+            live -= getFragmentSize(alloc.size);
+        }
+    }
+}
+
+auto loadTrace(const std::string& path) -> Trace
+{
+    Trace         out{path, {}, 0, 0};
+    std::ifstream file(path);
+    if (!file)
+    {
+        throw std::runtime_error("Cannot open " + path);
+    }
+    std::unordered_map<std::uint64_t, std::size_t> slots;
+    std::vector<std::size_t>                       free_slots;
+    std::vector<bool>                              explicit_hint;
+    std::string                                    line;
+    while (std::getline(file, line))
+    {
+        std::istringstream stream(line);
+        std::string        kind;
+        std::uint64_t      id = 0;
+        if ((!(stream >> kind)) || (kind.front() == '#'))
+        {
+            continue;
+        }
+        if (!(stream >> id))
+        {
+            throw std::runtime_error("Malformed line in " + path + ": " + line);
+        }
+        if (kind == "a")
+        {
+            std::size_t size = 0;
+            std::string hint;
+            if ((!(stream >> size)) || (slots.count(id) != 0U))
+            {
+                throw std::runtime_error("Malformed allocation in " + path + ": " + line);
+            }
+            if ((stream >> hint) && (hint != "s") && (hint != "l"))
+            {
+                throw std::runtime_error("Malformed lifetime hint in " + path + ": " + line);
+            }
+            std::size_t slot = out.slot_count;
+            if (free_slots.empty())
+            {
+                out.slot_count++;
+            }
+            else
+            {
+                slot = free_slots.back();
+                free_slots.pop_back();
+            }
+            slots[id] = slot;
+            out.operations.push_back({true, hint == "l", slot, size});
+            explicit_hint.push_back(!hint.empty());
+        }
+        else if ((kind == "f") && (slots.count(id) != 0U))
+        {
+            out.operations.push_back({false, false, slots.at(id), 0});
+            explicit_hint.push_back(false);
+            free_slots.push_back(slots.at(id));
+            slots.erase(id);
+        }
+        else
+        {
+            throw std::runtime_error("Malformed line in " + path + ": " + line);
+        }
+    }
+    analyze(out, explicit_hint);
+    return out;
+}
+
+auto makeSyntheticTrace() -> Trace
+{
+    constexpr std::size_t BurstCount       = 2'000;
+    constexpr std::size_t BurstSizeMax     = 2'048;  ///< The messages of a burst are freed at its end.
+    constexpr std::size_t SessionCountMax  = 64;
+    constexpr std::size_t SessionOpenEvery = 200;  ///< A session is opened (or replaced) once per this many messages.
+
+    Trace                                 out{"synthetic-service", {}, BurstSizeMax + SessionCountMax + 1U, 0};
+    std::mt19937                          random_generator(42U);  // NOLINT: fixed seed for reproducibility.
+    std::lognormal_distribution<double>   message_size(6.0, 1.0);
+    std::uniform_int_distribution<size_t> session_size(64, 2048);
+    std::uniform_int_distribution<size_t> burst_size(BurstSizeMax / 8U, BurstSizeMax);
+    std::vector<std::size_t>              messages;
+    std::vector<std::size_t>              sessions;
+    std::vector<std::size_t>              free_slots(out.slot_count);
+    std::iota(std::begin(free_slots), std::end(free_slots), 0U);
+    const auto allocate = [&](const bool long_term, const std::size_t size) {
+        const auto slot = free_slots.back();
+        free_slots.pop_back();
+        out.operations.push_back({true, long_term, slot, size});
+        return slot;
+    };
+    const auto release = [&](const std::size_t slot) {
+        out.operations.push_back({false, false, slot, 0});
+        free_slots.push_back(slot);
+    };
+    std::size_t message_count = 0;
+    for (std::size_t burst = 0; burst < BurstCount; burst++)
+    {
+        const auto count = burst_size(random_generator);
+        for (std::size_t i = 0; i < count; i++)
+        {
+            const auto size = std::clamp(static_cast<std::size_t>(message_size(random_generator)), 1UL, 8192UL);
+            messages.push_back(allocate(false, size));
+            if (((++message_count) % SessionOpenEvery) == 0U)
+            {
+                if (sessions.size() >= SessionCountMax)
+                {
+                    const auto it = std::begin(sessions) +
+                                    static_cast<std::ptrdiff_t>(random_generator() % sessions.size());
+                    release(*it);
+                    sessions.erase(it);
+                }
+                sessions.push_back(allocate(true, session_size(random_generator)));
+            }
+        }
+        std::shuffle(std::begin(messages), std::end(messages), random_generator);
+        for (const auto slot : messages)
+        {
+            release(slot);
+        }
+        messages.clear();
+    }
+    analyze(out, std::vector<bool>(out.operations.size(), true));
+    return out;
+}
+
+struct Result final
+{
+    double        peak_fragmentation = 0;
+    double        mean_fragmentation = 0;
+    std::uint64_t oom_count          = 0;
+};
+
+auto getArenaSize(const Trace& trace) -> std::size_t
+{
+    return (trace.peak_live * ArenaFactor) + 65536U;  // The instance and the bins are small enough to fit the margin.
+}
+
+auto measureFragmentation(const O1HeapInstance* const heap) -> double
+{
+    struct Context final
+    {
+        std::size_t free    = 0;
+        std::size_t largest = 0;
+    } ctx;
+    (void) o1heapTraverse(
+        heap,
+        [](void* const context, const O1HeapFragmentInfo* const info) {
+            auto& c = *static_cast<Context*>(context);
+            if (!info->used)
+            {
+                c.free += info->size;
+                c.largest = std::max(c.largest, info->size);
+            }
+            return true;
+        },
+        &ctx);
+    return (ctx.free > 0U) ? (1.0 - (static_cast<double>(ctx.largest) / static_cast<double>(ctx.free))) : 0.0;
+}
+
+auto replay(const Trace& trace, const bool hinted) -> Result
+{
+    const std::size_t                arena_size = getArenaSize(trace);
+    const std::shared_ptr<std::byte> arena(static_cast<std::byte*>(std::aligned_alloc(4096U, arena_size)), &std::free);
+    O1HeapInstance* const            heap = o1heapInit(arena.get(), arena_size);
+    if (heap == nullptr)
+    {
+        throw std::runtime_error("Heap init failed");
+    }
+    Result             out{};
+    double             total_fragmentation = 0;
+    std::size_t        sample_count        = 0;
+    std::vector<void*> slots(trace.slot_count, nullptr);
+    const auto         sample = [&] {
+        const auto f           = measureFragmentation(heap);
+        out.peak_fragmentation = std::max(out.peak_fragmentation, f);
+        total_fragmentation += f;
+        sample_count++;
+    };
+    for (std::size_t i = 0; i < trace.operations.size(); i++)
+    {
+        const auto& op  = trace.operations.at(i);
+        auto&       ptr = slots.at(op.slot);
+        if (op.allocate)
+        {
+            const auto lifetime = (hinted && op.long_term) ? O1HEAP_LIFETIME_LONG : O1HEAP_LIFETIME_SHORT;
+            ptr                 = o1heapAllocateHinted(heap, op.size, lifetime);
+            if (ptr == nullptr)
+            {
+                sample();
+            }
+        }
+        else
+        {
+            o1heapFree(heap, ptr);
+            ptr = nullptr;
+        }
+        if ((i % SamplingPeriod) == 0U)
+        {
+            sample();
+        }
+    }
+    out.mean_fragmentation = (sample_count > 0U) ? (total_fragmentation / static_cast<double>(sample_count)) : 0.0;
+    out.oom_count          = o1heapGetDiagnostics(heap).oom_count;
+    return out;
+}
+}  // namespace
+
+auto main(const int argc, const char* const argv[]) -> int
+{
+    std::vector<Trace> traces;
+    try
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            traces.push_back(loadTrace(argv[i]));  // NOLINT: pointer arithmetic
+        }
+    }
+    catch (const std::exception& ex)
+    {
+        std::cerr << ex.what() << std::endl;
+        return 1;
+    }
+    if (traces.empty())
+    {
+        traces.push_back(makeSyntheticTrace());
+    }
+
+    std::printf("%-24s %-8s %12s %16s %16s %8s\n", "trace", "hints", "arena_kib", "peak_frag_pct", "mean_frag_pct", "oom");
+    for (const auto& trace : traces)
+    {
+        for (const bool hinted : {false, true})
+        {
+            const auto r = replay(trace, hinted);
+            std::printf("%-24s %-8s %12zu %16.1f %16.1f %8llu\n",
+                        trace.name.c_str(),
+                        hinted ? "on" : "off",
+                        getArenaSize(trace) / 1024U,
+                        r.peak_fragmentation * 100.0,
+                        r.mean_fragmentation * 100.0,
+                        static_cast<unsigned long long>(r.oom_count));
+        }
+    }
+    return 0;
+}
@@ -19,6 +19,7 @@
 
 #include "catch.hpp"
 #include "o1heap.h"
+#include <algorithm>
 #include <array>
 #include <cstdarg>
 #include <cstddef>
@@ -29,6 +30,16 @@
 #include <sstream>
 #include <vector>
 
+#ifndef O1HEAP_SUBBIN_BITS
+#    define O1HEAP_SUBBIN_BITS 0U
+#endif
+#ifndef O1HEAP_FLOOR_PROBE_LIMIT
+#    define O1HEAP_FLOOR_PROBE_LIMIT 0U
+#endif
+#ifndef O1HEAP_DEFERRED_COALESCING
+#    define O1HEAP_DEFERRED_COALESCING 0
+#endif
+
 /// Definitions that are not exposed by the library but that are needed for testing.
 /// Please keep them in sync with the library by manually updating as necessary.
 namespace internal
@@ -38,27 +49,53 @@ auto log2Floor(const std::size_t x) -> std::uint8_t;
 auto log2Ceil(const std::size_t x) -> std::uint8_t;
 auto pow2(const std::uint8_t power) -> std::size_t;
 auto roundUpToPowerOf2(const std::size_t x) -> std::size_t;
+auto roundUpToBin(const std::size_t x) -> std::size_t;
+auto getBinIndex(const std::size_t size) -> std::size_t;
 }
 
 struct Fragment;
 
+constexpr std::size_t NumBinsMax = sizeof(std::size_t) * 8U;
+constexpr std::size_t NumSubbins = static_cast<std::size_t>(1) << O1HEAP_SUBBIN_BITS;
+
+#if O1HEAP_COMPACT_HEADERS
+using FragmentLink = std::int32_t;
+#else
+using FragmentLink = Fragment*;
+#endif
+
+/// Please maintain the fields in exact sync with the private definition in o1heap.c!
+/// The fields shall be accessed via the accessors of Fragment because their format depends on the configuration.
 struct FragmentHeader final
 {
-    Fragment*   next = nullptr;
-    Fragment*   prev = nullptr;
-    std::size_t size = 0U;
-    bool        used = false;
+#if O1HEAP_COMPACT_HEADERS
+    FragmentLink  next = std::numeric_limits<FragmentLink>::min();
+    FragmentLink  prev = std::numeric_limits<FragmentLink>::min();
+    std::uint32_t size = 0U;  ///< Bit 0 is the used flag, bit 1 is the zeroed flag, bit 2 is the movable flag.
+#else
+    FragmentLink next    = nullptr;
+    FragmentLink prev    = nullptr;
+    std::size_t  size    = 0U;
+    bool         used    = false;
+    bool         zeroed  = false;
+    bool         movable = false;
+#endif
+    std::uint8_t tag = 0U;
 };
 
 struct Fragment final
 {
     FragmentHeader header;
 
-    Fragment* next_free = nullptr;
-    Fragment* prev_free = nullptr;
+    FragmentLink next_free{};
+    FragmentLink prev_free{};
 
     static constexpr auto SizeMin = O1HEAP_ALIGNMENT * 2U;
+#if O1HEAP_COMPACT_HEADERS
+    static constexpr auto SizeMax = static_cast<std::size_t>((std::numeric_limits<std::uint32_t>::max() >> 1U) + 1U);
+#else
     static constexpr auto SizeMax = (std::numeric_limits<std::size_t>::max() >> 1U) + 1U;
+#endif
     static_assert((SizeMin & (SizeMin - 1U)) == 0U);
     static_assert((SizeMax & (SizeMax - 1U)) == 0U);
 
@@ -73,13 +110,46 @@ struct Fragment final
             reinterpret_cast<const void*>(reinterpret_cast<const std::byte*>(memory) - O1HEAP_ALIGNMENT));
     }
 
-    [[nodiscard]] auto getBinIndex() const -> std::uint8_t
+    [[nodiscard]] auto getNext() const { return follow(header.next); }
+    [[nodiscard]] auto getPrev() const { return follow(header.prev); }
+    [[nodiscard]] auto getNextFree() const { return follow(next_free); }
+    [[nodiscard]] auto getPrevFree() const { return follow(prev_free); }
+
+#if O1HEAP_COMPACT_HEADERS
+    [[nodiscard]] auto getSize() const -> std::size_t { return header.size & ~std::uint32_t{7U}; }
+    [[nodiscard]] auto isUsed() const -> bool { return (header.size & 1U) != 0U; }
+    [[nodiscard]] auto isZeroed() const -> bool { return (header.size & 2U) != 0U; }
+    [[nodiscard]] auto isMovable() const -> bool { return (header.size & 4U) != 0U; }
+#else
+    [[nodiscard]] auto getSize() const -> std::size_t { return header.size; }
+    [[nodiscard]] auto isUsed() const -> bool { return header.used; }
+    [[nodiscard]] auto isZeroed() const -> bool { return header.zeroed; }
+    [[nodiscard]] auto isMovable() const -> bool { return header.movable; }
+#endif
+    [[nodiscard]] auto getTag() const -> std::uint8_t { return header.tag; }
+
+    /// The index of the bin of this fragment if it were free: first-level index * NumSubbins + second-level index.
+    [[nodiscard]] auto getBinIndex() const -> std::size_t
     {
-        const bool aligned  = (header.size % SizeMin) == 0U;
-        const bool nonempty = header.size >= SizeMin;
+        const bool aligned  = (getSize() % SizeMin) == 0U;
+        const bool nonempty = getSize() >= SizeMin;
         if (aligned && nonempty)
         {
-            return static_cast<std::uint8_t>(std::floor(std::log2(header.size / SizeMin)));
+            // Integer log2 because the floating-point one rounds up near the upper limit of the size range.
+            const auto   units = getSize() / SizeMin;
+            std::uint8_t fl    = 0U;
+            for (auto x = units; x > 1U; x >>= 1U)
+            {
+                fl++;
+            }
+#if O1HEAP_SUBBIN_BITS > 0
+            // The second-level index is made of the bits that follow the most significant one.
+            const std::size_t sl = (fl >= O1HEAP_SUBBIN_BITS) ? ((units >> (fl - O1HEAP_SUBBIN_BITS)) - NumSubbins)
+                                                              : ((units << (O1HEAP_SUBBIN_BITS - fl)) - NumSubbins);
+            return (fl * NumSubbins) + sl;
+#else
+            return fl;
+#endif
         }
         throw std::logic_error("Invalid fragment size");
     }
@@ -87,46 +157,46 @@ struct Fragment final
     void validate() const
     {
         const auto address = reinterpret_cast<std::size_t>(this);
-        REQUIRE((address % sizeof(void*)) == 0U);
+        REQUIRE((address % sizeof(std::uint32_t)) == 0U);
 
         // Size correctness.
-        REQUIRE(header.size >= SizeMin);
-        REQUIRE(header.size <= SizeMax);
-        REQUIRE((header.size % SizeMin) == 0U);
+        REQUIRE(getSize() >= SizeMin);
+        REQUIRE(getSize() <= SizeMax);
+        REQUIRE((getSize() % SizeMin) == 0U);
+        REQUIRE(((!isUsed()) || (getTag() < O1HEAP_TAG_COUNT)));
 
         // Heap fragment interlinking. Free blocks cannot neighbor each other because they are supposed to be merged.
-        if (header.next != nullptr)
+        if (getNext() != nullptr)
         {
-            REQUIRE((header.used || header.next->header.used));
-            const auto adr = reinterpret_cast<std::size_t>(header.next);
-            REQUIRE((adr % sizeof(void*)) == 0U);
-            REQUIRE(header.next->header.prev == this);
+            REQUIRE((isUsed() || getNext()->isUsed()));
+            const auto adr = reinterpret_cast<std::size_t>(getNext());
+            REQUIRE((adr % sizeof(std::uint32_t)) == 0U);
+            REQUIRE(getNext()->getPrev() == this);
             REQUIRE(adr > address);
             REQUIRE(((adr - address) % SizeMin) == 0U);
         }
-        if (header.prev != nullptr)
+        if (getPrev() != nullptr)
         {
-            REQUIRE((header.used || header.prev->header.used));
-            const auto adr = reinterpret_cast<std::size_t>(header.prev);
-            REQUIRE((adr % sizeof(void*)) == 0U);
-            REQUIRE(header.prev->header.next == this);
+            REQUIRE((isUsed() || getPrev()->isUsed()));
+            const auto adr = reinterpret_cast<std::size_t>(getPrev());
+            REQUIRE((adr % sizeof(std::uint32_t)) == 0U);
+            REQUIRE(getPrev()->getNext() == this);
             REQUIRE(address > adr);
             REQUIRE(((address - adr) % SizeMin) == 0U);
         }
 
         // Segregated free list interlinking.
-        if (!header.used)
+        if (!isUsed())
         {
-            if (next_free != nullptr)
-            {
-                REQUIRE(next_free->prev_free == this);
-                REQUIRE(!next_free->header.used);
-            }
-            if (prev_free != nullptr)
+            if (getNextFree() != nullptr)
             {
-                REQUIRE(prev_free->next_free == this);
-                REQUIRE(!prev_free->header.used);
+                REQUIRE(getNextFree()->getPrevFree() == this);
+                REQUIRE(!getNextFree()->isUsed());
             }
+            // The first fragment in the bin points back to the last one, which has no next.
+            REQUIRE(getPrevFree() != nullptr);
+            REQUIRE(((getPrevFree()->getNextFree() == this) || (getPrevFree()->getNextFree() == nullptr)));
+            REQUIRE(!getPrevFree()->isUsed());
         }
     }
 
@@ -136,18 +206,143 @@ struct Fragment final
     ~Fragment()                                   = delete;
     auto operator=(const Fragment&) -> Fragment&  = delete;
     auto operator=(const Fragment&&) -> Fragment& = delete;
+
+private:
+    /// See makeLink() in o1heap.c.
+    [[nodiscard]] auto follow(const FragmentLink link) const -> const Fragment*
+    {
+#if O1HEAP_COMPACT_HEADERS
+        if (link == std::numeric_limits<FragmentLink>::min())
+        {
+            return nullptr;
+        }
+        const auto delta = static_cast<std::ptrdiff_t>(link) * static_cast<std::ptrdiff_t>(SizeMin);
+        return reinterpret_cast<const Fragment*>(reinterpret_cast<const std::byte*>(this) + delta);
+#else
+        return link;
+#endif
+    }
+};
+
+/// Please maintain the fields in exact sync with the private definition in o1heap.c!
+struct Region final
+{
+    Region*     next     = nullptr;
+    std::size_t capacity = 0U;
+
+    Region()                                  = delete;
+    Region(const Region&)                     = delete;
+    Region(const Region&&)                    = delete;
+    ~Region()                                 = delete;
+    auto operator=(const Region&) -> Region&  = delete;
+    auto operator=(const Region&&) -> Region& = delete;
+};
+
+constexpr auto RegionSizePadded = ((sizeof(Region) + O1HEAP_ALIGNMENT - 1U) / O1HEAP_ALIGNMENT) * O1HEAP_ALIGNMENT;
+
+/// Please maintain the fields in exact sync with the private definition in o1heap.c!
+struct Slab final
+{
+    Slab*         next      = nullptr;
+    Slab*         prev      = nullptr;
+    void*         free_list = nullptr;
+    std::uint16_t used      = 0U;
+    std::uint16_t fresh     = 0U;
+    std::uint8_t  cls       = 0U;
+
+    Slab()                                = delete;
+    Slab(const Slab&)                     = delete;
+    Slab(const Slab&&)                    = delete;
+    ~Slab()                               = delete;
+    auto operator=(const Slab&) -> Slab&  = delete;
+    auto operator=(const Slab&&) -> Slab& = delete;
+};
+
+constexpr auto SlabHeaderSizePadded = ((sizeof(Slab) + O1HEAP_ALIGNMENT - 1U) / O1HEAP_ALIGNMENT) * O1HEAP_ALIGNMENT;
+
+/// Please maintain the fields in exact sync with the private definition in o1heap.c!
+struct ValidationCursor final
+{
+    const Fragment* fragment   = nullptr;
+    std::size_t     region     = 0U;
+    std::size_t     used_size  = 0U;
+    std::size_t     free_size  = 0U;
+    std::size_t     free_count = 0U;
+    bool            unmodified = false;
+};
+
+/// Please maintain the fields in exact sync with the private definition in o1heap.c!
+struct Checkpoint final
+{
+    Fragment*   fragment  = nullptr;
+    Fragment*   next      = nullptr;
+    std::size_t size      = 0U;
+    std::size_t allocated = 0U;
+
+    std::array<std::size_t, O1HEAP_TAG_COUNT> tag_allocated{};
+
+    bool intact = false;
+};
+
+/// Please maintain the fields in exact sync with the private definition in o1heap.c!
+struct PressureMonitor final
+{
+    O1HeapPressureCallback callback       = nullptr;
+    void*                  context        = nullptr;
+    std::size_t            high_watermark = 0U;
+    std::size_t            low_watermark  = 0U;
+    bool                   high           = false;
+    bool                   busy           = false;
+};
+
+/// Please maintain the fields in exact sync with the private definition in o1heap.c!
+struct MovableTable final
+{
+    O1HeapMovableEntry* entries  = nullptr;
+    std::size_t         count    = 0U;
+    O1HeapMovable       vacant   = 0U;
+    std::size_t         live     = 0U;
+    Fragment*           fragment = nullptr;
+    std::size_t         region   = 0U;
 };
 
 /// Please maintain the fields in exact sync with the private definition in o1heap.c!
 struct O1HeapInstance final
 {
-    std::array<Fragment*, sizeof(std::size_t) * 8U> bins{};
+    std::array<Fragment*, NumBinsMax * NumSubbins> bins{};
 
     std::size_t nonempty_bin_mask = 0;
+#if O1HEAP_SUBBIN_BITS > 0
+    std::array<std::uint32_t, NumBinsMax> nonempty_subbin_mask{};
+#endif
+
+    Fragment* deferred       = nullptr;
+    Fragment* deferred_local = nullptr;
+    Fragment* pending        = nullptr;
+
+    Region*         regions = nullptr;
+    O1HeapInstance* parent  = nullptr;
+
+    O1HeapFreeListPolicy    free_list_policy = O1HEAP_FREE_LIST_MRU;
+    O1HeapRequestHistogram* histogram        = nullptr;
+
+    std::size_t  reserve              = 0U;
+    std::uint8_t reserve_min_priority = 0U;
+
+    PressureMonitor pressure{};
+    MovableTable    movable{};
+
+    ValidationCursor validation{};
+    Checkpoint       checkpoint{};
 
     /// The same data is available via getDiagnostics(). The duplication is intentional.
     O1HeapDiagnostics diagnostics{};
 
+    /// The same data is available via getFragmentation().
+    O1HeapFragmentation fragmentation{};
+
+    std::array<O1HeapTagDiagnostics, O1HEAP_TAG_COUNT> tag_diagnostics{};
+
     [[nodiscard]] auto allocate(const size_t amount)
     {
         validate();  // Can't use RAII because it may throw -- can't throw from destructor.
@@ -160,6 +355,116 @@ struct O1HeapInstance final
         return out;
     }
 
+    [[nodiscard]] auto allocateTagged(const size_t amount, const std::uint8_t tag)
+    {
+        validate();
+        const auto out = o1heapAllocateTagged(reinterpret_cast<::O1HeapInstance*>(this), amount, tag);
+        if (out != nullptr)
+        {
+            Fragment::constructFromAllocatedMemory(out).validate();
+            REQUIRE(Fragment::constructFromAllocatedMemory(out).getTag() == tag);
+        }
+        validate();
+        return out;
+    }
+
+    [[nodiscard]] auto allocatePrioritized(const size_t amount, const std::uint8_t tag, const std::uint8_t priority)
+    {
+        validate();
+        const auto before = diagnostics;
+        const auto out = o1heapAllocatePrioritized(reinterpret_cast<::O1HeapInstance*>(this), amount, tag, priority);
+        if (out != nullptr)
+        {
+            Fragment::constructFromAllocatedMemory(out).validate();
+            REQUIRE(Fragment::constructFromAllocatedMemory(out).getTag() == tag);
+            REQUIRE(diagnostics.reserve_denial_count == before.reserve_denial_count);
+            // The hit is counted if the free memory has dropped below the reserve.
+            const bool hit = (diagnostics.capacity - diagnostics.allocated) < reserve;
+            REQUIRE(diagnostics.reserve_hit_count == (before.reserve_hit_count + (hit ? 1U : 0U)));
+        }
+        validate();
+        return out;
+    }
+
+    [[nodiscard]] auto allocateHinted(const size_t amount, const O1HeapLifetime lifetime)
+    {
+        validate();
+        const auto out = o1heapAllocateHinted(reinterpret_cast<::O1HeapInstance*>(this), amount, lifetime);
+        if (out != nullptr)
+        {
+            Fragment::constructFromAllocatedMemory(out).validate();
+        }
+        validate();
+        return out;
+    }
+
+    [[nodiscard]] auto addRegion(void* const base, const size_t size)
+    {
+        validate();
+        const auto out = o1heapAddRegion(reinterpret_cast<::O1HeapInstance*>(this), base, size);
+        validate();
+        return out;
+    }
+
+    [[nodiscard]] auto allocateZeroed(const size_t amount)
+    {
+        validate();
+        const auto out = o1heapAllocateZeroed(reinterpret_cast<::O1HeapInstance*>(this), amount);
+        if (out != nullptr)
+        {
+            Fragment::constructFromAllocatedMemory(out).validate();
+        }
+        validate();
+        return out;
+    }
+
+    [[nodiscard]] auto allocateAligned(const size_t alignment, const size_t amount)
+    {
+        validate();
+        const auto out = o1heapAllocateAligned(reinterpret_cast<::O1HeapInstance*>(this), alignment, amount);
+        if (out != nullptr)
+        {
+            Fragment::constructFromAllocatedMemory(out).validate();
+        }
+        validate();
+        return out;
+    }
+
+    [[nodiscard]] auto allocateBatch(const size_t amount, const size_t count) -> std::vector<void*>
+    {
+        validate();
+        std::vector<void*> out(count, reinterpret_cast<void*>(this));  // Poison to ensure all items are written.
+        const auto num = o1heapAllocateBatch(reinterpret_cast<::O1HeapInstance*>(this), amount, count, out.data());
+        REQUIRE(num <= count);
+        for (std::size_t i = 0U; i < count; i++)
+        {
+            if (i < num)
+            {
+                REQUIRE(out.at(i) != nullptr);
+                Fragment::constructFromAllocatedMemory(out.at(i)).validate();
+            }
+            else
+            {
+                REQUIRE(out.at(i) == nullptr);
+            }
+        }
+        validate();
+        out.resize(num);
+        return out;
+    }
+
+    [[nodiscard]] auto reallocate(void* const pointer, const size_t amount)
+    {
+        validate();
+        const auto out = o1heapReallocate(reinterpret_cast<::O1HeapInstance*>(this), pointer, amount);
+        if (out != nullptr)
+        {
+            Fragment::constructFromAllocatedMemory(out).validate();
+        }
+        validate();
+        return out;
+    }
+
     auto free(void* const pointer)
     {
         validate();
@@ -167,6 +472,107 @@ struct O1HeapInstance final
         validate();
     }
 
+    auto freeBatch(const std::vector<void*>& pointers)
+    {
+        validate();
+        o1heapFreeBatch(reinterpret_cast<::O1HeapInstance*>(this), pointers.data(), pointers.size());
+        validate();
+    }
+
+    [[nodiscard]] auto maintain(const size_t max_steps)
+    {
+        validate();
+        const auto before = diagnostics.pending_depth;
+        const auto out    = o1heapMaintain(reinterpret_cast<::O1HeapInstance*>(this), max_steps);
+        REQUIRE(out == diagnostics.pending_depth);
+        REQUIRE(out == (before - std::min(before, max_steps)));
+        validate();
+        return out;
+    }
+
+    void resetPeaks()
+    {
+        validate();
+        const auto before = diagnostics;
+        o1heapResetPeaks(reinterpret_cast<::O1HeapInstance*>(this));
+        REQUIRE(diagnostics.peak_allocated == diagnostics.allocated);
+        REQUIRE(diagnostics.peak_request_size == 0U);
+        REQUIRE(diagnostics.peak_reset_count == (before.peak_reset_count + 1U));
+        REQUIRE(diagnostics.allocated == before.allocated);
+        REQUIRE(diagnostics.oom_count == before.oom_count);
+        for (const auto& tag : tag_diagnostics)
+        {
+            REQUIRE(tag.peak_allocated == tag.allocated);
+        }
+        validate();
+    }
+
+    void reset()
+    {
+        validate();
+        const auto before = diagnostics;
+        o1heapReset(reinterpret_cast<::O1HeapInstance*>(this));
+        REQUIRE(diagnostics.allocated == 0U);
+        REQUIRE(diagnostics.capacity == before.capacity);
+        REQUIRE(diagnostics.peak_allocated == before.peak_allocated);
+        REQUIRE(diagnostics.oom_count == before.oom_count);
+        REQUIRE(checkpoint.fragment == nullptr);
+        REQUIRE(pending == nullptr);
+        validate();
+    }
+
+    [[nodiscard]] auto mark()
+    {
+        validate();
+        const auto out = o1heapMark(reinterpret_cast<::O1HeapInstance*>(this));
+        REQUIRE(out == (checkpoint.fragment != nullptr));
+        REQUIRE(pending == nullptr);
+        validate();
+        return out;
+    }
+
+    [[nodiscard]] auto rollback()
+    {
+        validate();
+        const auto before = diagnostics;
+        const auto out    = o1heapRollback(reinterpret_cast<::O1HeapInstance*>(this));
+        if (out)
+        {
+            REQUIRE(diagnostics.allocated == checkpoint.allocated);
+            for (std::size_t i = 0U; i < O1HEAP_TAG_COUNT; i++)
+            {
+                REQUIRE(tag_diagnostics.at(i).allocated == checkpoint.tag_allocated.at(i));
+            }
+            REQUIRE(checkpoint.fragment->getSize() == checkpoint.size);
+            REQUIRE(!checkpoint.fragment->isUsed());
+        }
+        else
+        {
+            REQUIRE(diagnostics.allocated == before.allocated);
+        }
+        validate();
+        return out;
+    }
+
+    [[nodiscard]] auto validateStep(const size_t max_fragments)
+    {
+        validate();
+        const auto out = o1heapValidateStep(reinterpret_cast<::O1HeapInstance*>(this), max_fragments);
+        validate();
+        return out;
+    }
+
+    [[nodiscard]] auto compactStep(const size_t max_steps)
+    {
+        validate();
+        const auto before = diagnostics;
+        const auto out    = o1heapCompactStep(reinterpret_cast<::O1HeapInstance*>(this), max_steps);
+        REQUIRE(out <= max_steps);
+        REQUIRE(diagnostics.allocated == before.allocated);
+        validate();
+        return out;
+    }
+
     [[nodiscard]] auto doInvariantsHold() const
     {
         return o1heapDoInvariantsHold(reinterpret_cast<const ::O1HeapInstance*>(this));
@@ -181,22 +587,45 @@ struct O1HeapInstance final
         return out;
     }
 
+    [[nodiscard]] auto getFragmentation() const
+    {
+        validate();
+        O1HeapFragmentation out{};
+        o1heapGetFragmentation(reinterpret_cast<const ::O1HeapInstance*>(this), &out);
+        validate();
+        REQUIRE(std::memcmp(&fragmentation, &out, sizeof(fragmentation)) == 0);
+        return out;
+    }
+
     [[nodiscard]] auto getFirstFragment() const
     {
-        const std::uint8_t* ptr = reinterpret_cast<const std::uint8_t*>(this) + sizeof(*this);
-        while ((reinterpret_cast<std::size_t>(ptr) % O1HEAP_ALIGNMENT) != 0)
+        return getRootFragment(this, sizeof(*this));
+    }
+
+    /// The first fragment of each memory region: the arena of the instance first, then the additional regions
+    /// in the order of their addition.
+    [[nodiscard]] auto getRegionFirstFragments() const -> std::vector<const Fragment*>
+    {
+        std::vector<const Fragment*> out;
+        for (auto reg = regions; reg != nullptr; reg = reg->next)
         {
-            ptr++;
+            const auto frag = getRootFragment(reg, RegionSizePadded);
+            REQUIRE(frag->getSize() <= reg->capacity);
+            out.insert(std::begin(out), frag);
         }
-        const auto frag = reinterpret_cast<const Fragment*>(reinterpret_cast<const void*>(ptr));
-        // Apply heuristics to make sure the fragment is found correctly.
-        REQUIRE(frag->header.size >= Fragment::SizeMin);
-        REQUIRE(frag->header.size <= Fragment::SizeMax);
-        REQUIRE(frag->header.size <= diagnostics.capacity);
-        REQUIRE((frag->header.size % Fragment::SizeMin) == 0U);
-        REQUIRE(((frag->header.next == nullptr) || (frag->header.next->header.prev == frag)));
-        REQUIRE(frag->header.prev == nullptr);  // The first fragment has no prev!
-        return frag;
+        out.insert(std::begin(out), getFirstFragment());
+        return out;
+    }
+
+    /// True if the lookup masks mark the bin at the specified index as non-empty.
+    [[nodiscard]] auto isBinMarkedNonEmpty(const std::size_t index) const -> bool
+    {
+        const bool first_level = (nonempty_bin_mask & (static_cast<std::size_t>(1) << (index / NumSubbins))) != 0U;
+#if O1HEAP_SUBBIN_BITS > 0
+        return first_level && ((nonempty_subbin_mask.at(index / NumSubbins) & (1UL << (index % NumSubbins))) != 0U);
+#else
+        return first_level;
+#endif
     }
 
     void validate() const
@@ -209,21 +638,22 @@ struct O1HeapInstance final
     /// A list of fragment descriptors to match the heap state against.
     /// The boolean is true if the fragment shall be used (allocated); the size is its size in bytes, overhead included.
     /// If the size is zero, it will be ignored (i.e., any value will match).
-    void matchFragments(const std::vector<std::pair<bool, std::size_t>>& reference) const
+    /// The region index selects the memory region whose fragments are matched, see getRegionFirstFragments().
+    void matchFragments(const std::vector<std::pair<bool, std::size_t>>& reference, const std::size_t region = 0U) const
     {
         validate();
         INFO(visualize());
-        auto frag = getFirstFragment();
+        auto frag = getRegionFirstFragments().at(region);
         for (auto item : reference)
         {
             const auto [used, size] = item;
             CAPTURE(used, size, frag);
             REQUIRE(frag != nullptr);
-            REQUIRE(frag->header.used == used);
-            CAPTURE(frag->header.size);
-            REQUIRE((((size == 0U) || (frag->header.size == size))));
-            REQUIRE(((frag->header.next == nullptr) || (frag->header.next->header.prev == frag)));
-            frag = frag->header.next;
+            REQUIRE(frag->isUsed() == used);
+            CAPTURE(frag->getSize());
+            REQUIRE((((size == 0U) || (frag->getSize() == size))));
+            REQUIRE(((frag->getNext() == nullptr) || (frag->getNext()->getPrev() == frag)));
+            frag = frag->getNext();
         }
         REQUIRE(frag == nullptr);
     }
@@ -239,21 +669,23 @@ struct O1HeapInstance final
                << "oom_count=" << diagnostics.oom_count << ".\n"
                << "Size of used blocks is printed as-is, size of free blocks is printed in [brackets]. "
                << "All sizes are divided by the min fragment size (" << Fragment::SizeMin << " bytes).\n";
-        auto frag = getFirstFragment();
-        do
+        for (auto frag : getRegionFirstFragments())  // Each region is printed on a separate line.
         {
-            const auto size_blocks = frag->header.size / Fragment::SizeMin;
-            if (frag->header.used)
+            do
             {
-                buffer << size_blocks << " ";
-            }
-            else
-            {
-                buffer << "[" << size_blocks << "] ";
-            }
-            frag = frag->header.next;
-        } while (frag != nullptr);
-        buffer << "\n";
+                const auto size_blocks = frag->getSize() / Fragment::SizeMin;
+                if (frag->isUsed())
+                {
+                    buffer << size_blocks << " ";
+                }
+                else
+                {
+                    buffer << "[" << size_blocks << "] ";
+                }
+                frag = frag->getNext();
+            } while (frag != nullptr);
+            buffer << "\n";
+        }
         return buffer.str();
     }
 
@@ -265,6 +697,29 @@ struct O1HeapInstance final
     auto operator=(const O1HeapInstance&&) -> O1HeapInstance& = delete;
 
 private:
+    [[nodiscard]] auto getRootFragment(const void* const base, const std::size_t header_size) const -> const Fragment*
+    {
+        const std::uint8_t* ptr = reinterpret_cast<const std::uint8_t*>(base) + header_size;
+        while ((reinterpret_cast<std::size_t>(ptr) % O1HEAP_ALIGNMENT) != 0)
+        {
+            ptr++;
+        }
+        // The root fragment is offset such that the allocated memory is aligned at the min fragment size.
+        if (((reinterpret_cast<std::size_t>(ptr) + O1HEAP_ALIGNMENT) % Fragment::SizeMin) != 0)
+        {
+            ptr += O1HEAP_ALIGNMENT;
+        }
+        const auto frag = reinterpret_cast<const Fragment*>(reinterpret_cast<const void*>(ptr));
+        // Apply heuristics to make sure the fragment is found correctly.
+        REQUIRE(frag->getSize() >= Fragment::SizeMin);
+        REQUIRE(frag->getSize() <= Fragment::SizeMax);
+        REQUIRE(frag->getSize() <= diagnostics.capacity);
+        REQUIRE((frag->getSize() % Fragment::SizeMin) == 0U);
+        REQUIRE(((frag->getNext() == nullptr) || (frag->getNext()->getPrev() == frag)));
+        REQUIRE(frag->getPrev() == nullptr);  // The first fragment has no prev!
+        return frag;
+    }
+
     void validateCore() const
     {
         REQUIRE(diagnostics.capacity >= Fragment::SizeMin);
@@ -281,38 +736,94 @@ private:
         REQUIRE(((diagnostics.peak_request_size <= diagnostics.capacity) || (diagnostics.oom_count > 0U)));
         REQUIRE((((diagnostics.peak_request_size + O1HEAP_ALIGNMENT) <= diagnostics.peak_allocated) ||
                  (diagnostics.peak_request_size == 0U) || (diagnostics.oom_count > 0U)));
+
+        REQUIRE(diagnostics.floor_probe_hit_count <= diagnostics.floor_probe_count);
+        REQUIRE(diagnostics.reserve_denial_count <= diagnostics.oom_count);
+
+        // The fragments awaiting coalescing remain marked used and are accounted for in the allocated memory.
+        std::size_t pending_count = 0U;
+        std::size_t pending_size  = 0U;
+        for (const Fragment* frag = pending; frag != nullptr; frag = frag->getNextFree())
+        {
+            REQUIRE(frag->isUsed());
+            pending_count++;
+            pending_size += frag->getSize();
+            REQUIRE(pending_count <= diagnostics.pending_depth);
+        }
+        REQUIRE(pending_count == diagnostics.pending_depth);
+        REQUIRE(pending_size <= diagnostics.allocated);
     }
 
     void validateFragmentChain() const
     {
-        std::size_t pending_bins = 0U;
+        std::vector<bool> pending_bins(std::size(bins));
         for (std::size_t i = 0U; i < std::size(bins); i++)
         {
-            if (bins.at(i) != nullptr)
+            pending_bins.at(i) = bins.at(i) != nullptr;
+            // Ensure the bin lookup masks are in sync with the bins.
+            REQUIRE(pending_bins.at(i) == isBinMarkedNonEmpty(i));
+        }
+#if O1HEAP_SUBBIN_BITS > 0
+        for (std::size_t i = 0U; i < NumBinsMax; i++)
+        {
+            const bool first_level = (nonempty_bin_mask & (static_cast<std::size_t>(1) << i)) != 0U;
+            REQUIRE(first_level == (nonempty_subbin_mask.at(i) != 0U));
+        }
+#endif
+
+        std::size_t                                   total_size      = 0U;
+        std::size_t                                   total_allocated = 0U;
+        std::array<std::size_t, O1HEAP_TAG_COUNT> tag_allocated{};
+
+        for (const auto* const frag : getRegionFirstFragments())
+        {
+            validateRegionFragmentChain(frag, pending_bins, total_size, total_allocated, tag_allocated);
+        }
+
+        // Ensure there were no hanging bin pointers.
+        REQUIRE(std::none_of(std::begin(pending_bins), std::end(pending_bins), [](const bool x) { return x; }));
+
+        // Validate the totals.
+        REQUIRE(total_size == diagnostics.capacity);
+        REQUIRE(total_allocated == diagnostics.allocated);
+        for (std::size_t i = 0U; i < O1HEAP_TAG_COUNT; i++)
+        {
+            REQUIRE(tag_allocated.at(i) == tag_diagnostics.at(i).allocated);
+            REQUIRE(tag_allocated.at(i) <= tag_diagnostics.at(i).peak_allocated);
+        }
+
+        // The incremental validation shall resume from a valid fragment of the region it is in.
+        if (validation.fragment != nullptr)
+        {
+            const auto* frag = getRegionFirstFragments().at(validation.region);
+            while ((frag != nullptr) && (frag != validation.fragment))
             {
-                pending_bins |= static_cast<std::size_t>(1) << i;
+                frag = frag->getNext();
             }
+            REQUIRE(frag == validation.fragment);
         }
-        // Ensure the bin lookup mask is in sync with the bins.
-        REQUIRE(pending_bins == nonempty_bin_mask);
-
-        std::size_t total_size      = 0U;
-        std::size_t total_allocated = 0U;
+    }
 
-        auto frag = getFirstFragment();
+    void validateRegionFragmentChain(const Fragment*    frag,
+                                     std::vector<bool>& pending_bins,
+                                     std::size_t&       total_size,
+                                     std::size_t&       total_allocated,
+                                     std::array<std::size_t, O1HEAP_TAG_COUNT>& tag_allocated) const
+    {
         do
         {
             frag->validate();
-            REQUIRE(frag->header.size <= diagnostics.capacity);
+            REQUIRE(frag->getSize() <= diagnostics.capacity);
 
             // Update and check the totals early.
-            total_size += frag->header.size;
+            total_size += frag->getSize();
             REQUIRE(total_size <= Fragment::SizeMax);
             REQUIRE(total_size <= diagnostics.capacity);
             REQUIRE((total_size % Fragment::SizeMin) == 0U);
-            if (frag->header.used)
+            if (frag->isUsed())
             {
-                total_allocated += frag->header.size;
+                total_allocated += frag->getSize();
+                tag_allocated.at(frag->getTag()) += frag->getSize();
                 REQUIRE(total_allocated <= total_size);
                 REQUIRE((total_allocated % Fragment::SizeMin) == 0U);
                 // Ensure no bin links to a used fragment.
@@ -320,68 +831,82 @@ private:
             }
             else
             {
-                const std::size_t mask = static_cast<std::size_t>(1) << frag->getBinIndex();
-                REQUIRE((nonempty_bin_mask & mask) != 0U);
+                REQUIRE(isBinMarkedNonEmpty(frag->getBinIndex()));
                 if (bins.at(frag->getBinIndex()) == frag)
                 {
-                    REQUIRE((pending_bins & mask) != 0U);
-                    pending_bins &= ~mask;
+                    REQUIRE(pending_bins.at(frag->getBinIndex()));
+                    pending_bins.at(frag->getBinIndex()) = false;
                 }
             }
 
-            frag = frag->header.next;
+            frag = frag->getNext();
         } while (frag != nullptr);
-
-        // Ensure there were no hanging bin pointers.
-        REQUIRE(pending_bins == 0);
-
-        // Validate the totals.
-        REQUIRE(total_size == diagnostics.capacity);
-        REQUIRE(total_allocated == diagnostics.allocated);
     }
 
     void validateSegregatedFreeLists() const
     {
-        std::size_t total_free = 0U;
+        std::size_t                         total_free = 0U;
+        std::array<std::size_t, NumBinsMax> free_count{};
+        std::array<std::size_t, NumBinsMax> free_size{};
+        static_assert(NumBinsMax == O1HEAP_DIAGNOSTICS_BIN_COUNT);
         for (std::size_t i = 0U; i < std::size(bins); i++)
         {
-            const std::size_t mask = static_cast<std::size_t>(1) << i;
-            const std::size_t min  = Fragment::SizeMin << i;
-            const std::size_t max  = (Fragment::SizeMin << i) * 2U - 1U;
-
-            auto frag = bins.at(i);
+            const Fragment* frag = bins.at(i);
             if (frag != nullptr)
             {
-                REQUIRE((nonempty_bin_mask & mask) != 0U);
-                REQUIRE(!frag->header.used);
-                REQUIRE(frag->prev_free == nullptr);  // The first fragment in the segregated list has no prev.
+                REQUIRE(isBinMarkedNonEmpty(i));
+                REQUIRE(!frag->isUsed());
+                const Fragment* const head = frag;
+                const Fragment*       tail = nullptr;
                 do
                 {
-                    REQUIRE(frag->header.size >= min);
-                    REQUIRE(frag->header.size <= max);
-
-                    total_free += frag->header.size;
-
-                    if (frag->next_free != nullptr)
+#if O1HEAP_SUBBIN_BITS == 0
+                    REQUIRE(frag->getSize() >= (Fragment::SizeMin << i));
+                    REQUIRE(frag->getSize() <= ((Fragment::SizeMin << i) * 2U - 1U));
+#else
+                    REQUIRE(frag->getBinIndex() == i);
+#endif
+
+                    total_free += frag->getSize();
+                    free_count.at(i / NumSubbins)++;
+                    free_size.at(i / NumSubbins) += frag->getSize();
+
+                    if (frag->getNextFree() != nullptr)
                     {
-                        REQUIRE(frag->next_free->prev_free == frag);
-                        REQUIRE(!frag->next_free->header.used);
+                        REQUIRE(frag->getNextFree()->getPrevFree() == frag);
+                        REQUIRE(!frag->getNextFree()->isUsed());
                     }
-                    if (frag->prev_free != nullptr)
+                    if (frag != head)
                     {
-                        REQUIRE(frag->prev_free->next_free == frag);
-                        REQUIRE(!frag->prev_free->header.used);
+                        REQUIRE(frag->getPrevFree()->getNextFree() == frag);
+                        REQUIRE(!frag->getPrevFree()->isUsed());
                     }
 
-                    frag = frag->next_free;
+                    tail = frag;
+                    frag = frag->getNextFree();
                 } while (frag != nullptr);
+                REQUIRE(head->getPrevFree() == tail);  // The first fragment in the segregated list points to the last.
             }
             else
             {
-                REQUIRE((nonempty_bin_mask & mask) == 0U);
+                REQUIRE(!isBinMarkedNonEmpty(i));
             }
         }
         REQUIRE((diagnostics.capacity - diagnostics.allocated) == total_free);
+
+        // The free memory statistics are in sync with the bins; the largest allocatable size is given by the largest
+        // non-empty first-level bin.
+        REQUIRE(std::equal(std::begin(free_count), std::end(free_count), std::begin(fragmentation.free_fragment_count)));
+        REQUIRE(std::equal(std::begin(free_size), std::end(free_size), std::begin(fragmentation.free_fragment_size)));
+        std::size_t largest_allocatable = 0U;
+        for (std::size_t i = 0U; i < NumBinsMax; i++)
+        {
+            if (free_count.at(i) > 0U)
+            {
+                largest_allocatable = (Fragment::SizeMin << i) - O1HEAP_ALIGNMENT;
+            }
+        }
+        REQUIRE(diagnostics.largest_allocatable == largest_allocatable);
     }
 };
 
@@ -0,0 +1,333 @@
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+// documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions
+// of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+// WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+// OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+// Copyright (c) 2020 Pavel Kirienko
+// Authors: Pavel Kirienko <pavel.kirienko@zubax.com>
+
+// Inspects the heap snapshots produced by o1heapSnapshot() offline; the snapshots are portable across platforms.
+//
+// Usage: o1heap_snapshot show <snapshot> [columns]
+//        o1heap_snapshot diff <old-snapshot> <new-snapshot> [columns]
+//
+// The "show" command prints the summary of each memory region followed by its heat map, where every character
+// represents an equal share of the region and shows the fraction of the share that is allocated: ' ' is free,
+// '@' is fully allocated, and the characters in between denote the intermediate levels (see Shades below).
+// The memory use per allocation tag (see o1heapAllocateTagged()) is printed last.
+// The "diff" command prints the fragments that differ between the snapshots and the heat map of the change:
+// '+' is more allocated memory in the new snapshot, '-' is less, '~' is the same amount but a different layout,
+// and '.' is unchanged. The default number of columns is 64; each heat map has 16 rows.
+
+#include "o1heap.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace
+{
+constexpr std::size_t HeatMapRows = 16U;
+constexpr char        Shades[]    = " .:-=+*#%@";
+constexpr std::size_t ShadeCount  = sizeof(Shades) - 1U;
+
+struct Record final
+{
+    std::uint64_t offset = 0;
+    std::uint64_t size   = 0;
+    std::uint32_t region = 0;
+    std::uint32_t tag    = 0;
+    bool          used   = false;
+
+    [[nodiscard]] auto key() const { return std::make_tuple(region, offset, size, used, tag); }
+    [[nodiscard]] auto operator<(const Record& other) const { return key() < other.key(); }
+};
+
+struct Snapshot final
+{
+    std::uint64_t       capacity  = 0;
+    std::uint64_t       allocated = 0;
+    std::uint32_t       alignment = 0;
+    std::vector<Record> records;  ///< Ordered by region, then by offset.
+};
+
+[[nodiscard]] auto readLE(const std::vector<std::uint8_t>& data, const std::size_t offset, const std::size_t width)
+{
+    std::uint64_t out = 0;
+    for (std::size_t i = 0; i < width; i++)
+    {
+        out |= static_cast<std::uint64_t>(data.at(offset + i)) << (i * 8U);
+    }
+    return out;
+}
+
+[[nodiscard]] auto load(const std::string& path) -> Snapshot
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+    {
+        throw std::runtime_error("Cannot open " + path);
+    }
+    const std::vector<std::uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if ((data.size() < O1HEAP_SNAPSHOT_HEADER_SIZE) || (readLE(data, 0U, 4U) != O1HEAP_SNAPSHOT_MAGIC) ||
+        (readLE(data, 4U, 4U) != O1HEAP_SNAPSHOT_VERSION))
+    {
+        throw std::runtime_error(path + " is not a heap snapshot of a supported version");
+    }
+    Snapshot   out;
+    const auto count = readLE(data, 24U, 8U);
+    out.capacity     = readLE(data, 8U, 8U);
+    out.allocated    = readLE(data, 16U, 8U);
+    out.alignment    = static_cast<std::uint32_t>(readLE(data, 32U, 4U));
+    if (data.size() != (O1HEAP_SNAPSHOT_HEADER_SIZE + (count * O1HEAP_SNAPSHOT_RECORD_SIZE)))
+    {
+        throw std::runtime_error(path + " is truncated or corrupted");
+    }
+    for (std::size_t i = 0; i < count; i++)
+    {
+        const std::size_t base = O1HEAP_SNAPSHOT_HEADER_SIZE + (i * O1HEAP_SNAPSHOT_RECORD_SIZE);
+        Record            rec;
+        rec.offset = readLE(data, base, 8U);
+        rec.size   = readLE(data, base + 8U, 8U) & ~static_cast<std::uint64_t>(1U);
+        rec.used   = (readLE(data, base + 8U, 8U) & 1U) != 0U;
+        rec.region = static_cast<std::uint32_t>(readLE(data, base + 16U, 4U));
+        rec.tag    = static_cast<std::uint32_t>(readLE(data, base + 20U, 4U));
+        out.records.push_back(rec);
+    }
+    return out;
+}
+
+/// The records of the specified region; the fragments of a region are adjacent, so the region size is their total.
+[[nodiscard]] auto getRegion(const Snapshot& snap, const std::uint32_t region) -> std::vector<Record>
+{
+    std::vector<Record> out;
+    std::copy_if(snap.records.begin(), snap.records.end(), std::back_inserter(out), [region](const Record& r) {
+        return r.region == region;
+    });
+    return out;
+}
+
+[[nodiscard]] auto getRegionCount(const Snapshot& snap) -> std::uint32_t
+{
+    std::uint32_t out = 0;
+    for (const auto& r : snap.records)
+    {
+        out = std::max(out, r.region + 1U);
+    }
+    return out;
+}
+
+/// The number of allocated bytes in each cell of the heat map of the region.
+[[nodiscard]] auto computeOccupancy(const std::vector<Record>& region, const std::size_t cell_count)
+    -> std::pair<std::vector<std::uint64_t>, std::uint64_t>
+{
+    std::uint64_t total = 0;
+    for (const auto& r : region)
+    {
+        total = std::max(total, r.offset + r.size);
+    }
+    const std::uint64_t        cell_size = std::max<std::uint64_t>(1U, (total + cell_count - 1U) / cell_count);
+    std::vector<std::uint64_t> out(cell_count, 0U);
+    for (const auto& r : region)
+    {
+        for (std::uint64_t pos = r.offset; r.used && (pos < (r.offset + r.size));)
+        {
+            const auto cell = pos / cell_size;
+            const auto end  = std::min((cell + 1U) * cell_size, r.offset + r.size);
+            out.at(cell) += end - pos;
+            pos = end;
+        }
+    }
+    return {out, cell_size};
+}
+
+void printHeatMap(const std::vector<char>& cells, const std::size_t columns, const std::uint64_t cell_size)
+{
+    std::cout << "Each character represents " << cell_size << " bytes.\n";
+    for (std::size_t row = 0; (row * columns) < cells.size(); row++)
+    {
+        std::cout << '|';
+        for (std::size_t col = 0; col < columns; col++)
+        {
+            std::cout << cells.at((row * columns) + col);
+        }
+        std::cout << "|\n";
+    }
+}
+
+void printSummary(const std::vector<Record>& region)
+{
+    std::uint64_t used         = 0;
+    std::uint64_t unused       = 0;
+    std::uint64_t largest_free = 0;
+    std::size_t   used_count   = 0;
+    for (const auto& r : region)
+    {
+        (r.used ? used : unused) += r.size;
+        used_count += r.used ? 1U : 0U;
+        largest_free = r.used ? largest_free : std::max(largest_free, r.size);
+    }
+    // The fragmentation is the share of the free memory that is not in the largest free fragment.
+    const double fragmentation =
+        (unused > 0U) ? (1.0 - (static_cast<double>(largest_free) / static_cast<double>(unused))) : 0.0;
+    std::cout << "used " << used << " B in " << used_count << " fragments, free " << unused << " B in "
+              << (region.size() - used_count) << " fragments, largest free " << largest_free
+              << " B, fragmentation " << std::fixed << std::setprecision(3) << fragmentation << "\n";
+}
+
+void show(const Snapshot& snap, const std::size_t columns)
+{
+    std::cout << "capacity " << snap.capacity << " B, allocated " << snap.allocated << " B, alignment "
+              << snap.alignment << " B, " << snap.records.size() << " fragments\n";
+    for (std::uint32_t i = 0; i < getRegionCount(snap); i++)
+    {
+        const auto region = getRegion(snap, i);
+        std::cout << "\nRegion " << i << ": ";
+        printSummary(region);
+        const auto [occupancy, cell_size] = computeOccupancy(region, columns * HeatMapRows);
+        std::vector<char> cells;
+        for (const auto x : occupancy)
+        {
+            // A cell is blank only if it is entirely free and '@' only if it is entirely allocated.
+            const auto level = (x == 0U) ? 0U : (1U + (((ShadeCount - 2U) * x) / cell_size));
+            cells.push_back(Shades[std::min<std::size_t>(level, ShadeCount - 1U)]);
+        }
+        printHeatMap(cells, columns, cell_size);
+    }
+    std::map<std::uint32_t, std::pair<std::uint64_t, std::size_t>> tags;
+    for (const auto& r : snap.records)
+    {
+        if (r.used)
+        {
+            tags[r.tag].first += r.size;
+            tags[r.tag].second++;
+        }
+    }
+    std::cout << "\n";
+    for (const auto& [tag, use] : tags)
+    {
+        std::cout << "Tag " << tag << ": used " << use.first << " B in " << use.second << " fragments\n";
+    }
+}
+
+void diff(const Snapshot& before, const Snapshot& after, const std::size_t columns)
+{
+    std::cout << "allocated " << before.allocated << " -> " << after.allocated << " B, fragments "
+              << before.records.size() << " -> " << after.records.size() << "\n";
+    const std::set<Record> old_set(before.records.begin(), before.records.end());
+    const std::set<Record> new_set(after.records.begin(), after.records.end());
+    std::vector<std::pair<char, Record>> changes;
+    for (const auto& r : before.records)
+    {
+        if (new_set.count(r) == 0U)
+        {
+            changes.emplace_back('-', r);
+        }
+    }
+    for (const auto& r : after.records)
+    {
+        if (old_set.count(r) == 0U)
+        {
+            changes.emplace_back('+', r);
+        }
+    }
+    std::stable_sort(changes.begin(), changes.end(), [](const auto& a, const auto& b) {
+        return std::make_tuple(a.second.region, a.second.offset) < std::make_tuple(b.second.region, b.second.offset);
+    });
+    for (const auto& [sign, r] : changes)
+    {
+        std::cout << sign << " region " << r.region << " offset " << r.offset << " size " << r.size
+                  << (r.used ? " used" : " free") << " tag " << r.tag << "\n";
+    }
+    const auto region_count = std::max(getRegionCount(before), getRegionCount(after));
+    for (std::uint32_t i = 0; i < region_count; i++)
+    {
+        const auto old_region = getRegion(before, i);
+        const auto new_region = getRegion(after, i);
+        std::cout << "\nRegion " << i << " before: ";
+        printSummary(old_region);
+        std::cout << "Region " << i << " after:  ";
+        printSummary(new_region);
+        const auto [old_occupancy, old_cell_size] = computeOccupancy(old_region, columns * HeatMapRows);
+        const auto [new_occupancy, new_cell_size] = computeOccupancy(new_region, columns * HeatMapRows);
+        if (old_cell_size != new_cell_size)
+        {
+            std::cout << "The region has different sizes in the snapshots; the heat map is not available.\n";
+            continue;
+        }
+        // A cell that contains a changed fragment boundary has a different layout even if its occupancy is the same.
+        std::set<std::uint64_t> changed;
+        for (const auto& change : changes)
+        {
+            if (change.second.region == i)
+            {
+                changed.insert(change.second.offset / new_cell_size);
+            }
+        }
+        std::vector<char> cells;
+        for (std::size_t k = 0; k < new_occupancy.size(); k++)
+        {
+            const auto x = new_occupancy.at(k);
+            const auto y = old_occupancy.at(k);
+            cells.push_back((x > y) ? '+' : ((x < y) ? '-' : ((changed.count(k) > 0U) ? '~' : '.')));
+        }
+        printHeatMap(cells, columns, new_cell_size);
+    }
+}
+
+[[nodiscard]] auto parseColumns(const int argc, const char* const argv[], const int index) -> std::size_t
+{
+    const long out = (argc > index) ? std::strtol(argv[index], nullptr, 10) : 64L;
+    if ((out <= 0L) || (out > 1024L))
+    {
+        throw std::runtime_error("The number of columns shall be in [1, 1024]");
+    }
+    return static_cast<std::size_t>(out);
+}
+
+}  // namespace
+
+int main(const int argc, const char* const argv[])
+{
+    try
+    {
+        const std::string command = (argc > 1) ? argv[1] : "";
+        if ((command == "show") && (argc >= 3) && (argc <= 4))
+        {
+            show(load(argv[2]), parseColumns(argc, argv, 3));
+        }
+        else if ((command == "diff") && (argc >= 4) && (argc <= 5))
+        {
+            diff(load(argv[2]), load(argv[3]), parseColumns(argc, argv, 4));
+        }
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " show <snapshot> [columns]\n"
+                      << "       " << argv[0] << " diff <old-snapshot> <new-snapshot> [columns]\n";
+            return EXIT_FAILURE;
+        }
+    }
+    catch (const std::exception& ex)
+    {
+        std::cerr << ex.what() << "\n";
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -17,14 +17,40 @@
 #include "internal.hpp"
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <numeric>
 #include <random>
+#include <thread>
 
 namespace
 {
 constexpr std::size_t KiB = 1024U;
 constexpr std::size_t MiB = KiB * KiB;
 
+// The concurrent heap relies on the atomic intrinsics, which are not used if the intrinsics are disabled.
+#if defined(O1HEAP_USE_INTRINSICS) && (O1HEAP_USE_INTRINSICS == 0)
+constexpr bool AtomicsAvailable = false;
+#else
+constexpr bool AtomicsAvailable = true;
+#endif
+
+/// The tests that expect a specific heap layout request amounts that do not depend on the bin engine.
+/// The power-of-two bins round an arbitrary amount up to the next power of two, so the arbitrary amount is used as-is;
+/// the sub-bins would round it up to a smaller fragment, so the largest amount that fits the same fragment is used.
+constexpr auto fitAmount(const std::size_t arbitrary, const std::size_t fragment_size) -> std::size_t
+{
+#if O1HEAP_SUBBIN_BITS == 0
+    (void) fragment_size;
+    return arbitrary;
+#else
+    (void) arbitrary;
+    return fragment_size - O1HEAP_ALIGNMENT;
+#endif
+}
+
 template <typename T>
 auto log2Floor(const T& x) -> std::enable_if_t<std::is_integral_v<T>, std::uint8_t>
 {
@@ -65,17 +91,21 @@ auto init(void* const base, const std::size_t size)
         REQUIRE((heap->nonempty_bin_mask & (heap->nonempty_bin_mask - 1U)) == 0);
         for (auto i = 0U; i < std::size(heap->bins); i++)
         {
-            const std::size_t min = Fragment::SizeMin << i;
-            const std::size_t max = (Fragment::SizeMin << i) * 2U - 1U;
-            if ((heap->nonempty_bin_mask & (1ULL << i)) == 0U)
+            if (!heap->isBinMarkedNonEmpty(i))
             {
                 REQUIRE(heap->bins.at(i) == nullptr);
             }
             else
             {
                 REQUIRE(heap->bins.at(i) != nullptr);
-                REQUIRE(heap->bins.at(i)->header.size >= min);
-                REQUIRE(heap->bins.at(i)->header.size <= max);
+#if O1HEAP_SUBBIN_BITS == 0
+                const std::size_t min = Fragment::SizeMin << i;
+                const std::size_t max = (Fragment::SizeMin << i) * 2U - 1U;
+                REQUIRE(heap->bins.at(i)->getSize() >= min);
+                REQUIRE(heap->bins.at(i)->getSize() <= max);
+#else
+                REQUIRE(heap->bins.at(i)->getBinIndex() == i);
+#endif
             }
         }
 
@@ -87,14 +117,16 @@ auto init(void* const base, const std::size_t size)
         REQUIRE(heap->diagnostics.peak_allocated == 0);
         REQUIRE(heap->diagnostics.peak_request_size == 0);
 
-        const auto root_fragment = heap->bins.at(log2Floor(heap->nonempty_bin_mask));
+        const auto root_fragment = *std::find_if(std::begin(heap->bins), std::end(heap->bins), [](auto* p) {
+            return p != nullptr;
+        });
         REQUIRE(root_fragment != nullptr);
-        REQUIRE(root_fragment->next_free == nullptr);
-        REQUIRE(root_fragment->prev_free == nullptr);
-        REQUIRE(!root_fragment->header.used);
-        REQUIRE(root_fragment->header.size == heap->diagnostics.capacity);
-        REQUIRE(root_fragment->header.next == nullptr);
-        REQUIRE(root_fragment->header.prev == nullptr);
+        REQUIRE(root_fragment->getNextFree() == nullptr);
+        REQUIRE(root_fragment->getPrevFree() == root_fragment);  // The only fragment in the bin is also the last.
+        REQUIRE(!root_fragment->isUsed());
+        REQUIRE(root_fragment->getSize() == heap->diagnostics.capacity);
+        REQUIRE(root_fragment->getNext() == nullptr);
+        REQUIRE(root_fragment->getPrev() == nullptr);
     }
     return heap;
 }
@@ -140,7 +172,7 @@ TEST_CASE("General: allocate: OOM")
 
     auto heap = init(arena.get(), ArenaSize);
     REQUIRE(heap != nullptr);
-    REQUIRE(heap->getDiagnostics().capacity > ArenaSize - 1024U);
+    REQUIRE(heap->getDiagnostics().capacity > ArenaSize - 1024U - sizeof(internal::O1HeapInstance));
     REQUIRE(heap->getDiagnostics().capacity < ArenaSize);
     REQUIRE(heap->getDiagnostics().oom_count == 0);
 
@@ -190,12 +222,12 @@ TEST_CASE("General: allocate: smallest")
     REQUIRE(heap->getDiagnostics().peak_request_size == 1);
 
     auto& frag = Fragment::constructFromAllocatedMemory(mem);
-    REQUIRE(frag.header.size == (O1HEAP_ALIGNMENT * 2U));
-    REQUIRE(frag.header.next != nullptr);
-    REQUIRE(frag.header.prev == nullptr);
-    REQUIRE(frag.header.used);
-    REQUIRE(frag.header.next->header.size == (heap->diagnostics.capacity - frag.header.size));
-    REQUIRE(!frag.header.next->header.used);
+    REQUIRE(frag.getSize() == (O1HEAP_ALIGNMENT * 2U));
+    REQUIRE(frag.getNext() != nullptr);
+    REQUIRE(frag.getPrev() == nullptr);
+    REQUIRE(frag.isUsed());
+    REQUIRE(frag.getNext()->getSize() == (heap->diagnostics.capacity - frag.getSize()));
+    REQUIRE(!frag.getNext()->isUsed());
 
     heap->free(mem);
     REQUIRE(heap->doInvariantsHold());
@@ -212,7 +244,7 @@ TEST_CASE("General: allocate: size_t overflow")
 
     auto heap = init(arena.get(), ArenaSize);
     REQUIRE(heap != nullptr);
-    REQUIRE(heap->diagnostics.capacity > (ArenaSize - 1024U));
+    REQUIRE(heap->diagnostics.capacity > (ArenaSize - 1024U - sizeof(internal::O1HeapInstance)));
     REQUIRE(heap->diagnostics.capacity < ArenaSize);
     for (auto i = 1U; i <= 2U; i++)
     {
@@ -239,10 +271,10 @@ TEST_CASE("General: allocate: size_t overflow")
     REQUIRE(mem != nullptr);
 
     auto& frag = Fragment::constructFromAllocatedMemory(mem);
-    REQUIRE(frag.header.size == Fragment::SizeMax);
-    REQUIRE(frag.header.next == nullptr);
-    REQUIRE(frag.header.prev == nullptr);
-    REQUIRE(frag.header.used);
+    REQUIRE(frag.getSize() == Fragment::SizeMax);
+    REQUIRE(frag.getNext() == nullptr);
+    REQUIRE(frag.getPrev() == nullptr);
+    REQUIRE(frag.isUsed());
 
     REQUIRE(heap->getDiagnostics().peak_allocated == Fragment::SizeMax);
     REQUIRE(heap->getDiagnostics().allocated == Fragment::SizeMax);
@@ -257,7 +289,7 @@ TEST_CASE("General: free")
 {
     using internal::Fragment;
 
-    alignas(128U) std::array<std::byte, 4096U + sizeof(internal::O1HeapInstance) + O1HEAP_ALIGNMENT - 1U> arena{};
+    alignas(128U) std::array<std::byte, 4096U + sizeof(internal::O1HeapInstance) + O1HEAP_ALIGNMENT * 2U - 1U> arena{};
     auto heap = init(arena.data(), std::size(arena));
     REQUIRE(heap != nullptr);
 
@@ -282,12 +314,14 @@ TEST_CASE("General: free")
             std::generate_n(reinterpret_cast<std::byte*>(p), amount, getRandomByte);
 
             const auto& frag = Fragment::constructFromAllocatedMemory(p);
-            REQUIRE(frag.header.used);
-            REQUIRE((frag.header.size & (frag.header.size - 1U)) == 0U);
-            REQUIRE(frag.header.size >= (amount + O1HEAP_ALIGNMENT));
-            REQUIRE(frag.header.size <= Fragment::SizeMax);
-
-            allocated += frag.header.size;
+            REQUIRE(frag.isUsed());
+#if O1HEAP_SUBBIN_BITS == 0
+            REQUIRE((frag.getSize() & (frag.getSize() - 1U)) == 0U);
+#endif
+            REQUIRE(frag.getSize() >= (amount + O1HEAP_ALIGNMENT));
+            REQUIRE(frag.getSize() <= Fragment::SizeMax);
+
+            allocated += frag.getSize();
             peak_allocated    = std::max(peak_allocated, allocated);
             peak_request_size = std::max(peak_request_size, amount);
         }
@@ -312,9 +346,9 @@ TEST_CASE("General: free")
             std::generate_n(reinterpret_cast<std::byte*>(p), O1HEAP_ALIGNMENT, getRandomByte);
 
             const auto& frag = Fragment::constructFromAllocatedMemory(p);
-            REQUIRE(frag.header.used);
-            REQUIRE(allocated >= frag.header.size);
-            allocated -= frag.header.size;
+            REQUIRE(frag.isUsed());
+            REQUIRE(allocated >= frag.getSize());
+            allocated -= frag.getSize();
             heap->free(p);
         }
         else
@@ -357,7 +391,7 @@ TEST_CASE("General: free")
                        {X, 64},
                        {O, 3840},
                    });
-    auto e = alloc(1024U,
+    auto e = alloc(fitAmount(1024U, 2048U),
                    {
                        {X, 64},
                        {X, 64},
@@ -366,7 +400,7 @@ TEST_CASE("General: free")
                        {X, 2048},
                        {O, 1792},
                    });
-    auto f = alloc(512U,
+    auto f = alloc(fitAmount(512U, 1024U),
                    {
                        {X, 64},    // a
                        {X, 64},    // b
@@ -411,7 +445,7 @@ TEST_CASE("General: free")
                 {X, 1024},  // f
                 {O, 768},
             });
-    auto g = alloc(400U,  // The last block will be taken because it is a better fit.
+    auto g = alloc(fitAmount(400U, 512U),  // The last block will be taken because it is a better fit.
                    {
                        {O, 192},
                        {X, 64},  // d
@@ -434,7 +468,7 @@ TEST_CASE("General: free")
                 {X, 512},   // g
                 {O, 256},
             });
-    auto h = alloc(200U,
+    auto h = alloc(fitAmount(200U, 256U),
                    {
                        {O, 3328},
                        {X, 512},  // g
@@ -466,140 +500,2869 @@ TEST_CASE("General: free")
     REQUIRE(heap->diagnostics.capacity == 4096U);
     REQUIRE(heap->diagnostics.allocated == 0U);
     REQUIRE(heap->diagnostics.peak_allocated == 3328U);
-    REQUIRE(heap->diagnostics.peak_request_size == 1024U);
+    REQUIRE(heap->diagnostics.peak_request_size == fitAmount(1024U, 2048U));
     REQUIRE(heap->diagnostics.oom_count == 0U);
     REQUIRE(heap->doInvariantsHold());
 }
 
-/// This test has been empirically tuned to expand its state space coverage.
-/// If any new behaviors need to be tested, please consider writing another test instead of changing this one.
-TEST_CASE("General: random A")
+TEST_CASE("General: floor probe")
 {
     using internal::Fragment;
 
-    constexpr auto                   ArenaSize = MiB * 300U;
-    const std::shared_ptr<std::byte> arena(static_cast<std::byte*>(std::aligned_alloc(64U, ArenaSize)), &std::free);
-    std::generate_n(arena.get(), ArenaSize, getRandomByte);  // Random-fill the ENTIRE arena!
-    auto heap = init(arena.get(), ArenaSize);
+    alignas(128U) std::array<std::byte, 4096U + sizeof(internal::O1HeapInstance) + O1HEAP_ALIGNMENT * 2U - 1U> arena{};
+    auto heap = init(arena.data(), std::size(arena));
     REQUIRE(heap != nullptr);
+    REQUIRE(heap->diagnostics.capacity == 4096U);
 
-    std::vector<void*> pointers;
+    constexpr auto X = true;   // used
+    constexpr auto O = false;  // free
+    constexpr auto S = Fragment::SizeMin;
+    // With the sub-bins, every multiple of S used here is the lower bound of a bin, so there is no probing.
+    constexpr auto Probing = (O1HEAP_FLOOR_PROBE_LIMIT > 0U) && (O1HEAP_SUBBIN_BITS == 0U);
+
+    // Make a free fragment of 5S in the floor bin of 5S and 6S, which is [4S, 8S).
+    auto* const a = heap->allocate((S * 4U) - O1HEAP_ALIGNMENT);
+    auto* const b = heap->allocate(S - O1HEAP_ALIGNMENT);
+    auto* const c = heap->allocate(S - O1HEAP_ALIGNMENT);
+    heap->free(a);
+    heap->free(b);
+    heap->matchFragments({{O, S * 5U}, {X, S}, {O, 4096U - (S * 6U)}});
+    REQUIRE(heap->diagnostics.floor_probe_count == 0U);
+
+    // The free fragment of the floor bin is too small, so the probe misses and the ceiling bin is used.
+    auto* const d = heap->allocate((S * 6U) - O1HEAP_ALIGNMENT);
+    REQUIRE(d != nullptr);
+    if (O1HEAP_SUBBIN_BITS == 0U)
+    {
+        heap->matchFragments({{O, S * 5U}, {X, S}, {X, S * 8U}, {O, 4096U - (S * 14U)}});
+    }
+    REQUIRE(heap->diagnostics.floor_probe_count == (Probing ? 1U : 0U));
+    REQUIRE(heap->diagnostics.floor_probe_hit_count == 0U);
 
-    std::size_t   allocated         = 0U;
-    std::size_t   peak_allocated    = 0U;
-    std::size_t   peak_request_size = 0U;
-    std::uint64_t oom_count         = 0U;
+    // The probe hits; the fragment is claimed entirely, although it is smaller than the ordinary fragment size.
+    auto* const e = heap->allocate((S * 5U) - O1HEAP_ALIGNMENT);
+    REQUIRE(e != nullptr);
+    if (Probing)
+    {
+        REQUIRE(e == a);
+        heap->matchFragments({{X, S * 5U}, {X, S}, {X, S * 8U}, {O, 4096U - (S * 14U)}});
+        REQUIRE(heap->diagnostics.allocated == (S * 14U));
+    }
+    else if (O1HEAP_SUBBIN_BITS == 0U)
+    {
+        heap->matchFragments({{O, S * 5U}, {X, S}, {X, S * 8U}, {X, S * 8U}, {O, 4096U - (S * 22U)}});
+    }
+    REQUIRE(heap->diagnostics.floor_probe_count == (Probing ? 2U : 0U));
+    REQUIRE(heap->diagnostics.floor_probe_hit_count == (Probing ? 1U : 0U));
+    REQUIRE(heap->doInvariantsHold());
 
-    std::random_device random_device;
-    std::mt19937       random_generator(random_device());
+    // The lower bound of a bin is never probed because every fragment in its bin fits.
+    auto* const f = heap->allocate((S * 4U) - O1HEAP_ALIGNMENT);
+    REQUIRE(f != nullptr);
+    REQUIRE(heap->diagnostics.floor_probe_count == (Probing ? 2U : 0U));
 
-    const auto allocate = [&]() {
-        REQUIRE(heap->doInvariantsHold());
-        std::uniform_int_distribution<std::size_t> dis(0, ArenaSize / 1000U);
+    heap->free(c);
+    heap->free(d);
+    heap->free(e);
+    heap->free(f);
+    heap->matchFragments({{O, 4096U}});
+    REQUIRE(heap->diagnostics.allocated == 0U);
+    REQUIRE(heap->doInvariantsHold());
+}
 
-        const std::size_t amount = dis(random_generator);
-        const auto        ptr    = heap->allocate(amount);
-        if (ptr != nullptr)
+TEST_CASE("General: free list policy")
+{
+    using internal::Fragment;
+
+    constexpr auto S = Fragment::SizeMin;
+    // The expected allocation order of the fragments a, b, c freed in the order b, c, a.
+    const std::vector<std::pair<O1HeapFreeListPolicy, std::array<std::size_t, 3>>> cases{
+        {O1HEAP_FREE_LIST_MRU, {0, 2, 1}},
+        {O1HEAP_FREE_LIST_FIFO, {1, 2, 0}},
+        {O1HEAP_FREE_LIST_ADDRESS_ORDERED, {0, 1, 2}},
+    };
+    for (const auto& [policy, order] : cases)
+    {
+        alignas(128U) std::array<std::byte, 4096U + sizeof(internal::O1HeapInstance) + O1HEAP_ALIGNMENT * 2U - 1U>
+             arena{};
+        auto heap = init(arena.data(), std::size(arena));
+        REQUIRE(heap != nullptr);
+        REQUIRE(heap->free_list_policy == O1HEAP_FREE_LIST_MRU);
+        o1heapSetFreeListPolicy(reinterpret_cast<::O1HeapInstance*>(heap), policy);
+        REQUIRE(heap->free_list_policy == policy);
+
+        // The fragments are separated by the used ones to prevent coalescing; all of them end up in the same bin.
+        std::array<void*, 3> v{};
+        std::array<void*, 3> separators{};
+        for (std::size_t i = 0U; i < std::size(v); i++)
         {
-            // Overwrite all to ensure that the allocator does not make implicit assumptions about the memory use.
-            std::generate_n(reinterpret_cast<std::byte*>(ptr), amount, getRandomByte);
-            pointers.push_back(ptr);
-            const auto& frag = Fragment::constructFromAllocatedMemory(ptr);
-            allocated += frag.header.size;
-            peak_allocated = std::max(peak_allocated, allocated);
+            v.at(i)          = heap->allocate((S * 4U) - O1HEAP_ALIGNMENT);
+            separators.at(i) = heap->allocate(S - O1HEAP_ALIGNMENT);
+            REQUIRE(separators.at(i) != nullptr);
         }
-        else
+        heap->free(v.at(1));
+        heap->free(v.at(2));
+        heap->free(v.at(0));
+        for (const auto idx : order)
         {
-            if (amount > 0U)
-            {
-                oom_count++;
-            }
+            CAPTURE(policy, idx);
+            REQUIRE(heap->allocate((S * 4U) - O1HEAP_ALIGNMENT) == v.at(idx));
         }
-        peak_request_size = std::max(peak_request_size, amount);
-        REQUIRE(heap->doInvariantsHold());
-    };
 
-    const auto deallocate = [&]() {
-        REQUIRE(heap->doInvariantsHold());
-        if (!pointers.empty())
+        // Exercise the removal of fragments from the middle and the end of the bin list.
+        heap->free(v.at(0));
+        heap->free(v.at(1));
+        heap->free(v.at(2));
+        for (auto* const x : separators)
         {
-            std::uniform_int_distribution<decltype(pointers)::difference_type>
-                        dis(0, static_cast<decltype(pointers)::difference_type>(std::size(pointers) - 1));
-            const auto  it  = std::begin(pointers) + dis(random_generator);
-            void* const ptr = *it;
-            (void) pointers.erase(it);
-            if (ptr != nullptr)
-            {
-                const auto& frag = Fragment::constructFromAllocatedMemory(ptr);
-                frag.validate();
-                REQUIRE(allocated >= frag.header.size);
-                allocated -= frag.header.size;
-            }
-            heap->free(ptr);
+            heap->free(x);
         }
+        heap->matchFragments({{false, 4096U}});
         REQUIRE(heap->doInvariantsHold());
-    };
+    }
+}
 
-    // The memory use is growing slowly from zero.
-    // We stop the test when it's been running near the max heap utilization for long enough.
-    while (heap->diagnostics.oom_count < 1000U)
-    {
-        for (auto i = 0U; i < 100U; i++)
+TEST_CASE("General: fragmentation diagnostics")
+{
+    using internal::Fragment;
+
+    alignas(128U) std::array<std::byte, 4096U + sizeof(internal::O1HeapInstance) + O1HEAP_ALIGNMENT * 2U - 1U> arena{};
+    auto heap = init(arena.data(), std::size(arena));
+    REQUIRE(heap != nullptr);
+    REQUIRE(heap->diagnostics.capacity == 4096U);
+
+    constexpr auto S         = Fragment::SizeMin;
+    constexpr auto RootClass = [] {  // log2(4096 / S)
+        std::size_t out = 0U;
+        for (auto x = 4096U / S; x > 1U; x >>= 1U)
         {
-            allocate();
+            out++;
         }
-        for (auto i = 0U; i < 50U; i++)
+        return out;
+    }();
+    const auto sizeOf = [](void* const p) { return Fragment::constructFromAllocatedMemory(p).getSize(); };
+
+    REQUIRE(heap->getFragmentation().free_fragment_count[RootClass] == 1U);
+    REQUIRE(heap->getFragmentation().free_fragment_size[RootClass] == 4096U);
+    REQUIRE(heap->diagnostics.largest_allocatable == (4096U - O1HEAP_ALIGNMENT));
+    REQUIRE(heap->diagnostics.rounding_waste == 0U);
+
+    // The remainder of the root fragment falls into the next smaller class.
+    auto* const a = heap->allocate(1U);
+    REQUIRE(sizeOf(a) == S);
+    REQUIRE(heap->diagnostics.rounding_waste == (S - 1U - O1HEAP_ALIGNMENT));
+    REQUIRE(heap->getFragmentation().free_fragment_count[RootClass] == 0U);
+    REQUIRE(heap->getFragmentation().free_fragment_count[RootClass - 1U] == 1U);
+    REQUIRE(heap->getFragmentation().free_fragment_size[RootClass - 1U] == (4096U - S));
+    REQUIRE(heap->diagnostics.largest_allocatable == ((4096U / 2U) - O1HEAP_ALIGNMENT));
+
+    // The waste of a batch accounts for every item.
+    const auto batch = heap->allocateBatch(100U, 3U);
+    REQUIRE(batch.size() == 3U);
+    REQUIRE(heap->diagnostics.rounding_waste ==
+            ((S - 1U - O1HEAP_ALIGNMENT) + ((sizeOf(batch.at(0)) - 100U - O1HEAP_ALIGNMENT) * 3U)));
+
+    // The largest allocatable request is guaranteed to succeed.
+    auto* const b = heap->allocate(heap->diagnostics.largest_allocatable);
+    REQUIRE(b != nullptr);
+    heap->free(b);
+    heap->freeBatch(batch);
+    heap->free(a);
+    REQUIRE(heap->getFragmentation().free_fragment_count[RootClass] == 1U);
+    REQUIRE(heap->diagnostics.largest_allocatable == (4096U - O1HEAP_ALIGNMENT));
+    REQUIRE(heap->diagnostics.oom_count == 0U);
+    REQUIRE(heap->doInvariantsHold());
+}
+
+TEST_CASE("General: request histogram and peak reset")
+{
+    using internal::Fragment;
+
+    alignas(128U) std::array<std::byte, 4096U + sizeof(internal::O1HeapInstance) + O1HEAP_ALIGNMENT * 2U - 1U> arena{};
+    auto heap = init(arena.data(), std::size(arena));
+    REQUIRE(heap != nullptr);
+    REQUIRE(heap->histogram == nullptr);
+    REQUIRE(heap->diagnostics.peak_reset_count == 0U);
+
+    constexpr auto S = Fragment::SizeMin;
+    const auto     h = std::make_unique<O1HeapRequestHistogram>();  // Value-initialized, i.e., zeroed.
+    REQUIRE(std::all_of(std::begin(h->request_count), std::end(h->request_count), [](auto x) { return x == 0U; }));
+
+    // Nothing is counted until the histogram is attached.
+    auto* const a = heap->allocate(1U);
+    REQUIRE(a != nullptr);
+    o1heapSetRequestHistogram(reinterpret_cast<::O1HeapInstance*>(heap), h.get());
+    REQUIRE(heap->histogram == h.get());
+    REQUIRE(std::all_of(std::begin(h->request_count), std::end(h->request_count), [](auto x) { return x == 0U; }));
+
+    // Requests in [2^i, 2^(i+1)) fall into the bucket i; the fragments are counted in units of the min fragment size.
+    auto* const b = heap->allocate(S - O1HEAP_ALIGNMENT);  // One min fragment.
+    auto* const c = heap->allocate(S);                     // Two min fragments.
+    REQUIRE(b != nullptr);
+    REQUIRE(c != nullptr);
+    REQUIRE(heap->allocate(0U) == nullptr);  // Not counted.
+    REQUIRE(heap->allocate(4096U) == nullptr);
+    const auto batch = heap->allocateBatch(S - O1HEAP_ALIGNMENT, 3U);
+    REQUIRE(batch.size() == 3U);
+    std::array<std::uint64_t, O1HEAP_DIAGNOSTICS_BIN_COUNT> expected_requests{};
+    std::array<std::uint64_t, O1HEAP_DIAGNOSTICS_BIN_COUNT> expected_fragments{};
+    const auto log2 = [](std::size_t x) {
+        std::size_t out = 0U;
+        for (; x > 1U; x >>= 1U)
         {
-            deallocate();
+            out++;
         }
-        REQUIRE(heap->diagnostics.allocated == allocated);
-        REQUIRE(heap->diagnostics.peak_allocated == peak_allocated);
-        REQUIRE(heap->diagnostics.peak_request_size == peak_request_size);
-        REQUIRE(heap->diagnostics.oom_count == oom_count);
-        REQUIRE(heap->doInvariantsHold());
+        return out;
+    };
+    expected_requests.at(log2(S - O1HEAP_ALIGNMENT)) += 4U;
+    expected_requests.at(log2(S))++;
+    expected_requests.at(log2(4096U))++;
+    expected_fragments.at(0U) += 4U;
+    expected_fragments.at(1U)++;
+    REQUIRE(std::equal(expected_requests.begin(), expected_requests.end(), std::begin(h->request_count)));
+    REQUIRE(std::equal(expected_fragments.begin(), expected_fragments.end(), std::begin(h->fragment_count)));
+
+    // Detaching stops the counting.
+    o1heapSetRequestHistogram(reinterpret_cast<::O1HeapInstance*>(heap), nullptr);
+    REQUIRE(heap->histogram == nullptr);
+    heap->free(heap->allocate(S));
+    REQUIRE(std::equal(expected_requests.begin(), expected_requests.end(), std::begin(h->request_count)));
+
+    // Start a new measurement window. The new peaks reflect only the activity within the window.
+    REQUIRE(heap->diagnostics.peak_request_size == 4096U);
+    const auto allocated = heap->diagnostics.allocated;
+    heap->free(c);
+    heap->resetPeaks();
+    REQUIRE(heap->diagnostics.peak_allocated == (allocated - (S * 2U)));
+    REQUIRE(heap->diagnostics.peak_request_size == 0U);
+    REQUIRE(heap->diagnostics.peak_reset_count == 1U);
+    REQUIRE(heap->doInvariantsHold());
+    auto* const d = heap->allocate(S * 3U);
+    REQUIRE(d != nullptr);
+    REQUIRE(heap->diagnostics.peak_request_size == (S * 3U));
+    REQUIRE(heap->diagnostics.peak_allocated == heap->diagnostics.allocated);
+    heap->free(d);
+    REQUIRE(heap->diagnostics.peak_allocated > heap->diagnostics.allocated);
+    REQUIRE(heap->doInvariantsHold());
 
-        std::cout << heap->visualize() << std::endl;
+    // Reset after everything is freed, which returns the heap into the initial state except for the counters.
+    heap->free(a);
+    heap->free(b);
+    heap->freeBatch(batch);
+    heap->resetPeaks();
+    REQUIRE(heap->diagnostics.peak_allocated == 0U);
+    REQUIRE(heap->diagnostics.peak_reset_count == 2U);
+    REQUIRE(heap->diagnostics.oom_count == 1U);
+    REQUIRE(heap->doInvariantsHold());
+}
+
+TEST_CASE("General: allocation tags")
+{
+    using internal::Fragment;
+
+    alignas(128U) std::array<std::byte, 4096U + sizeof(internal::O1HeapInstance) + O1HEAP_ALIGNMENT * 2U - 1U> arena{};
+    auto heap = init(arena.data(), std::size(arena));
+    REQUIRE(heap != nullptr);
+    auto* const handle = reinterpret_cast<::O1HeapInstance*>(heap);
+    static_assert(O1HEAP_TAG_COUNT >= 3U, "The test requires several tags");
+
+    // No quota by default.
+    for (std::uint8_t tag = 0U; tag < O1HEAP_TAG_COUNT; tag++)
+    {
+        const auto td = o1heapGetTagDiagnostics(handle, tag);
+        REQUIRE(td.allocated == 0U);
+        REQUIRE(td.peak_allocated == 0U);
+        REQUIRE(td.quota == SIZE_MAX);
+        REQUIRE(td.quota_fail_count == 0U);
+    }
+
+    // The memory is attributed to the tag of the request; the untagged allocations are attributed to tag zero.
+    auto* const a = heap->allocateTagged(100U, 1U);
+    auto* const b = heap->allocateTagged(300U, 2U);
+    auto* const c = heap->allocate(50U);
+    REQUIRE(a != nullptr);
+    REQUIRE(b != nullptr);
+    REQUIRE(c != nullptr);
+    const auto size_a = Fragment::constructFromAllocatedMemory(a).getSize();
+    const auto size_b = Fragment::constructFromAllocatedMemory(b).getSize();
+    const auto size_c = Fragment::constructFromAllocatedMemory(c).getSize();
+    REQUIRE(o1heapGetTag(handle, a) == 1U);
+    REQUIRE(o1heapGetTag(handle, b) == 2U);
+    REQUIRE(o1heapGetTag(handle, c) == 0U);
+    REQUIRE(o1heapGetTagDiagnostics(handle, 0U).allocated == size_c);
+    REQUIRE(o1heapGetTagDiagnostics(handle, 1U).allocated == size_a);
+    REQUIRE(o1heapGetTagDiagnostics(handle, 2U).allocated == size_b);
+
+    // The tag is reported by the traversal and recorded in the snapshot.
+    const auto callback = [](void* const context, const O1HeapFragmentInfo* const info) {
+        if (info->used)
+        {
+            static_cast<std::vector<std::uint8_t>*>(context)->push_back(info->tag);
+        }
+        return true;
+    };
+    std::vector<std::uint8_t> tags;
+    REQUIRE(o1heapTraverse(handle, callback, &tags) == 4U);
+    REQUIRE(tags == std::vector<std::uint8_t>{1U, 2U, 0U});
+    std::vector<std::uint8_t> snap(o1heapSnapshot(handle, nullptr, 0U));
+    REQUIRE(o1heapSnapshot(handle, snap.data(), snap.size()) == snap.size());
+    REQUIRE(snap.at(O1HEAP_SNAPSHOT_HEADER_SIZE + 20U) == 1U);
+    REQUIRE(snap.at(O1HEAP_SNAPSHOT_HEADER_SIZE + O1HEAP_SNAPSHOT_RECORD_SIZE + 20U) == 2U);
+
+    // The peak is retained after freeing and reset on request.
+    heap->free(b);
+    REQUIRE(o1heapGetTagDiagnostics(handle, 2U).allocated == 0U);
+    REQUIRE(o1heapGetTagDiagnostics(handle, 2U).peak_allocated == size_b);
+    heap->resetPeaks();
+    REQUIRE(o1heapGetTagDiagnostics(handle, 2U).peak_allocated == 0U);
+    REQUIRE(o1heapGetTagDiagnostics(handle, 1U).peak_allocated == size_a);
+
+    // The quota is checked against the fragment size including the overhead; a failure counts as an OOM as well.
+    REQUIRE(o1heapSetTagQuota(handle, 1U, size_a * 2U));
+    REQUIRE(o1heapGetTagDiagnostics(handle, 1U).quota == (size_a * 2U));
+    auto* const d = heap->allocateTagged(100U, 1U);
+    REQUIRE(d != nullptr);
+    const auto oom_count = heap->diagnostics.oom_count;
+    REQUIRE(heap->allocateTagged(1U, 1U) == nullptr);
+    REQUIRE(o1heapGetTagDiagnostics(handle, 1U).quota_fail_count == 1U);
+    REQUIRE(heap->diagnostics.oom_count == (oom_count + 1U));
+    REQUIRE(heap->allocateTagged(1U, 2U) != nullptr);  // Other tags are not affected.
+
+    // The reallocated memory retains the tag; the growth is subject to the quota.
+    heap->free(d);
+    auto* const e = heap->reallocate(a, 10U);
+    REQUIRE(e == a);
+    REQUIRE(o1heapGetTag(handle, e) == 1U);
+    REQUIRE(o1heapGetTagDiagnostics(handle, 1U).allocated == Fragment::SizeMin);
+    REQUIRE(heap->reallocate(e, (size_a * 2U) - O1HEAP_ALIGNMENT) != nullptr);
+    REQUIRE(o1heapGetTagDiagnostics(handle, 1U).allocated == (size_a * 2U));
+    REQUIRE(heap->reallocate(e, size_a * 2U) == nullptr);
+    REQUIRE(o1heapGetTagDiagnostics(handle, 1U).quota_fail_count == 2U);
+    REQUIRE(o1heapGetTagDiagnostics(handle, 1U).allocated == (size_a * 2U));
+    REQUIRE(o1heapSetTagQuota(handle, 1U, SIZE_MAX));
+
+    // The reset and the rollback restore the per-tag memory use.
+    heap->reset();
+    for (std::uint8_t tag = 0U; tag < O1HEAP_TAG_COUNT; tag++)
+    {
+        REQUIRE(o1heapGetTagDiagnostics(handle, tag).allocated == 0U);
     }
+    REQUIRE(heap->allocateTagged(64U, 2U) != nullptr);
+    REQUIRE(heap->mark());
+    const auto before = o1heapGetTagDiagnostics(handle, 2U).allocated;
+    REQUIRE(heap->allocateTagged(64U, 2U) != nullptr);
+    REQUIRE(heap->allocateTagged(64U, 1U) != nullptr);
+    REQUIRE(o1heapGetTagDiagnostics(handle, 2U).allocated > before);
+    REQUIRE(heap->rollback());
+    REQUIRE(o1heapGetTagDiagnostics(handle, 2U).allocated == before);
+    REQUIRE(o1heapGetTagDiagnostics(handle, 1U).allocated == 0U);
+
+    // Invalid tags are rejected.
+    const auto requests = heap->diagnostics;
+    REQUIRE(heap->allocateTagged(100U, O1HEAP_TAG_COUNT) == nullptr);
+    REQUIRE(heap->diagnostics.oom_count == requests.oom_count);
+    REQUIRE(!o1heapSetTagQuota(handle, O1HEAP_TAG_COUNT, 0U));
+    REQUIRE(o1heapGetTagDiagnostics(handle, O1HEAP_TAG_COUNT).quota == 0U);
 }
 
-TEST_CASE("General: invariant checker")
+TEST_CASE("General: reserve")
 {
     using internal::Fragment;
 
-    alignas(128U) std::array<std::byte, 4096U + sizeof(internal::O1HeapInstance) + O1HEAP_ALIGNMENT - 1U> arena{};
+    alignas(128U) std::array<std::byte, 4096U + sizeof(internal::O1HeapInstance) + O1HEAP_ALIGNMENT * 2U - 1U> arena{};
     auto heap = init(arena.data(), std::size(arena));
     REQUIRE(heap != nullptr);
+    auto* const    handle   = reinterpret_cast<::O1HeapInstance*>(heap);
+    constexpr auto Amount   = Fragment::SizeMin - O1HEAP_ALIGNMENT;  // One smallest fragment per request.
+    constexpr auto Reserve  = Fragment::SizeMin * 4U;
+    const auto     capacity = heap->diagnostics.capacity;
+
+    // There is no reserve by default.
+    REQUIRE(heap->reserve == 0U);
+    auto* const a = heap->allocate(Amount);
+    REQUIRE(a != nullptr);
+    heap->free(a);
+    REQUIRE(heap->diagnostics.reserve_hit_count == 0U);
+
+    // The low-priority requests are denied once they would drop the free memory below the reserve.
+    // The batch that would intrude into the reserve is allocated item by item until the first denial.
+    o1heapSetReserve(handle, Reserve, 2U);
+    const auto normal = heap->allocateBatch(Amount, ((capacity - Reserve) / Fragment::SizeMin) + 2U);
+    REQUIRE(normal.size() == ((capacity - Reserve) / Fragment::SizeMin));
+    REQUIRE(heap->diagnostics.allocated == (capacity - Reserve));
+    REQUIRE(heap->diagnostics.reserve_denial_count == 1U);
+    REQUIRE(heap->diagnostics.oom_count == 1U);
+    REQUIRE(heap->diagnostics.reserve_hit_count == 0U);
+    REQUIRE(heap->allocateTagged(Amount, 1U) == nullptr);
+    REQUIRE(heap->allocatePrioritized(Amount, 1U, 1U) == nullptr);
+    REQUIRE(heap->allocateAligned(Fragment::SizeMin * 4U, Amount) == nullptr);
+    REQUIRE(heap->reallocate(normal.back(), Fragment::SizeMin * 2U) == nullptr);  // No growth either.
+    REQUIRE(heap->diagnostics.reserve_denial_count == 5U);
+    REQUIRE(heap->diagnostics.oom_count == 5U);
+
+    // The requests of the minimum priority and above can use the reserve until the memory is exhausted;
+    // then the requests fail as usual rather than being denied.
+    auto* const b = heap->allocatePrioritized(Amount, 1U, 2U);
+    auto* const c = heap->allocatePrioritized(Fragment::SizeMin, 0U, UINT8_MAX);  // Takes two smallest fragments.
+    REQUIRE(b != nullptr);
+    REQUIRE(c != nullptr);
+    REQUIRE(o1heapGetTag(handle, b) == 1U);
+    REQUIRE(heap->diagnostics.reserve_hit_count == 2U);
+    REQUIRE(heap->allocatePrioritized(Fragment::SizeMin * 2U, 0U, 2U) == nullptr);
+    REQUIRE(heap->diagnostics.reserve_denial_count == 5U);
+    REQUIRE(heap->diagnostics.oom_count == 6U);
     REQUIRE(heap->doInvariantsHold());
-    auto& dg = heap->diagnostics;
 
-    dg.capacity++;
-    REQUIRE(!heap->doInvariantsHold());
-    dg.capacity--;
-    REQUIRE(heap->doInvariantsHold());
+    // Once the memory is freed, the low-priority requests are served again.
+    heap->free(c);
+    heap->free(b);
+    heap->free(normal.back());
+    REQUIRE(heap->allocate(Amount) != nullptr);
+    REQUIRE(heap->allocate(Amount) == nullptr);
+
+    // With the minimum priority of zero, the reserve only counts the allocations that have used it.
+    o1heapSetReserve(handle, Reserve, 0U);
+    REQUIRE(heap->allocate(Amount) != nullptr);
+    REQUIRE(heap->diagnostics.reserve_hit_count == 3U);
+    REQUIRE(heap->diagnostics.reserve_denial_count == 6U);
+    o1heapSetReserve(handle, 0U, 0U);
+    REQUIRE(heap->allocate(Amount) != nullptr);
+    REQUIRE(heap->diagnostics.reserve_hit_count == 3U);
+}
 
-    dg.allocated += Fragment::SizeMin;
-    REQUIRE(!heap->doInvariantsHold());
-    dg.peak_allocated += Fragment::SizeMin;
-    REQUIRE(!heap->doInvariantsHold());
-    dg.peak_request_size += 1;
-    REQUIRE(heap->doInvariantsHold());
-    dg.peak_allocated--;
-    REQUIRE(!heap->doInvariantsHold());
-    dg.peak_allocated++;
-    dg.allocated -= Fragment::SizeMin;
-    REQUIRE(heap->doInvariantsHold());
-    dg.allocated++;
-    REQUIRE(!heap->doInvariantsHold());
-    dg.allocated--;
+TEST_CASE("General: pressure callback")
+{
+    using internal::Fragment;
+    using Event = std::pair<O1HeapPressureEvent, std::size_t>;
+
+    alignas(128U) std::array<std::byte, 4096U + sizeof(internal::O1HeapInstance) + O1HEAP_ALIGNMENT * 2U - 1U> arena{};
+    auto heap = init(arena.data(), std::size(arena));
+    REQUIRE(heap != nullptr);
+    auto* const    handle   = reinterpret_cast<::O1HeapInstance*>(heap);
+    constexpr auto Amount   = Fragment::SizeMin - O1HEAP_ALIGNMENT;  // One smallest fragment per request.
+    const auto     capacity = heap->diagnostics.capacity;
+
+    // The application cache that gives its memory back on OOM.
+    struct Context final
+    {
+        ::O1HeapInstance*  handle = nullptr;
+        std::vector<void*> cache;
+        std::vector<Event> events;
+        bool               nested = false;
+    } ctx;
+    ctx.handle          = handle;
+    const auto callback = [](void* const context, const O1HeapPressureEvent event, const std::size_t amount) {
+        auto& c = *static_cast<Context*>(context);
+        c.events.emplace_back(event, amount);
+        bool freed = false;
+        if (event == O1HEAP_PRESSURE_OOM)
+        {
+            if (c.nested)
+            {
+                REQUIRE(o1heapAllocate(c.handle, amount) == nullptr);  // Not reported as the callback is running.
+            }
+            freed = !c.cache.empty();
+            for (auto* const p : c.cache)
+            {
+                o1heapFree(c.handle, p);
+            }
+            c.cache.clear();
+        }
+        return freed;
+    };
+    const auto fill = [&heap, capacity](std::vector<void*>& out) {
+        for (std::size_t i = 0U; i < (capacity / Fragment::SizeMin); i++)
+        {
+            out.push_back(heap->allocate(Amount));
+            REQUIRE(out.back() != nullptr);
+        }
+        REQUIRE(heap->diagnostics.allocated == capacity);
+    };
+    o1heapSetPressureCallback(handle, callback, &ctx, capacity / 2U, capacity / 4U);
+
+    // The high watermark is reported once when crossed.
+    fill(ctx.cache);
+    REQUIRE(ctx.events == std::vector<Event>{{O1HEAP_PRESSURE_HIGH, 0U}});
+
+    // The failed request is retried once after the callback has freed the cache; the failure is counted nonetheless.
+    // The events caused by the callback itself are not reported.
+    auto* const a = heap->allocate(1500U);
+    REQUIRE(a != nullptr);
+    REQUIRE(ctx.cache.empty());
+    REQUIRE(ctx.events.size() == 2U);
+    REQUIRE(ctx.events.back() == Event{O1HEAP_PRESSURE_OOM, 1500U});
+    REQUIRE(heap->diagnostics.oom_count == 1U);
+    REQUIRE(heap->diagnostics.allocated > (capacity / 4U));
+
+    // The low watermark is reported when the allocated memory falls to it.
+    heap->free(a);
+    REQUIRE(ctx.events.size() == 3U);
+    REQUIRE(ctx.events.back() == Event{O1HEAP_PRESSURE_LOW, 0U});
+
+    // The request is not retried if the callback has not freed anything. The callback is not invoked recursively.
+    std::vector<void*> pinned;
+    fill(pinned);
+    REQUIRE(ctx.events.size() == 4U);
+    REQUIRE(ctx.events.back() == Event{O1HEAP_PRESSURE_HIGH, 0U});
+    ctx.nested = true;
+    REQUIRE(heap->allocate(Amount) == nullptr);
+    ctx.nested = false;
+    REQUIRE(ctx.events.size() == 5U);
+    REQUIRE(ctx.events.back() == Event{O1HEAP_PRESSURE_OOM, Amount});
+    REQUIRE(heap->diagnostics.oom_count == 3U);  // Including the nested request.
+    heap->freeBatch(pinned);
+    REQUIRE(ctx.events.size() == 6U);
+    REQUIRE(ctx.events.back() == Event{O1HEAP_PRESSURE_LOW, 0U});
+
+    // The aligned allocation is retried as well. The memory use has dropped below the low watermark meanwhile.
+    fill(ctx.cache);
+    auto* const b = heap->allocateAligned(Fragment::SizeMin * 4U, 100U);
+    REQUIRE(b != nullptr);
+    REQUIRE(ctx.events.size() == 9U);
+    REQUIRE(ctx.events.at(7) == Event{O1HEAP_PRESSURE_OOM, 100U});
+    REQUIRE(ctx.events.at(8) == Event{O1HEAP_PRESSURE_LOW, 0U});
+    REQUIRE(heap->diagnostics.oom_count == 4U);
+
+    // Once detached, the callback is no longer invoked.
+    o1heapSetPressureCallback(handle, nullptr, nullptr, SIZE_MAX, 0U);
+    heap->free(b);
+    REQUIRE(heap->allocate(capacity) == nullptr);
+    REQUIRE(ctx.events.size() == 9U);
+}
+
+TEST_CASE("General: lifetime hints")
+{
+    using internal::Fragment;
+    constexpr auto S = Fragment::SizeMin;
+
+    alignas(128U) std::array<std::byte, 4096U + sizeof(internal::O1HeapInstance) + O1HEAP_ALIGNMENT * 2U - 1U> arena{};
+    auto heap = init(arena.data(), std::size(arena));
+    REQUIRE(heap != nullptr);
+    const auto  capacity = heap->diagnostics.capacity;
+    const auto  frag     = [](void* const p) { return &Fragment::constructFromAllocatedMemory(p); };
+    auto* const probe    = heap->allocate(1U);  // The first allocation is placed at the bottom of the arena.
+    REQUIRE(probe != nullptr);
+    const auto* const end = reinterpret_cast<const std::byte*>(frag(probe)) + capacity;
+    heap->free(probe);
+
+    // The long-lived allocations accumulate at the top of the arena, the short-lived ones at the bottom.
+    auto* const a = heap->allocateHinted(S - O1HEAP_ALIGNMENT, O1HEAP_LIFETIME_LONG);
+    auto* const b = heap->allocateHinted(S - O1HEAP_ALIGNMENT, O1HEAP_LIFETIME_SHORT);
+    auto* const c = heap->allocateHinted((S * 2U) - O1HEAP_ALIGNMENT, O1HEAP_LIFETIME_LONG);
+    auto* const d = heap->allocateHinted(S - O1HEAP_ALIGNMENT, O1HEAP_LIFETIME_SHORT);
+    REQUIRE(a != nullptr);
+    REQUIRE(b != nullptr);
+    REQUIRE(c != nullptr);
+    REQUIRE(d != nullptr);
+    REQUIRE(reinterpret_cast<const std::byte*>(frag(a)) == (end - S));
+    REQUIRE(reinterpret_cast<const std::byte*>(frag(c)) == (end - (S * 3U)));
+    REQUIRE(frag(c)->getNext() == frag(a));
+    REQUIRE(frag(a)->getNext() == nullptr);
+    REQUIRE(frag(b)->getNext() == frag(d));
+    REQUIRE(heap->diagnostics.allocated == (S * 5U));
     REQUIRE(heap->doInvariantsHold());
 
-    dg.peak_allocated = dg.capacity + 1U;
-    REQUIRE(!heap->doInvariantsHold());
-    dg.peak_allocated = dg.capacity;
+    // The memory released by the short-lived allocations merges with the free space in the middle.
+    heap->free(b);
+    heap->free(d);
+    REQUIRE(heap->diagnostics.largest_allocatable == ((capacity / 2U) - O1HEAP_ALIGNMENT));
+    auto* const e = heap->allocate(heap->diagnostics.largest_allocatable);
+    REQUIRE(e != nullptr);
+    REQUIRE(reinterpret_cast<const std::byte*>(frag(e)) == (end - capacity));
+    heap->free(e);
+
+    // The long-lived fragments coalesce with their neighbors as usual.
+    heap->free(c);
+    heap->free(a);
+    REQUIRE(heap->diagnostics.allocated == 0U);
+    REQUIRE(heap->allocate(capacity - O1HEAP_ALIGNMENT) != nullptr);
+}
+
+TEST_CASE("General: movable")
+{
+    using internal::Fragment;
+    constexpr auto S = Fragment::SizeMin;
+
+    alignas(128U) std::array<std::byte, 4096U + sizeof(internal::O1HeapInstance) + O1HEAP_ALIGNMENT * 2U - 1U> arena{};
+    auto heap = init(arena.data(), std::size(arena));
+    REQUIRE(heap != nullptr);
+    auto* const handle   = reinterpret_cast<::O1HeapInstance*>(heap);
+    const auto  capacity = heap->diagnostics.capacity;
+
+    // Each movable allocation of S bytes takes a fragment of 2S bytes because of the hidden handle.
+    std::array<O1HeapMovableEntry, 6U> table{};
+    REQUIRE(o1heapAllocateMovable(handle, S) == 0U);  // There is no table yet.
+    REQUIRE(o1heapSetMovableTable(handle, table.data(), table.size()));
+    const auto fill = [handle](const O1HeapMovable m) {
+        auto* const p = static_cast<std::uint8_t*>(o1heapPin(handle, m));
+        REQUIRE((reinterpret_cast<std::size_t>(p) % O1HEAP_ALIGNMENT) == 0U);
+        std::fill_n(p, S, static_cast<std::uint8_t>(m));
+        o1heapUnpin(handle, m);
+    };
+    const auto check = [handle](const O1HeapMovable m) {
+        const auto* const p = static_cast<const std::uint8_t*>(o1heapPin(handle, m));
+        REQUIRE(std::all_of(p, p + S, [m](const std::uint8_t x) { return x == static_cast<std::uint8_t>(m); }));
+        o1heapUnpin(handle, m);
+        return p;
+    };
+    const auto a = o1heapAllocateMovable(handle, S);
+    const auto b = o1heapAllocateMovable(handle, S);
+    const auto c = o1heapAllocateMovable(handle, S);
+    const auto d = o1heapAllocateMovable(handle, S);
+    auto* const x = heap->allocate(S);  // An ordinary allocation is never moved.
+    const auto e = o1heapAllocateMovable(handle, S);
+    REQUIRE(x != nullptr);
+    for (const auto m : {a, b, c, d, e})
+    {
+        REQUIRE(m != 0U);
+        fill(m);
+    }
+    // The hidden handle is a part of the overhead, so the diagnostics only see the requested amounts.
+    REQUIRE(heap->diagnostics.peak_request_size == S);
+    REQUIRE(heap->diagnostics.rounding_waste == ((S * 2U) - S - O1HEAP_ALIGNMENT));  // Only from the ordinary one.
+    REQUIRE(o1heapAllocateMovable(handle, 0U) == 0U);
+    REQUIRE(heap->diagnostics.oom_count == 0U);
+    REQUIRE(o1heapAllocateMovable(handle, capacity) == 0U);
+    REQUIRE(heap->diagnostics.oom_count == 1U);
+    REQUIRE(heap->diagnostics.peak_request_size == capacity);
+    REQUIRE(heap->movable.live == 5U);
+    heap->matchFragments({{true, S * 2U},
+                          {true, S * 2U},
+                          {true, S * 2U},
+                          {true, S * 2U},
+                          {true, S * 2U},
+                          {true, S * 2U},
+                          {false, capacity - (S * 12U)}});
+    REQUIRE(Fragment::constructFromAllocatedMemory(x).isMovable() == false);
+
+    // The pinned allocation is not moved, so only the hole left by c is filled by d.
+    o1heapFreeMovable(handle, a);
+    o1heapFreeMovable(handle, c);
+    REQUIRE(!o1heapSetMovableTable(handle, nullptr, 0U));  // There are movable allocations.
+    const auto* const pinned = o1heapPin(handle, b);
+    const auto* const old_d  = check(d);
+    REQUIRE(heap->compactStep(100U) == 1U);
+    REQUIRE(o1heapPin(handle, b) == pinned);
+    o1heapUnpin(handle, b);
+    o1heapUnpin(handle, b);
+    REQUIRE(check(d) == (old_d - (S * 2U)));
+    heap->matchFragments({{false, S * 2U},
+                          {true, S * 2U},
+                          {true, S * 2U},
+                          {false, S * 2U},
+                          {true, S * 2U},
+                          {true, S * 2U},
+                          {false, capacity - (S * 12U)}});
+
+    // Once unpinned, the allocations slide down until they bump into the ordinary one.
+    REQUIRE(heap->compactStep(100U) == 2U);
+    REQUIRE(heap->compactStep(100U) == 0U);
+    heap->matchFragments({{true, S * 2U},
+                          {true, S * 2U},
+                          {false, S * 4U},
+                          {true, S * 2U},
+                          {true, S * 2U},
+                          {false, capacity - (S * 12U)}});
+
+    // Once the ordinary allocation is freed, the last one slides down, too, and the free space becomes contiguous.
+    heap->free(x);
+    REQUIRE(heap->compactStep(100U) == 1U);
+    heap->matchFragments({{true, S * 2U}, {true, S * 2U}, {true, S * 2U}, {false, capacity - (S * 6U)}});
+    for (const auto m : {b, d, e})
+    {
+        (void) check(m);
+    }
     REQUIRE(heap->doInvariantsHold());
 
-    dg.peak_request_size = dg.capacity;
-    REQUIRE(!heap->doInvariantsHold());
-    dg.oom_count++;
+    // The vacated entries are reused; when the table is exhausted, the allocation fails.
+    std::vector<O1HeapMovable> more;
+    for (std::size_t i = 0U; i < 3U; i++)
+    {
+        more.push_back(o1heapAllocateMovable(handle, S));
+        REQUIRE(more.back() != 0U);
+    }
+    REQUIRE(o1heapAllocateMovable(handle, S) == 0U);
+    for (const auto m : more)
+    {
+        o1heapFreeMovable(handle, m);
+    }
+    o1heapFreeMovable(handle, 0U);
+
+    // The reset vacates all entries; the table can then be detached.
+    heap->reset();
+    REQUIRE(heap->movable.live == 0U);
+    REQUIRE(std::all_of(std::begin(table), std::end(table), [](const auto& en) { return en.pointer == nullptr; }));
+    REQUIRE(heap->compactStep(100U) == 0U);
+    REQUIRE(o1heapSetMovableTable(handle, nullptr, 0U));
+    REQUIRE(o1heapAllocateMovable(handle, S) == 0U);
+}
+
+TEST_CASE("General: movable: random")
+{
+    using internal::Fragment;
+    std::minstd_rand rng(42U);  // NOLINT: fixed seed for reproducibility.
+
+    alignas(128U) std::array<std::byte, 65536U + sizeof(internal::O1HeapInstance) + O1HEAP_ALIGNMENT * 2U - 1U> arena{};
+    auto heap = init(arena.data(), std::size(arena));
+    REQUIRE(heap != nullptr);
+    auto* const                         handle = reinterpret_cast<::O1HeapInstance*>(heap);
+    std::array<O1HeapMovableEntry, 64U> table{};
+    REQUIRE(o1heapSetMovableTable(handle, table.data(), table.size()));
+
+    // The contents are verified after every compaction step; some allocations are pinned meanwhile.
+    std::vector<std::pair<O1HeapMovable, std::size_t>> live;
+    std::vector<void*>                                 ordinary;
+    std::vector<O1HeapMovable>                         pins;
+    const auto verify = [handle](const O1HeapMovable m, const std::size_t size) {
+        const auto* const p = static_cast<const std::uint8_t*>(o1heapPin(handle, m));
+        REQUIRE(std::all_of(p, p + size, [m](const std::uint8_t x) { return x == static_cast<std::uint8_t>(m * 7U); }));
+        o1heapUnpin(handle, m);
+    };
+    for (std::size_t i = 0U; i < 20'000U; i++)
+    {
+        const auto r = rng() % 16U;
+        if ((r < 6U) || live.empty())
+        {
+            const std::size_t size = (rng() % 500U) + 1U;
+            const auto        m    = o1heapAllocateMovable(handle, size);
+            if (m != 0U)
+            {
+                std::memset(o1heapPin(handle, m), static_cast<int>((m * 7U) & 0xFFU), size);
+                o1heapUnpin(handle, m);
+                live.emplace_back(m, size);
+            }
+        }
+        else if (r < 10U)
+        {
+            const auto k = rng() % live.size();
+            if (std::find(std::begin(pins), std::end(pins), live.at(k).first) == std::end(pins))
+            {
+                o1heapFreeMovable(handle, live.at(k).first);
+                live.erase(std::begin(live) + static_cast<std::ptrdiff_t>(k));
+            }
+        }
+        else if (r < 11U)
+        {
+            if ((ordinary.size() < 8U) || ((rng() % 2U) == 0U))
+            {
+                ordinary.push_back(heap->allocate((rng() % 200U) + 1U));
+            }
+            else
+            {
+                heap->free(ordinary.front());
+                ordinary.erase(std::begin(ordinary));
+            }
+        }
+        else if (r < 12U)
+        {
+            if (pins.empty())
+            {
+                pins.push_back(live.at(rng() % live.size()).first);
+                (void) o1heapPin(handle, pins.back());
+            }
+            else
+            {
+                o1heapUnpin(handle, pins.back());
+                pins.pop_back();
+            }
+        }
+        else
+        {
+            (void) heap->compactStep((rng() % 8U) + 1U);
+            for (const auto& [m, size] : live)
+            {
+                verify(m, size);
+            }
+        }
+    }
     REQUIRE(heap->doInvariantsHold());
+    for (const auto m : pins)
+    {
+        o1heapUnpin(handle, m);
+    }
+    for (auto* const p : ordinary)
+    {
+        heap->free(p);
+    }
+
+    // With nothing pinned and no ordinary allocations, a full compaction leaves a single free fragment at the end.
+    while (heap->compactStep(1000U) > 0U)
+    {
+    }
+    std::size_t used = 0U;
+    for (const auto& [m, size] : live)
+    {
+        verify(m, size);
+        used += Fragment::constructFromAllocatedMemory(static_cast<std::byte*>(o1heapPin(handle, m)) - O1HEAP_ALIGNMENT)
+                    .getSize();
+        o1heapUnpin(handle, m);
+    }
+    REQUIRE(heap->diagnostics.allocated == used);
+    const auto frags = heap->getRegionFirstFragments();
+    std::size_t free_count = 0U;
+    for (const auto* frag = frags.at(0); frag != nullptr; frag = frag->getNext())
+    {
+        free_count += frag->isUsed() ? 0U : 1U;
+        REQUIRE((frag->isUsed() || (frag->getNext() == nullptr)));
+    }
+    REQUIRE(free_count <= 1U);
+}
+
+TEST_CASE("General: traverse and snapshot")
+{
+    using internal::Fragment;
+
+    alignas(128U) std::array<std::byte, 4096U + sizeof(internal::O1HeapInstance) + O1HEAP_ALIGNMENT * 2U - 1U> arena{};
+    alignas(128U) std::array<std::byte, 1024U + internal::RegionSizePadded + O1HEAP_ALIGNMENT * 2U - 1U> region{};
+    auto heap = init(arena.data(), std::size(arena));
+    REQUIRE(heap != nullptr);
+    REQUIRE(heap->addRegion(region.data(), std::size(region)));
+    auto* const a = heap->allocate(1024U - O1HEAP_ALIGNMENT);  // Served from the region.
+    auto* const b = heap->allocate(100U);
+    auto* const c = heap->allocate(300U);
+    REQUIRE(a != nullptr);
+    REQUIRE(b != nullptr);
+    REQUIRE(c != nullptr);
+    heap->free(b);
+
+    const auto traverse = [&heap](const std::size_t limit) {
+        std::vector<O1HeapFragmentInfo> out;
+        const auto callback = [](void* const context, const O1HeapFragmentInfo* const info) {
+            auto& [vec, lim] = *static_cast<std::pair<std::vector<O1HeapFragmentInfo>*, std::size_t>*>(context);
+            vec->push_back(*info);
+            return vec->size() < lim;
+        };
+        std::pair<std::vector<O1HeapFragmentInfo>*, std::size_t> context{&out, limit};
+        const auto count = o1heapTraverse(reinterpret_cast<::O1HeapInstance*>(heap), callback, &context);
+        REQUIRE(count == out.size());
+        return out;
+    };
+
+    // The fragments are reported region by region in the order of their addresses, matching the internal layout.
+    const auto infos = traverse(SIZE_MAX);
+    std::size_t idx  = 0U;
+    const auto  roots = heap->getRegionFirstFragments();
+    for (std::size_t reg = 0U; reg < roots.size(); reg++)
+    {
+        for (const Fragment* frag = roots.at(reg); frag != nullptr; frag = frag->getNext())
+        {
+            const auto& info = infos.at(idx++);
+            CAPTURE(reg, idx);
+            REQUIRE(info.region == reg);
+            REQUIRE(info.pointer == (reinterpret_cast<const std::byte*>(frag) + O1HEAP_ALIGNMENT));
+            REQUIRE(info.offset == static_cast<std::size_t>(reinterpret_cast<const std::byte*>(frag) -
+                                                            reinterpret_cast<const std::byte*>(roots.at(reg))));
+            REQUIRE(info.size == frag->getSize());
+            REQUIRE(info.used == frag->isUsed());
+        }
+    }
+    REQUIRE(idx == infos.size());
+    REQUIRE(infos.size() == 4U);  // The arena holds b (free), c, and the free remainder; the region holds a.
+    REQUIRE(infos.at(0).pointer == b);
+    REQUIRE(traverse(2U).size() == 2U);  // Stopped by the callback.
+
+    // The snapshot size is reported without writing if the buffer is missing or too small.
+    const auto size = o1heapSnapshot(reinterpret_cast<::O1HeapInstance*>(heap), nullptr, 0U);
+    REQUIRE(size == (O1HEAP_SNAPSHOT_HEADER_SIZE + (infos.size() * O1HEAP_SNAPSHOT_RECORD_SIZE)));
+    std::vector<std::uint8_t> buf(size + 1U, 0xAAU);
+    REQUIRE(o1heapSnapshot(reinterpret_cast<::O1HeapInstance*>(heap), buf.data(), size - 1U) == size);
+    REQUIRE(buf.at(0) == 0xAAU);  // The header is only written if the entire snapshot fits.
+    REQUIRE(o1heapSnapshot(reinterpret_cast<::O1HeapInstance*>(heap), buf.data(), buf.size()) == size);
+    REQUIRE(buf.at(size) == 0xAAU);
+
+    // The snapshot is encoded in little-endian regardless of the platform.
+    const auto read = [&buf](const std::size_t offset, const std::size_t width) {
+        std::uint64_t out = 0U;
+        for (std::size_t i = 0U; i < width; i++)
+        {
+            out |= static_cast<std::uint64_t>(buf.at(offset + i)) << (i * 8U);
+        }
+        return out;
+    };
+    REQUIRE(read(0U, 4U) == O1HEAP_SNAPSHOT_MAGIC);
+    REQUIRE(std::equal(buf.begin(), buf.begin() + 4, std::begin({'O', '1', 'H', 'S'})));
+    REQUIRE(read(4U, 4U) == O1HEAP_SNAPSHOT_VERSION);
+    REQUIRE(read(8U, 8U) == heap->diagnostics.capacity);
+    REQUIRE(read(16U, 8U) == heap->diagnostics.allocated);
+    REQUIRE(read(24U, 8U) == infos.size());
+    REQUIRE(read(32U, 4U) == O1HEAP_ALIGNMENT);
+    for (std::size_t i = 0U; i < infos.size(); i++)
+    {
+        const auto base = O1HEAP_SNAPSHOT_HEADER_SIZE + (i * O1HEAP_SNAPSHOT_RECORD_SIZE);
+        CAPTURE(i);
+        REQUIRE(read(base, 8U) == infos.at(i).offset);
+        REQUIRE(read(base + 8U, 8U) == (infos.at(i).size | (infos.at(i).used ? 1U : 0U)));
+        REQUIRE(read(base + 16U, 4U) == infos.at(i).region);
+        REQUIRE(read(base + 20U, 4U) == infos.at(i).tag);
+    }
+
+    heap->free(a);
+    heap->free(c);
+    REQUIRE(traverse(SIZE_MAX).size() == 2U);
+}
+
+TEST_CASE("General: incremental validation")
+{
+    using internal::Fragment;
+
+    alignas(128U) std::array<std::byte, 4096U + sizeof(internal::O1HeapInstance) + O1HEAP_ALIGNMENT * 2U - 1U> arena{};
+    alignas(128U) std::array<std::byte, 1024U + internal::RegionSizePadded + O1HEAP_ALIGNMENT * 2U - 1U> region{};
+    auto heap = init(arena.data(), std::size(arena));
+    REQUIRE(heap != nullptr);
+    REQUIRE(heap->addRegion(region.data(), std::size(region)));
+    const auto passes = [&heap] { return heap->diagnostics.validation_pass_count; };
+
+    // Each region of an empty heap consists of a single fragment.
+    REQUIRE(heap->validateStep(0U));
+    REQUIRE(heap->validation.fragment == nullptr);
+    REQUIRE(heap->validateStep(1U));
+    REQUIRE(heap->validation.region == 1U);
+    REQUIRE(passes() == 0U);
+    REQUIRE(heap->validateStep(1U));
+    REQUIRE(heap->validation.fragment == nullptr);
+    REQUIRE(passes() == 1U);
+    REQUIRE(heap->validateStep(100U));  // Multiple passes per call.
+    REQUIRE(passes() == 51U);
+
+    // [ 0 ][ 1 ][ 2 ][ 3 ][ 4 ][ 5 ][ 6 ][ 7 ][ free ], where the odd fragments are freed.
+    std::array<void*, 8> v{};
+    for (auto& x : v)
+    {
+        x = heap->allocate((Fragment::SizeMin * 4U) - O1HEAP_ALIGNMENT);
+        REQUIRE(x != nullptr);
+    }
+    heap->free(v.at(1));
+    heap->free(v.at(3));
+    heap->free(v.at(5));
+    const auto frag = [&v](const std::size_t index) { return &Fragment::constructFromAllocatedMemory(v.at(index)); };
+    const auto start = passes();
+    while (passes() < (start + 2U))  // The second pass is not disturbed by the modifications, so it checks the totals.
+    {
+        REQUIRE(heap->validateStep(3U));
+    }
+
+    // The heap can be modified between the steps. If the next fragment to validate is merged into its left neighbor,
+    // the validation proceeds from the neighbor.
+    while (heap->validation.fragment != frag(2U))
+    {
+        REQUIRE(heap->validateStep(1U));
+    }
+    const auto* const merged = frag(1U);
+    heap->free(v.at(2));  // [ 0 ][ --- 1 --- ][ 4 ][ 5 ][ 6 ][ 7 ][ free ]
+    REQUIRE(heap->validation.fragment == merged);
+    REQUIRE(passes() == (start + 2U));
+    while (passes() < (start + 4U))
+    {
+        REQUIRE(heap->validateStep(1U));
+    }
+
+    // A corrupted free list link is detected as soon as the affected fragment is reached, and the validation restarts.
+    // The mirror is not validated while the heap is corrupted.
+    auto* const victim = const_cast<Fragment*>(frag(5U));
+    const auto  step   = [&heap](const std::size_t max_fragments) {
+        return o1heapValidateStep(reinterpret_cast<::O1HeapInstance*>(heap), max_fragments);
+    };
+    std::swap(victim->next_free, victim->prev_free);
+    bool detected = false;
+    for (std::size_t i = 0U; (i < 100U) && (!detected); i++)
+    {
+        detected = !step(1U);
+    }
+    REQUIRE(detected);
+    REQUIRE(heap->validation.fragment == nullptr);
+    std::swap(victim->next_free, victim->prev_free);
+
+    // A corrupted size of a free list neighbor is reported rather than trips an assertion check.
+    // Another free fragment of the same size is needed for the victim to have a neighbor in its bin.
+    // The first allocation takes the victim itself, the others are carved from the free tail.
+    std::array<void*, 3> w{};
+    for (auto& x : w)
+    {
+        x = heap->allocate((Fragment::SizeMin * 4U) - O1HEAP_ALIGNMENT);
+        REQUIRE(x != nullptr);
+    }
+    REQUIRE(&Fragment::constructFromAllocatedMemory(w.at(0)) == victim);
+    heap->free(w.at(0));
+    heap->free(w.at(1));
+    auto* const neighbor = const_cast<Fragment*>((victim->getNextFree() != nullptr) ? victim->getNextFree()
+                                                                                    : victim->getPrevFree());
+    REQUIRE(neighbor != nullptr);
+    REQUIRE(neighbor != victim);
+    const auto size = neighbor->header.size;
+    for (const auto corrupted : {size & (Fragment::SizeMin - 1U), size ^ O1HEAP_ALIGNMENT})
+    {
+        while (heap->validation.fragment != victim)
+        {
+            REQUIRE(heap->validateStep(1U));
+        }
+        neighbor->header.size = static_cast<std::remove_const_t<decltype(size)>>(corrupted);
+        REQUIRE(!step(1U));
+        REQUIRE(heap->validation.fragment == nullptr);
+        neighbor->header.size = size;
+    }
+
+    // Inconsistent totals are detected at the end of an undisturbed pass.
+    heap->diagnostics.allocated += Fragment::SizeMin;
+    detected = false;
+    for (std::size_t i = 0U; (i < 100U) && (!detected); i++)
+    {
+        detected = !step(1U);
+    }
+    REQUIRE(detected);
+    heap->diagnostics.allocated -= Fragment::SizeMin;
+    REQUIRE(heap->validateStep(100U));
+
+    for (const auto i : {0U, 4U, 6U, 7U})
+    {
+        heap->free(v.at(i));
+    }
+    heap->free(w.at(2));
+    REQUIRE(heap->validateStep(100U));
+    REQUIRE(heap->doInvariantsHold());
+}
+
+TEST_CASE("General: reset")
+{
+    using internal::Fragment;
+
+    alignas(128U) std::array<std::byte, 4096U + sizeof(internal::O1HeapInstance) + O1HEAP_ALIGNMENT * 2U - 1U> arena{};
+    alignas(128U) std::array<std::byte, 1024U + internal::RegionSizePadded + O1HEAP_ALIGNMENT * 2U - 1U> region{};
+    auto heap = init(arena.data(), std::size(arena));
+    REQUIRE(heap != nullptr);
+    REQUIRE(heap->addRegion(region.data(), std::size(region)));
+    const auto pristine               = heap->diagnostics;
+    const auto pristine_fragmentation = heap->getFragmentation();
+
+    // Fill both regions with fragments of assorted sizes, free some of them, and cause an OOM.
+    std::vector<void*> pointers;
+    for (std::size_t i = 0U; i < 64U; i++)
+    {
+        auto* const p = heap->allocate((i % 7U) * 37U);
+        if (p != nullptr)
+        {
+            pointers.push_back(p);
+        }
+    }
+    for (std::size_t i = 0U; i < pointers.size(); i += 3U)
+    {
+        heap->free(pointers.at(i));
+    }
+    REQUIRE(heap->allocate(4096U) == nullptr);
+    REQUIRE(heap->validateStep(5U));
+    REQUIRE(heap->mark());
+    const auto used = heap->diagnostics;
+    REQUIRE(used.allocated > 0U);
+
+    // The state is the same as right after the initialization; the cumulative diagnostics are retained.
+    heap->reset();
+    REQUIRE(heap->validation.fragment == nullptr);
+    REQUIRE(heap->diagnostics.largest_allocatable == pristine.largest_allocatable);
+    REQUIRE(std::equal(std::begin(heap->fragmentation.free_fragment_count),
+                       std::end(heap->fragmentation.free_fragment_count),
+                       std::begin(pristine_fragmentation.free_fragment_count)));
+    REQUIRE(heap->diagnostics.peak_allocated == used.peak_allocated);
+    REQUIRE(heap->diagnostics.peak_request_size == used.peak_request_size);
+    REQUIRE(heap->diagnostics.oom_count == used.oom_count);
+    heap->matchFragments({{false, 4096U}}, 0U);
+    heap->matchFragments({{false, 1024U}}, 1U);
+    REQUIRE(!heap->rollback());  // The checkpoint is discarded.
+
+    // The entire memory is available again.
+    auto* const a = heap->allocate(4096U - O1HEAP_ALIGNMENT);
+    auto* const b = heap->allocate(1024U - O1HEAP_ALIGNMENT);
+    REQUIRE(a != nullptr);
+    REQUIRE(b != nullptr);
+    REQUIRE(heap->diagnostics.allocated == heap->diagnostics.capacity);
+    heap->reset();
+    heap->reset();  // Idempotent.
+    REQUIRE(heap->diagnostics.largest_allocatable == pristine.largest_allocatable);
+    REQUIRE(heap->doInvariantsHold());
+}
+
+TEST_CASE("General: mark and rollback")
+{
+    using internal::Fragment;
+
+    alignas(128U) std::array<std::byte, 4096U + sizeof(internal::O1HeapInstance) + O1HEAP_ALIGNMENT * 2U - 1U> arena{};
+    auto heap = init(arena.data(), std::size(arena));
+    REQUIRE(heap != nullptr);
+    REQUIRE(!heap->rollback());  // There is no checkpoint yet.
+    constexpr auto S = Fragment::SizeMin;
+
+    // Memory allocated before the checkpoint is outside of the frame, which is the rest of the arena.
+    auto* const a = heap->allocate(S - O1HEAP_ALIGNMENT);
+    REQUIRE(a != nullptr);
+    REQUIRE(heap->mark());
+    REQUIRE(heap->checkpoint.size == (4096U - S));
+    const auto marked = heap->diagnostics;
+
+    // Each frame allocates and frees within the frame in arbitrary order; the rollback frees the rest at once.
+    for (std::size_t frame = 0U; frame < 6U; frame++)
+    {
+        CAPTURE(frame);
+        const auto policy = static_cast<O1HeapFreeListPolicy>(frame % 3U);
+        o1heapSetFreeListPolicy(reinterpret_cast<::O1HeapInstance*>(heap), policy);
+        std::vector<void*> pointers;
+        for (std::size_t i = 0U; i < 40U; i++)
+        {
+            auto* const p = heap->allocate(((i * 13U) % 90U) + 1U);
+            REQUIRE(p != nullptr);
+            pointers.push_back(p);
+            if ((i % 4U) == 1U)
+            {
+                heap->free(pointers.at(i - 1U));
+            }
+        }
+        REQUIRE(heap->reallocate(pointers.back(), 200U) != nullptr);  // Reallocation within the frame is fine.
+        REQUIRE(heap->diagnostics.allocated > marked.allocated);
+        REQUIRE(heap->rollback());
+        REQUIRE(heap->diagnostics.allocated == marked.allocated);
+        REQUIRE(heap->diagnostics.largest_allocatable == marked.largest_allocatable);
+        heap->matchFragments({{true, S}, {false, 4096U - S}});
+    }
+
+    // Freeing memory allocated before the checkpoint modifies the heap outside of the frame.
+    auto* const b = heap->allocate(100U);
+    REQUIRE(b != nullptr);
+    heap->free(a);
+    REQUIRE(!heap->rollback());
+    REQUIRE(heap->diagnostics.allocated > 0U);
+    heap->free(b);
+
+    // An allocation served from a free fragment outside of the frame voids the checkpoint as well.
+    auto* const c = heap->allocate(S - O1HEAP_ALIGNMENT);
+    auto* const d = heap->allocate(S - O1HEAP_ALIGNMENT);
+    REQUIRE(c != nullptr);
+    REQUIRE(d != nullptr);
+    heap->free(c);  // [ free ][ d ][ frame ]
+    REQUIRE(heap->mark());
+    REQUIRE(heap->checkpoint.fragment == Fragment::constructFromAllocatedMemory(d).getNext());
+    REQUIRE(heap->allocate(S * 4U) != nullptr);  // Served from the frame.
+    REQUIRE(heap->rollback());
+    REQUIRE(heap->allocate(1U) != nullptr);  // Served from the smaller fragment outside of the frame.
+    REQUIRE(!heap->rollback());
+
+    // Growing a fragment outside of the frame into the frame is detected, too.
+    heap->reset();
+    auto* const e = heap->allocate(S - O1HEAP_ALIGNMENT);
+    REQUIRE(heap->mark());
+    REQUIRE(heap->reallocate(e, (S * 2U) - O1HEAP_ALIGNMENT) == e);
+    REQUIRE(!heap->rollback());
+
+    // Freeing memory allocated before the checkpoint is detected even if it is merged into a fragment in the frame.
+    heap->reset();
+    auto* const f = heap->allocate((S * 4U) - O1HEAP_ALIGNMENT);
+    auto* const g = heap->allocate(S - O1HEAP_ALIGNMENT);
+    REQUIRE(f != nullptr);
+    REQUIRE(g != nullptr);
+    while (heap->diagnostics.largest_allocatable > 0U)
+    {
+        REQUIRE(heap->allocate(heap->diagnostics.largest_allocatable) != nullptr);
+    }
+    heap->free(f);  // [ frame ][ g ][ used ]
+    REQUIRE(heap->mark());
+    REQUIRE(heap->checkpoint.fragment == &Fragment::constructFromAllocatedMemory(f));
+    REQUIRE(heap->allocate(S - O1HEAP_ALIGNMENT) != nullptr);  // [ used ][ free ][ g ][ used ]
+    heap->free(g);                                             // [ used ][ -- free -- ][ used ]
+    REQUIRE(!heap->rollback());
+    REQUIRE(heap->diagnostics.allocated == (heap->diagnostics.capacity - (S * 4U)));
+    REQUIRE(heap->validateStep(1000U));
+    const auto& merged = Fragment::constructFromAllocatedMemory(f);
+    REQUIRE(merged.isUsed());
+    REQUIRE(merged.getSize() == S);
+    REQUIRE(!merged.getNext()->isUsed());
+    REQUIRE(merged.getNext()->getSize() == (S * 4U));
+
+    // A full heap has no frame.
+    heap->reset();
+    REQUIRE(heap->allocate(4096U - O1HEAP_ALIGNMENT) != nullptr);
+    REQUIRE(!heap->mark());
+    REQUIRE(!heap->rollback());
+    REQUIRE(heap->doInvariantsHold());
+}
+
+TEST_CASE("General: add region")
+{
+    constexpr auto X       = true;   // used
+    constexpr auto O       = false;  // free
+    constexpr auto Probing = (O1HEAP_FLOOR_PROBE_LIMIT > 0U) && (O1HEAP_SUBBIN_BITS == 0U);
+
+    alignas(128U) std::array<std::byte, 4096U + sizeof(internal::O1HeapInstance) + O1HEAP_ALIGNMENT * 2U - 1U> arena{};
+    alignas(128U) std::array<std::byte, 2048U + internal::RegionSizePadded + O1HEAP_ALIGNMENT * 2U - 1U> region_a{};
+    // Two regions that are adjacent to each other in memory; they shall not be merged.
+    alignas(128U) std::array<std::byte, (1024U + internal::RegionSizePadded + O1HEAP_ALIGNMENT) * 2U> region_bc{};
+
+    auto heap = init(arena.data(), std::size(arena));
+    REQUIRE(heap != nullptr);
+    REQUIRE(!heap->addRegion(nullptr, std::size(region_a)));
+    REQUIRE(!heap->addRegion(region_a.data() + 1U, std::size(region_a) - 1U));
+    REQUIRE(!heap->addRegion(region_a.data(), internal::RegionSizePadded));
+    REQUIRE(heap->getRegionFirstFragments().size() == 1U);
+    REQUIRE(heap->getDiagnostics().capacity == 4096U);
+
+    REQUIRE(heap->addRegion(region_a.data(), std::size(region_a)));
+    REQUIRE(heap->getDiagnostics().capacity == 6144U);
+    REQUIRE(heap->getRegionFirstFragments().size() == 2U);
+    heap->matchFragments({{O, 4096}}, 0U);
+    heap->matchFragments({{O, 2048}}, 1U);
+
+    // The allocations are served from any region that has a suitable fragment.
+    auto* const a = heap->allocate(fitAmount(3000U, 4096U));
+    REQUIRE(a != nullptr);
+    auto* const b = heap->allocate(fitAmount(1500U, 2048U));
+    REQUIRE(b != nullptr);
+    heap->matchFragments({{X, 4096}}, 0U);
+    heap->matchFragments({{X, 2048}}, 1U);
+    REQUIRE(heap->getDiagnostics().allocated == 6144U);
+    REQUIRE(heap->getDiagnostics().peak_allocated == 6144U);
+    REQUIRE(heap->allocate(1U) == nullptr);
+    REQUIRE(heap->getDiagnostics().oom_count == 1U);
+
+    // Regions can be added while the heap is in use.
+    const auto half = std::size(region_bc) / 2U;
+    REQUIRE(heap->addRegion(region_bc.data(), half));
+    REQUIRE(heap->addRegion(region_bc.data() + half, half));
+    REQUIRE(heap->getDiagnostics().capacity == 8192U);
+    auto* const c = heap->allocate(fitAmount(200U, 256U));
+    REQUIRE(c != nullptr);
+    auto* const d = heap->allocate(fitAmount(700U, 1024U));
+    REQUIRE(d != nullptr);
+    if (Probing)  // The remainder of the region of c is in the floor bin of d and fits it exactly.
+    {
+        heap->matchFragments({{O, 1024}}, 2U);
+        heap->matchFragments({{X, 256}, {X, 768}}, 3U);
+    }
+    else
+    {
+        heap->matchFragments({{X, 1024}}, 2U);  // The most recently added region is the first in the bin.
+        heap->matchFragments({{X, 256}, {O, 768}}, 3U);
+    }
+    heap->free(a);
+    heap->free(b);
+    heap->free(d);
+    heap->free(c);
+
+    // The fragments are never merged across the region boundaries.
+    heap->matchFragments({{O, 4096}}, 0U);
+    heap->matchFragments({{O, 2048}}, 1U);
+    heap->matchFragments({{O, 1024}}, 2U);
+    heap->matchFragments({{O, 1024}}, 3U);
+    REQUIRE(heap->getDiagnostics().allocated == 0U);
+    REQUIRE(heap->allocate(4096U) == nullptr);  // Larger than any region.
+    REQUIRE(heap->doInvariantsHold());
+}
+
+TEST_CASE("General: child heaps")
+{
+    using internal::Fragment;
+
+    alignas(128U) std::array<std::byte, 65536U + sizeof(internal::O1HeapInstance) + O1HEAP_ALIGNMENT * 2U - 1U> arena{};
+    auto parent = init(arena.data(), std::size(arena));
+    REQUIRE(parent != nullptr);
+    const auto child_init = [&parent](const std::size_t size) {
+        return reinterpret_cast<internal::O1HeapInstance*>(
+            o1heapChildInit(reinterpret_cast<::O1HeapInstance*>(parent), size));
+    };
+    const auto grow = [](internal::O1HeapInstance* const child, const std::size_t size) {
+        return o1heapChildGrow(reinterpret_cast<::O1HeapInstance*>(child), size);
+    };
+    const auto destroy = [](internal::O1HeapInstance* const child) {
+        o1heapChildDestroy(reinterpret_cast<::O1HeapInstance*>(child));
+    };
+
+    // A failed child initialization does not leak the block.
+    REQUIRE(child_init(sizeof(internal::O1HeapInstance)) == nullptr);
+    REQUIRE(child_init(1U << 20U) == nullptr);
+    REQUIRE(parent->diagnostics.allocated == 0U);
+    REQUIRE(parent->diagnostics.oom_count == 1U);
+    REQUIRE(!grow(parent, 1024U));  // Not a child.
+
+    // The child heap occupies a single fragment of the parent.
+    auto* const child = child_init(4096U + sizeof(internal::O1HeapInstance));
+    REQUIRE(child != nullptr);
+    REQUIRE(child->parent == parent);
+    REQUIRE(Fragment::constructFromAllocatedMemory(child).getSize() == parent->diagnostics.allocated);
+    REQUIRE(child->diagnostics.capacity >= (4096U - (O1HEAP_ALIGNMENT * 2U)));
+    REQUIRE(!child->addRegion(arena.data() + (std::size(arena) / 2U), 1024U));  // Only the parent blocks are allowed.
+
+    // The child grows by chaining further parent blocks.
+    std::vector<void*> pointers;
+    std::size_t        blocks = 1U;
+    while (pointers.size() < 300U)
+    {
+        auto* const p = child->allocate(Fragment::SizeMin - O1HEAP_ALIGNMENT);
+        if (p == nullptr)
+        {
+            REQUIRE(grow(child, 4096U));
+            blocks++;
+        }
+        else
+        {
+            pointers.push_back(p);
+        }
+    }
+    REQUIRE(child->getRegionFirstFragments().size() == blocks);
+    REQUIRE(blocks > 2U);
+    REQUIRE(child->diagnostics.allocated == (pointers.size() * Fragment::SizeMin));
+    REQUIRE(child->doInvariantsHold());
+
+    // A nested child is released along with its parent.
+    REQUIRE(grow(child, 8192U));
+    auto* const grandchild = reinterpret_cast<internal::O1HeapInstance*>(
+        o1heapChildInit(reinterpret_cast<::O1HeapInstance*>(child), 1024U + sizeof(internal::O1HeapInstance)));
+    REQUIRE(grandchild != nullptr);
+    REQUIRE(grandchild->parent == child);
+    REQUIRE(grandchild->allocate(100U) != nullptr);
+
+    // A growth request that the parent cannot serve leaves the parent unchanged.
+    const auto before = parent->diagnostics.allocated;
+    REQUIRE(!grow(child, 65536U));
+    REQUIRE(parent->diagnostics.allocated == before);
+
+    // The destruction returns every block to the parent without visiting the allocations.
+    destroy(child);
+    REQUIRE(parent->diagnostics.allocated == 0U);
+    parent->matchFragments({{false, parent->diagnostics.capacity}});
+    REQUIRE(parent->doInvariantsHold());
+}
+
+TEST_CASE("General: add region: capacity limit")
+{
+    using internal::Fragment;
+
+    alignas(128U) std::array<std::byte, 4096U + sizeof(internal::O1HeapInstance) + O1HEAP_ALIGNMENT * 2U - 1U> arena{};
+    alignas(128U) std::array<std::byte, 1024U> region{};
+    auto heap = init(arena.data(), std::size(arena));
+    REQUIRE(heap != nullptr);
+
+    // The region is never used for allocation here because its declared size is fictitious.
+    // Only the region header and the root fragment header are written.
+    REQUIRE(heap->addRegion(region.data(), std::numeric_limits<std::size_t>::max()));
+    REQUIRE(heap->getDiagnostics().capacity == Fragment::SizeMax);
+    REQUIRE(heap->getRegionFirstFragments().at(1U)->getSize() == Fragment::SizeMax - 4096U);
+    REQUIRE(!heap->addRegion(region.data() + 512U, 512U));  // No capacity left.
+    REQUIRE(heap->doInvariantsHold());
+}
+
+TEST_CASE("General: compact headers")
+{
+    using internal::Fragment;
+    static_assert((O1HEAP_COMPACT_HEADERS == 0) || (O1HEAP_ALIGNMENT == 16U));
+    static_assert(sizeof(internal::FragmentHeader) <= O1HEAP_ALIGNMENT);
+    static_assert(sizeof(Fragment) <= Fragment::SizeMin);
+
+    alignas(128U) std::array<std::byte, 4096U + sizeof(internal::O1HeapInstance) + O1HEAP_ALIGNMENT * 2U - 1U> arena{};
+    auto heap = init(arena.data(), std::size(arena));
+    REQUIRE(heap != nullptr);
+    REQUIRE(heap->diagnostics.capacity == 4096U);
+
+    // The number of the smallest objects that fit into the heap is defined by the header format.
+    std::vector<void*> pointers;
+    for (auto* p = heap->allocate(O1HEAP_ALIGNMENT); p != nullptr; p = heap->allocate(O1HEAP_ALIGNMENT))
+    {
+        REQUIRE(Fragment::constructFromAllocatedMemory(p).getSize() == Fragment::SizeMin);
+        pointers.push_back(p);
+    }
+    REQUIRE(pointers.size() == (4096U / Fragment::SizeMin));
+    if (O1HEAP_COMPACT_HEADERS != 0)
+    {
+        REQUIRE(pointers.size() == 128U);
+        REQUIRE(Fragment::SizeMax == 2147483648ULL);
+    }
+    for (auto* const p : pointers)
+    {
+        heap->free(p);
+    }
+    heap->matchFragments({{false, 4096U}});
+    REQUIRE(heap->doInvariantsHold());
+}
+
+TEST_CASE("General: allocate zeroed")
+{
+    using internal::Fragment;
+
+    constexpr auto X = true;   // used
+    constexpr auto O = false;  // free
+
+    const auto is_zero = [](const void* const p, const std::size_t amount, const std::size_t except = SIZE_MAX) {
+        const auto* const bytes = static_cast<const std::byte*>(p);
+        for (std::size_t i = 0U; i < amount; i++)
+        {
+            if ((i != except) && (bytes[i] != std::byte{0}))
+            {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    // The arena alignment is fixed to make the placement of the aligned allocation below deterministic.
+    alignas(4096U) std::array<std::byte, 4096U + sizeof(internal::O1HeapInstance) + O1HEAP_ALIGNMENT * 2U - 1U> arena{};
+    auto heap = reinterpret_cast<internal::O1HeapInstance*>(o1heapInitZeroed(arena.data(), std::size(arena)));
+    REQUIRE(heap != nullptr);
+    heap->matchFragments({{O, 4096}});
+    REQUIRE(heap->getFirstFragment()->isZeroed());
+    REQUIRE(nullptr == heap->allocateZeroed(0U));
+
+    // Poke a byte into the free memory past the free list links to observe that known-zero memory is not cleared.
+    constexpr std::size_t poke_offset = 40U;
+    auto* const           root        = const_cast<Fragment*>(heap->getFirstFragment());
+    static_assert(O1HEAP_ALIGNMENT + poke_offset >= sizeof(Fragment));
+    reinterpret_cast<std::byte*>(root)[O1HEAP_ALIGNMENT + poke_offset] = std::byte{0xAA};
+
+    auto* a = static_cast<std::byte*>(heap->allocateZeroed(200U));
+    REQUIRE(a != nullptr);
+    REQUIRE(a[poke_offset] == std::byte{0xAA});
+    REQUIRE(is_zero(a, 200U, poke_offset));
+    heap->matchFragments({{X, 256}, {O, 3840}});
+    REQUIRE(Fragment::constructFromAllocatedMemory(a).getNext()->isZeroed());  // Inherited after the split.
+
+    // The leading slack of an aligned allocation is still known to be zero-filled.
+    // The placement of the free fragment depends on the size of the heap instance, which varies between the build
+    // configurations. If the fragment happens to be aligned already, there would be no slack, so it is offset.
+    void* const filler =
+        (((reinterpret_cast<std::uintptr_t>(a) + 256U) % 1024U) == 0U) ? heap->allocateZeroed(1U) : nullptr;
+    void* const b = heap->allocateAligned(1024U, 32U);
+    REQUIRE(b != nullptr);
+    REQUIRE(Fragment::constructFromAllocatedMemory(b).getPrev() != nullptr);
+    REQUIRE(!Fragment::constructFromAllocatedMemory(b).getPrev()->isUsed());
+    REQUIRE(Fragment::constructFromAllocatedMemory(b).getPrev()->isZeroed());
+    REQUIRE(Fragment::constructFromAllocatedMemory(b).getNext()->isZeroed());
+    heap->free(b);
+    heap->free(filler);
+
+    // Freed memory is dirty, so it has to be cleared.
+    std::fill_n(a, 100U, std::byte{0x55});
+    heap->free(a);
+    heap->matchFragments({{O, 4096}});
+    REQUIRE(!heap->getFirstFragment()->isZeroed());
+    a = static_cast<std::byte*>(heap->allocateZeroed(200U));
+    REQUIRE(a != nullptr);
+    REQUIRE(is_zero(a, 200U));
+    heap->matchFragments({{X, 256}, {O, 3840}});
+    REQUIRE(!Fragment::constructFromAllocatedMemory(a).getNext()->isZeroed());
+    heap->free(a);
+
+    // Ordinary initialization does not make any assumptions about the arena.
+    std::fill(std::begin(arena), std::end(arena), std::byte{0x55});
+    heap = init(arena.data(), std::size(arena));
+    REQUIRE(heap != nullptr);
+    REQUIRE(!heap->getFirstFragment()->isZeroed());
+    a = static_cast<std::byte*>(heap->allocateZeroed(fitAmount(900U, 1024U)));
+    REQUIRE(a != nullptr);
+    REQUIRE(is_zero(a, fitAmount(900U, 1024U)));
+    REQUIRE(heap->getDiagnostics().allocated == 1024U);
+    REQUIRE(heap->doInvariantsHold());
+}
+
+TEST_CASE("General: allocate aligned")
+{
+    using internal::Fragment;
+
+    alignas(4096U) std::array<std::byte, 4096U + sizeof(internal::O1HeapInstance) + O1HEAP_ALIGNMENT * 2U - 1U> arena{};
+    auto heap = init(arena.data(), std::size(arena));
+    REQUIRE(heap != nullptr);
+    REQUIRE(heap->diagnostics.capacity == 4096U);
+
+    constexpr auto X = true;   // used
+    constexpr auto O = false;  // free
+
+    // Invalid alignments are rejected without affecting the diagnostics.
+    REQUIRE(nullptr == heap->allocateAligned(0U, 32U));
+    REQUIRE(nullptr == heap->allocateAligned(3U, 32U));
+    REQUIRE(nullptr == heap->allocateAligned(Fragment::SizeMin + O1HEAP_ALIGNMENT, 32U));
+    REQUIRE(heap->getDiagnostics().oom_count == 0U);
+    REQUIRE(heap->getDiagnostics().peak_request_size == 0U);
+
+    // Small alignments are always satisfied because the memory is always aligned at the min fragment size.
+    for (std::size_t alignment = 1U; alignment <= Fragment::SizeMin; alignment *= 2U)
+    {
+        void* const p = heap->allocateAligned(alignment, 32U);
+        REQUIRE(p != nullptr);
+        REQUIRE((reinterpret_cast<std::size_t>(p) % Fragment::SizeMin) == 0U);
+        heap->matchFragments({{X, 64}, {O, 4032}});
+        heap->free(p);
+    }
+
+    // The misaligned slack is returned to the heap as a free fragment.
+    const auto base = reinterpret_cast<std::size_t>(heap->getFirstFragment()) + O1HEAP_ALIGNMENT;
+    REQUIRE((base % Fragment::SizeMin) == 0U);
+    const std::size_t slack = (1024U - (base % 1024U)) % 1024U;
+    void* const       a     = heap->allocateAligned(1024U, 200U);
+    REQUIRE(a != nullptr);
+    REQUIRE((reinterpret_cast<std::size_t>(a) % 1024U) == 0U);
+    REQUIRE((reinterpret_cast<std::size_t>(a) - base) == slack);
+    if (slack > 0U)
+    {
+        heap->matchFragments({{O, slack}, {X, 256}, {O, 4096U - 256U - slack}});
+    }
+    else
+    {
+        heap->matchFragments({{X, 256}, {O, 3840}});
+    }
+    REQUIRE(heap->getDiagnostics().allocated == 256U);
+    REQUIRE(heap->getDiagnostics().peak_request_size == 200U);
+
+    // Does not fit because of the worst-case slack even though there may be enough space after the slack.
+    REQUIRE(nullptr == heap->allocateAligned(4096U, 32U));
+    REQUIRE(heap->getDiagnostics().oom_count == 1U);
+    REQUIRE(nullptr == heap->allocateAligned(1024U, 0U));
+    REQUIRE(heap->getDiagnostics().oom_count == 1U);
+
+    heap->free(a);
+    heap->matchFragments({{O, 4096}});
+    REQUIRE(heap->getDiagnostics().allocated == 0U);
+    REQUIRE(heap->doInvariantsHold());
+}
+
+TEST_CASE("General: allocate aligned: random")
+{
+    using internal::Fragment;
+
+    constexpr auto                   ArenaSize = MiB * 8U;
+    const std::shared_ptr<std::byte> arena(static_cast<std::byte*>(std::aligned_alloc(64U, ArenaSize)), &std::free);
+    auto                             heap = init(arena.get(), ArenaSize);
+    REQUIRE(heap != nullptr);
+
+    std::random_device                          random_device;
+    std::mt19937                                random_generator(random_device());
+    std::uniform_int_distribution<std::size_t>  dis_amount(1U, 10U * KiB);
+    std::uniform_int_distribution<std::uint8_t> dis_alignment(0U, 14U);
+
+    std::vector<void*> pointers;
+    for (auto i = 0U; i < 1000U; i++)
+    {
+        const std::size_t alignment = std::size_t{1} << dis_alignment(random_generator);
+        const std::size_t amount    = dis_amount(random_generator);
+        void* const       p         = heap->allocateAligned(alignment, amount);
+        if (p != nullptr)
+        {
+            REQUIRE((reinterpret_cast<std::size_t>(p) % alignment) == 0U);
+            REQUIRE(Fragment::constructFromAllocatedMemory(p).getSize() >= (amount + O1HEAP_ALIGNMENT));
+            std::generate_n(reinterpret_cast<std::byte*>(p), amount, getRandomByte);
+            pointers.push_back(p);
+        }
+        if ((i % 3U) == 0U)
+        {
+            std::shuffle(std::begin(pointers), std::end(pointers), random_generator);
+            heap->free(pointers.back());
+            pointers.pop_back();
+        }
+        REQUIRE(heap->doInvariantsHold());
+    }
+    for (void* const p : pointers)
+    {
+        heap->free(p);
+    }
+    heap->matchFragments({{false, heap->diagnostics.capacity}});
+    REQUIRE(heap->doInvariantsHold());
+}
+
+TEST_CASE("General: batch")
+{
+    using internal::Fragment;
+
+    alignas(128U) std::array<std::byte, 4096U + sizeof(internal::O1HeapInstance) + O1HEAP_ALIGNMENT * 2U - 1U> arena{};
+    auto heap = init(arena.data(), std::size(arena));
+    REQUIRE(heap != nullptr);
+
+    constexpr auto X = true;   // used
+    constexpr auto O = false;  // free
+
+    REQUIRE(heap->allocateBatch(0U, 10U).empty());
+    REQUIRE(heap->allocateBatch(32U, 0U).empty());
+    heap->freeBatch({});
+    heap->freeBatch({nullptr, nullptr});
+    REQUIRE(heap->getDiagnostics().oom_count == 0U);
+    REQUIRE(heap->getDiagnostics().peak_request_size == 0U);
+
+    // The entire batch is carved out of a single fragment.
+    auto a = heap->allocateBatch(32U, 6U);
+    REQUIRE(a.size() == 6U);
+    heap->matchFragments({{X, 64}, {X, 64}, {X, 64}, {X, 64}, {X, 64}, {X, 64}, {O, 3712}});
+    for (std::size_t i = 0U; i < a.size(); i++)
+    {
+        REQUIRE(Fragment::constructFromAllocatedMemory(a.at(i)).getSize() == 64U);
+        std::generate_n(reinterpret_cast<std::byte*>(a.at(i)), 32U, getRandomByte);
+    }
+    REQUIRE(heap->getDiagnostics().allocated == 384U);
+    REQUIRE(heap->getDiagnostics().peak_allocated == 384U);
+    REQUIRE(heap->getDiagnostics().peak_request_size == 32U);
+
+    // Free some items out of order; adjacent ones are merged.
+    heap->freeBatch({a.at(4), nullptr, a.at(1), a.at(2)});
+    heap->matchFragments({{X, 64}, {O, 128}, {X, 64}, {O, 64}, {X, 64}, {O, 3712}});
+    REQUIRE(heap->getDiagnostics().allocated == 192U);
+
+    // The fragments fill the gaps between the free fragments and merge with them on both sides.
+    heap->freeBatch({a.at(5), a.at(3), a.at(0)});
+    heap->matchFragments({{O, 4096}});
+    REQUIRE(heap->getDiagnostics().allocated == 0U);
+
+    // The batch consumes an entire fragment, leaving no leftover.
+    a = heap->allocateBatch(fitAmount(2000U, 2048U), 2U);
+    REQUIRE(a.size() == 2U);
+    heap->matchFragments({{X, 2048}, {X, 2048}});
+    REQUIRE(heap->getDiagnostics().peak_allocated == 4096U);
+    heap->freeBatch({a.at(1), a.at(0)});
+    heap->matchFragments({{O, 4096}});
+
+    // Fragmented heap: no single fragment can accommodate the batch, so the items are allocated one by one.
+    auto b = heap->allocateBatch(fitAmount(900U, 1024U), 4U);
+    REQUIRE(b.size() == 4U);
+    heap->matchFragments({{X, 1024}, {X, 1024}, {X, 1024}, {X, 1024}});
+    heap->freeBatch({b.at(0), b.at(2)});
+    heap->matchFragments({{O, 1024}, {X, 1024}, {O, 1024}, {X, 1024}});
+    a = heap->allocateBatch(200U, 6U);
+    REQUIRE(a.size() == 6U);
+    heap->matchFragments({{X, 256}, {X, 256}, {O, 512}, {X, 1024}, {X, 256}, {X, 256}, {X, 256}, {X, 256}, {X, 1024}});
+    REQUIRE(heap->getDiagnostics().oom_count == 0U);
+
+    // Partial allocation; the OOM is registered once.
+    auto c = heap->allocateBatch(200U, 3U);
+    REQUIRE(c.size() == 2U);
+    REQUIRE(heap->getDiagnostics().oom_count == 1U);
+    heap->matchFragments({{X, 256},
+                          {X, 256},
+                          {X, 256},
+                          {X, 256},
+                          {X, 1024},
+                          {X, 256},
+                          {X, 256},
+                          {X, 256},
+                          {X, 256},
+                          {X, 1024}});
+
+    // Release everything in one go.
+    std::vector<void*> all;
+    all.insert(std::end(all), std::begin(c), std::end(c));
+    all.push_back(b.at(3));
+    all.insert(std::end(all), std::begin(a), std::end(a));
+    all.push_back(b.at(1));
+    heap->freeBatch(all);
+    heap->matchFragments({{O, 4096}});
+    REQUIRE(heap->getDiagnostics().allocated == 0U);
+    REQUIRE(heap->doInvariantsHold());
+}
+
+TEST_CASE("General: batch: random")
+{
+    constexpr auto                   ArenaSize = MiB * 8U;
+    const std::shared_ptr<std::byte> arena(static_cast<std::byte*>(std::aligned_alloc(64U, ArenaSize)), &std::free);
+    auto                             heap = init(arena.get(), ArenaSize);
+    REQUIRE(heap != nullptr);
+
+    std::random_device                         random_device;
+    std::mt19937                               random_generator(random_device());
+    std::uniform_int_distribution<std::size_t> dis_amount(0U, 4U * KiB);
+    std::uniform_int_distribution<std::size_t> dis_count(0U, 64U);
+
+    std::vector<void*> pointers;
+    for (auto i = 0U; i < 300U; i++)
+    {
+        const auto batch = heap->allocateBatch(dis_amount(random_generator), dis_count(random_generator));
+        pointers.insert(std::end(pointers), std::begin(batch), std::end(batch));
+        std::shuffle(std::begin(pointers), std::end(pointers), random_generator);
+        const auto         num = std::min(pointers.size(), dis_count(random_generator));
+        std::vector<void*> release(std::end(pointers) - static_cast<std::ptrdiff_t>(num), std::end(pointers));
+        pointers.resize(pointers.size() - num);
+        release.push_back(nullptr);
+        heap->freeBatch(release);
+        REQUIRE(heap->doInvariantsHold());
+    }
+    heap->freeBatch(pointers);
+    heap->matchFragments({{false, heap->diagnostics.capacity}});
+    REQUIRE(heap->doInvariantsHold());
+}
+
+TEST_CASE("General: reallocate")
+{
+    using internal::Fragment;
+
+    alignas(128U) std::array<std::byte, 4096U + sizeof(internal::O1HeapInstance) + O1HEAP_ALIGNMENT * 2U - 1U> arena{};
+    auto heap = init(arena.data(), std::size(arena));
+    REQUIRE(heap != nullptr);
+
+    constexpr auto X = true;   // used
+    constexpr auto O = false;  // free
+
+    const auto fill = [](void* const p, const std::size_t amount, const std::uint8_t seed) {
+        for (std::size_t i = 0U; i < amount; i++)
+        {
+            static_cast<std::uint8_t*>(p)[i] = static_cast<std::uint8_t>(seed + i);
+        }
+    };
+    const auto check = [](const void* const p, const std::size_t amount, const std::uint8_t seed) {
+        for (std::size_t i = 0U; i < amount; i++)
+        {
+            REQUIRE(static_cast<const std::uint8_t*>(p)[i] == static_cast<std::uint8_t>(seed + i));
+        }
+    };
+
+    // Reallocating NULL is an allocation.
+    auto a = heap->reallocate(nullptr, 32U);
+    REQUIRE(a != nullptr);
+    fill(a, 32U, 1U);
+    heap->matchFragments({{X, 64}, {O, 4032}});
+
+    // Grow into the free right neighbor.
+    REQUIRE(a == heap->reallocate(a, 200U));
+    check(a, 32U, 1U);
+    fill(a, 100U, 2U);
+    heap->matchFragments({{X, 256}, {O, 3840}});
+    REQUIRE(heap->getDiagnostics().realloc_grow_count == 1U);
+    REQUIRE(heap->getDiagnostics().allocated == 256U);
+    REQUIRE(heap->getDiagnostics().peak_allocated == 256U);
+    REQUIRE(heap->getDiagnostics().peak_request_size == 200U);
+
+    // Shrink; the tail is merged with the free right neighbor.
+    REQUIRE(a == heap->reallocate(a, 20U));
+    check(a, 10U, 2U);
+    heap->matchFragments({{X, 64}, {O, 4032}});
+    REQUIRE(heap->getDiagnostics().realloc_shrink_count == 1U);
+    REQUIRE(heap->getDiagnostics().allocated == 64U);
+    REQUIRE(heap->getDiagnostics().peak_allocated == 256U);
+
+    // Same fragment size -- nothing to do.
+    REQUIRE(a == heap->reallocate(a, 30U));
+    check(a, 10U, 2U);
+    heap->matchFragments({{X, 64}, {O, 4032}});
+    REQUIRE(heap->getDiagnostics().realloc_shrink_count == 2U);
+
+    // The right neighbor is used, so the data has to be moved.
+    auto b = heap->allocate(32U);
+    REQUIRE(b != nullptr);
+    heap->matchFragments({{X, 64}, {X, 64}, {O, 3968}});
+    fill(a, 32U, 3U);
+    auto a2 = heap->reallocate(a, 200U);
+    REQUIRE(a2 != nullptr);
+    REQUIRE(a2 != a);
+    check(a2, 32U, 3U);
+    heap->matchFragments({{O, 64}, {X, 64}, {X, 256}, {O, 3712}});
+    REQUIRE(heap->getDiagnostics().realloc_move_count == 1U);
+    REQUIRE(heap->getDiagnostics().allocated == 320U);
+
+    // Out of memory -- the old fragment is left intact.
+    fill(a2, 100U, 4U);
+    REQUIRE(nullptr == heap->reallocate(a2, 4000U));
+    REQUIRE(nullptr == heap->reallocate(a2, std::numeric_limits<std::size_t>::max()));
+    check(a2, 100U, 4U);
+    heap->matchFragments({{O, 64}, {X, 64}, {X, 256}, {O, 3712}});
+    REQUIRE(heap->getDiagnostics().oom_count == 2U);
+    REQUIRE(heap->getDiagnostics().realloc_move_count == 1U);
+
+    // Shrink with a used right neighbor; the tail becomes a new free fragment.
+    auto c = heap->allocate(32U);
+    REQUIRE(c != nullptr);
+    heap->matchFragments({{X, 64}, {X, 64}, {X, 256}, {O, 3712}});
+    auto d = heap->allocate(32U);
+    REQUIRE(d != nullptr);
+    heap->matchFragments({{X, 64}, {X, 64}, {X, 256}, {X, 64}, {O, 3648}});
+    REQUIRE(a2 == heap->reallocate(a2, 20U));
+    check(a2, 1U, 4U);
+    heap->matchFragments({{X, 64}, {X, 64}, {X, 64}, {O, 192}, {X, 64}, {O, 3648}});
+    REQUIRE(heap->getDiagnostics().realloc_shrink_count == 3U);
+
+    // Grow into a free neighbor that is consumed entirely.
+    REQUIRE(a2 == heap->reallocate(a2, 200U));
+    heap->matchFragments({{X, 64}, {X, 64}, {X, 256}, {X, 64}, {O, 3648}});
+    REQUIRE(heap->getDiagnostics().realloc_grow_count == 2U);
+
+    // Zero amount is a deallocation.
+    REQUIRE(nullptr == heap->reallocate(a2, 0U));
+    heap->matchFragments({{X, 64}, {X, 64}, {O, 256}, {X, 64}, {O, 3648}});
+    heap->free(b);
+    heap->free(c);
+    heap->free(d);
+    heap->matchFragments({{O, 4096}});
+    REQUIRE(heap->getDiagnostics().allocated == 0U);
+    REQUIRE(heap->getDiagnostics().realloc_shrink_count == 3U);
+    REQUIRE(heap->getDiagnostics().realloc_grow_count == 2U);
+    REQUIRE(heap->getDiagnostics().realloc_move_count == 1U);
+    REQUIRE(heap->doInvariantsHold());
+}
+
+/// This test has been empirically tuned to expand its state space coverage.
+/// If any new behaviors need to be tested, please consider writing another test instead of changing this one.
+TEST_CASE("General: cache")
+{
+    using internal::Fragment;
+    constexpr auto SizeMin = O1HEAP_ALIGNMENT * 2U;
+
+    alignas(128U) std::array<std::byte, 4096U + sizeof(internal::O1HeapInstance) + O1HEAP_ALIGNMENT * 2U - 1U> arena{};
+    auto heap = init(arena.data(), std::size(arena));
+    REQUIRE(heap != nullptr);
+    auto* const h = reinterpret_cast<::O1HeapInstance*>(heap);
+
+    const auto frag_size = [](void* const p) { return Fragment::constructFromAllocatedMemory(p).getSize(); };
+
+    REQUIRE(o1heapCacheInit(h, 0U, 4U) == nullptr);
+    REQUIRE(o1heapCacheInit(h, 100U, 0U) == nullptr);
+    REQUIRE(o1heapCacheInit(h, 4096U, 4U) == nullptr);
+    REQUIRE(o1heapCacheInit(h, 1000U, 4096U) == nullptr);
+    REQUIRE(heap->getDiagnostics().allocated == 0U);
+
+    // Two size classes: SizeMin and SizeMin*2.
+    auto* const cache = o1heapCacheInit(h, O1HEAP_ALIGNMENT * 3U - 1U, 4U);
+    REQUIRE(cache != nullptr);
+    REQUIRE(heap->doInvariantsHold());
+    const auto base = heap->getDiagnostics().allocated;
+    REQUIRE(base > 0U);
+
+    // The cache is empty; the uncacheable amounts are never served from the cache.
+    REQUIRE(o1heapCacheAllocate(cache, 1U) == nullptr);
+    REQUIRE(o1heapCacheAllocate(cache, 0U) == nullptr);
+    REQUIRE(o1heapCacheAllocate(cache, O1HEAP_ALIGNMENT * 3U + 1U) == nullptr);
+    REQUIRE(o1heapCacheRefill(cache, 0U) == nullptr);
+
+    // The refill allocates half of the depth, one fragment is returned immediately.
+    auto* const p = o1heapCacheRefill(cache, 1U);
+    REQUIRE(p != nullptr);
+    REQUIRE(frag_size(p) == SizeMin);
+    REQUIRE(heap->getDiagnostics().allocated == base + SizeMin * 2U);
+    auto* const q = o1heapCacheAllocate(cache, O1HEAP_ALIGNMENT);
+    REQUIRE(q != nullptr);
+    REQUIRE(q != p);
+    REQUIRE(frag_size(q) == SizeMin);
+    REQUIRE(o1heapCacheAllocate(cache, 1U) == nullptr);
+    REQUIRE(heap->getDiagnostics().allocated == base + SizeMin * 2U);
+
+    // The larger class is independent. The fragments are of the full class size.
+    auto* const r = o1heapCacheRefill(cache, O1HEAP_ALIGNMENT * 2U);
+    REQUIRE(r != nullptr);
+    REQUIRE(frag_size(r) == SizeMin * 2U);
+    REQUIRE(heap->getDiagnostics().allocated == base + SizeMin * 6U);
+    REQUIRE(o1heapCacheAllocate(cache, 1U) == nullptr);
+    auto* const r2 = o1heapCacheAllocate(cache, O1HEAP_ALIGNMENT * 3U - 1U);
+    REQUIRE(r2 != nullptr);
+    REQUIRE(o1heapCacheFree(cache, r));
+    REQUIRE(o1heapCacheFree(cache, r2));
+    REQUIRE(o1heapCacheFree(cache, nullptr));
+
+    // The freed fragments are kept by the cache and reused in the LIFO order.
+    REQUIRE(o1heapCacheFree(cache, p));
+    REQUIRE(o1heapCacheFree(cache, q));
+    REQUIRE(o1heapCacheAllocate(cache, 1U) == q);
+    REQUIRE(o1heapCacheFree(cache, q));
+    REQUIRE(heap->getDiagnostics().allocated == base + SizeMin * 6U);
+
+    // Fragments allocated directly from the heap can be cached, too. Overflow the cache.
+    std::array<void*, 3> v{};
+    for (auto& x : v)
+    {
+        x = heap->allocate(1U);
+        REQUIRE(x != nullptr);
+    }
+    REQUIRE(heap->getDiagnostics().allocated == base + SizeMin * 9U);
+    REQUIRE(o1heapCacheFree(cache, v.at(0)));
+    REQUIRE(o1heapCacheFree(cache, v.at(1)));
+    REQUIRE(!o1heapCacheFree(cache, v.at(2)));  // Full.
+    o1heapCacheFlush(cache, v.at(2));           // The oldest two are released: p, q.
+    REQUIRE(heap->doInvariantsHold());
+    REQUIRE(heap->getDiagnostics().allocated == base + SizeMin * 7U);
+    REQUIRE(o1heapCacheAllocate(cache, 1U) == v.at(2));
+    REQUIRE(o1heapCacheAllocate(cache, 1U) == v.at(1));
+    REQUIRE(o1heapCacheAllocate(cache, 1U) == v.at(0));
+    REQUIRE(o1heapCacheAllocate(cache, 1U) == nullptr);
+    o1heapCacheFlush(cache, v.at(0));  // Not full, so nothing is released.
+    REQUIRE(heap->getDiagnostics().allocated == base + SizeMin * 7U);
+    REQUIRE(o1heapCacheAllocate(cache, 1U) == v.at(0));
+
+    // Uncacheable fragments go straight to the heap.
+    auto* const big = o1heapCacheRefill(cache, 200U);
+    REQUIRE(big != nullptr);
+    REQUIRE(heap->getDiagnostics().allocated == base + SizeMin * 7U + frag_size(big));
+    REQUIRE(!o1heapCacheFree(cache, big));
+    o1heapCacheFlush(cache, big);
+    o1heapCacheFlush(cache, nullptr);
+    REQUIRE(heap->getDiagnostics().allocated == base + SizeMin * 7U);
+
+    // A cache of depth one.
+    auto* const tiny = o1heapCacheInit(h, 1U, 1U);
+    REQUIRE(tiny != nullptr);
+    const auto base_tiny = heap->getDiagnostics().allocated;
+    auto* const t        = o1heapCacheRefill(tiny, 1U);
+    REQUIRE(t != nullptr);
+    REQUIRE(o1heapCacheAllocate(tiny, 1U) == nullptr);
+    REQUIRE(o1heapCacheFree(tiny, t));
+    REQUIRE(!o1heapCacheFree(tiny, v.at(0)));
+    o1heapCacheFlush(tiny, v.at(0));
+    REQUIRE(heap->getDiagnostics().allocated == base_tiny);
+    REQUIRE(o1heapCacheAllocate(tiny, 1U) == v.at(0));
+    o1heapCacheFlush(tiny, v.at(0));
+    o1heapCacheDestroy(tiny);
+    REQUIRE(heap->getDiagnostics().allocated == base + SizeMin * 6U);
+
+    // Tagged memory bypasses the cache, so the fragments handed out by the cache are never charged to another tag.
+    static_assert(O1HEAP_TAG_COUNT >= 3U, "The test requires several tags");
+    const auto tag_diagnostics = [h](const std::uint8_t tag) { return o1heapGetTagDiagnostics(h, tag).allocated; };
+    auto* const tagged_a = o1heapAllocateTagged(h, 1U, 1U);
+    auto* const untagged = o1heapCacheRefill(cache, 1U);
+    auto* const tagged_b = o1heapAllocateTagged(h, O1HEAP_ALIGNMENT * 2U, 2U);
+    REQUIRE(tagged_a != nullptr);
+    REQUIRE(untagged != nullptr);
+    REQUIRE(tagged_b != nullptr);
+    REQUIRE(tag_diagnostics(1U) == SizeMin);
+    REQUIRE(tag_diagnostics(2U) == SizeMin * 2U);
+    REQUIRE(!o1heapCacheFree(cache, tagged_a));
+    o1heapCacheFlush(cache, tagged_a);
+    REQUIRE(o1heapCacheFree(cache, untagged));
+    o1heapCacheFlush(cache, tagged_b);
+    REQUIRE(tag_diagnostics(1U) == 0U);
+    REQUIRE(tag_diagnostics(2U) == 0U);
+    REQUIRE(tag_diagnostics(0U) == heap->getDiagnostics().allocated);
+    std::vector<void*> reused;
+    while (auto* const x = o1heapCacheAllocate(cache, 1U))
+    {
+        REQUIRE(x != tagged_a);
+        REQUIRE(o1heapGetTag(h, x) == 0U);
+        reused.push_back(x);
+    }
+    REQUIRE(!reused.empty());
+    for (auto* const x : reused)
+    {
+        REQUIRE(o1heapCacheFree(cache, x));
+    }
+    REQUIRE(tag_diagnostics(0U) == heap->getDiagnostics().allocated);
+    REQUIRE(heap->doInvariantsHold());
+
+    // Exhaust the heap through the cache.
+    const auto         oom_count = heap->getDiagnostics().oom_count;
+    std::vector<void*> taken;
+    while (auto* const x = o1heapCacheRefill(cache, O1HEAP_ALIGNMENT * 3U))
+    {
+        REQUIRE(frag_size(x) == SizeMin * 2U);
+        taken.push_back(x);
+    }
+    REQUIRE(taken.size() > 2U);
+    REQUIRE(heap->getDiagnostics().oom_count > oom_count);
+    REQUIRE(heap->doInvariantsHold());
+
+    // The cache releases everything it holds; the memory that was taken out of the cache is not affected.
+    o1heapCacheDestroy(cache);
+    REQUIRE(heap->getDiagnostics().allocated == (SizeMin * 2U * taken.size()) + (SizeMin * 2U));
+    heap->freeBatch(taken);
+    heap->free(v.at(1));
+    heap->free(v.at(2));
+    heap->matchFragments({{false, heap->diagnostics.capacity}});
+}
+
+TEST_CASE("General: cache: threads")
+{
+    constexpr auto                   ArenaSize = MiB * 8U;
+    const std::shared_ptr<std::byte> arena(static_cast<std::byte*>(std::aligned_alloc(64U, ArenaSize)), &std::free);
+    auto                             heap = init(arena.get(), ArenaSize);
+    REQUIRE(heap != nullptr);
+    auto* const h = reinterpret_cast<::O1HeapInstance*>(heap);
+
+    std::mutex lock;
+    const auto worker = [h, &lock](const std::uint32_t seed) {
+        std::unique_lock<std::mutex> guard(lock);
+        auto* const                  cache = o1heapCacheInit(h, 1000U, 16U);
+        guard.unlock();
+        if (cache == nullptr)
+        {
+            return false;
+        }
+        std::mt19937                                    random_generator(seed);
+        std::uniform_int_distribution<std::size_t>      dis_amount(1U, 2000U);
+        std::vector<std::pair<std::byte*, std::size_t>> pointers;
+        bool                                            ok      = true;
+        const auto                                      pattern = static_cast<std::byte>(seed);
+        for (auto i = 0U; i < 20'000U; i++)
+        {
+            if ((pointers.size() < 64U) && ((random_generator() % 2U) == 0U))
+            {
+                const auto amount = dis_amount(random_generator);
+                void*      p      = o1heapCacheAllocate(cache, amount);
+                if (p == nullptr)
+                {
+                    guard.lock();
+                    p = o1heapCacheRefill(cache, amount);
+                    guard.unlock();
+                }
+                if (p != nullptr)
+                {
+                    std::fill_n(static_cast<std::byte*>(p), amount, pattern);
+                    pointers.emplace_back(static_cast<std::byte*>(p), amount);
+                }
+            }
+            else if (!pointers.empty())
+            {
+                const auto [p, amount] = pointers.back();
+                pointers.pop_back();
+                ok = ok && std::all_of(p, p + amount, [pattern](const std::byte x) { return x == pattern; });
+                if (!o1heapCacheFree(cache, p))
+                {
+                    guard.lock();
+                    o1heapCacheFlush(cache, p);
+                    guard.unlock();
+                }
+            }
+        }
+        guard.lock();
+        for (const auto& [p, amount] : pointers)
+        {
+            o1heapCacheFlush(cache, p);
+        }
+        o1heapCacheDestroy(cache);
+        return ok;
+    };
+
+    std::array<bool, 4>      results{};
+    std::vector<std::thread> threads;
+    for (std::uint32_t i = 0U; i < results.size(); i++)
+    {
+        threads.emplace_back([&results, &worker, i]() { results.at(i) = worker(i + 1U); });
+    }
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+    REQUIRE(std::all_of(std::begin(results), std::end(results), [](const bool x) { return x; }));
+    REQUIRE(heap->doInvariantsHold());
+    REQUIRE(heap->getDiagnostics().allocated == 0U);
+    heap->matchFragments({{false, heap->diagnostics.capacity}});
+}
+
+TEST_CASE("General: slab")
+{
+    using internal::Fragment;
+    using internal::SlabHeaderSizePadded;
+    constexpr std::size_t SlabSize = 512U;
+    constexpr std::size_t Slots8   = (SlabSize - O1HEAP_ALIGNMENT - SlabHeaderSizePadded) / 8U;
+    constexpr std::size_t Slots48  = (SlabSize - O1HEAP_ALIGNMENT - SlabHeaderSizePadded) / 48U;
+
+#if O1HEAP_SUBBIN_BITS == 0
+    constexpr std::size_t HeapSize = 4096U;
+#else
+    // The sub-bins do not guarantee that a fragment from the bin of the slab size can fit an aligned slab,
+    // so the heap is made large enough for the aligned slab requests to succeed regardless of the arena placement.
+    constexpr std::size_t HeapSize = 8192U;
+#endif
+    alignas(128U) std::array<std::byte, HeapSize + sizeof(internal::O1HeapInstance) + O1HEAP_ALIGNMENT * 2U - 1U> arena{};
+    auto heap = init(arena.data(), std::size(arena));
+    REQUIRE(heap != nullptr);
+    auto* const h = reinterpret_cast<::O1HeapInstance*>(heap);
+
+    REQUIRE(o1heapSlabInit(h, 0U) == nullptr);
+    REQUIRE(o1heapSlabInit(h, 500U) == nullptr);           // Not a power of 2.
+    REQUIRE(o1heapSlabInit(h, 64U) == nullptr);            // No room for the largest slot.
+    REQUIRE(o1heapSlabInit(h, HeapSize * 2U) == nullptr);  // Larger than the heap.
+    REQUIRE(o1heapSlabInit(h, 131072U) == nullptr);        // Larger than the limit.
+    REQUIRE(heap->getDiagnostics().allocated == 0U);
+
+    auto* const slab = o1heapSlabInit(h, SlabSize);
+    REQUIRE(slab != nullptr);
+    const auto base = heap->getDiagnostics().allocated;
+    REQUIRE(base > 0U);
+    REQUIRE(o1heapSlabAllocate(slab, 0U) == nullptr);
+    REQUIRE(o1heapSlabAllocate(slab, O1HEAP_SLAB_AMOUNT_MAX + 1U) == nullptr);
+    REQUIRE(heap->getDiagnostics().allocated == base);
+    o1heapSlabFree(slab, nullptr);
+
+    const auto slab_of = [](const void* const p) { return reinterpret_cast<std::uintptr_t>(p) & ~(SlabSize - 1U); };
+
+    // Fill one slab of the smallest class; the slots are handed out in the address order.
+    std::vector<void*> small;
+    for (std::size_t i = 0U; i < Slots8; i++)
+    {
+        auto* const p = o1heapSlabAllocate(slab, (i % 8U) + 1U);
+        REQUIRE(p != nullptr);
+        REQUIRE(slab_of(p) == slab_of(small.empty() ? p : small.front()));
+        REQUIRE((reinterpret_cast<std::uintptr_t>(p) - slab_of(p)) == (SlabHeaderSizePadded + (i * 8U)));
+        small.push_back(p);
+    }
+    REQUIRE(heap->getDiagnostics().allocated == base + SlabSize);
+    REQUIRE(Fragment::constructFromAllocatedMemory(reinterpret_cast<void*>(slab_of(small.front()))).getSize() ==
+            SlabSize);
+    REQUIRE(heap->doInvariantsHold());
+
+    // The slab is full, so the next request of the same class opens a new slab.
+    auto* const extra = o1heapSlabAllocate(slab, 8U);
+    REQUIRE(extra != nullptr);
+    REQUIRE(slab_of(extra) != slab_of(small.front()));
+    REQUIRE(heap->getDiagnostics().allocated == base + SlabSize * 2U);
+
+    // The classes do not share slabs. The alignment follows the class size.
+    auto* const p16 = o1heapSlabAllocate(slab, 9U);
+    auto* const p24 = o1heapSlabAllocate(slab, 24U);
+    auto* const p32 = o1heapSlabAllocate(slab, 25U);
+    auto* const p48 = o1heapSlabAllocate(slab, 33U);
+    REQUIRE(p16 != nullptr);
+    REQUIRE(p24 != nullptr);
+    REQUIRE(p32 != nullptr);
+    REQUIRE(p48 != nullptr);
+    REQUIRE(heap->getDiagnostics().allocated == base + SlabSize * 6U);
+    REQUIRE((reinterpret_cast<std::uintptr_t>(p16) % 16U) == 0U);
+    REQUIRE((reinterpret_cast<std::uintptr_t>(p24) % 8U) == 0U);
+    REQUIRE((reinterpret_cast<std::uintptr_t>(p32) % std::min<std::size_t>(32U, O1HEAP_ALIGNMENT)) == 0U);
+    REQUIRE((reinterpret_cast<std::uintptr_t>(p48) % 16U) == 0U);
+    std::memset(p48, 0xA5, O1HEAP_SLAB_AMOUNT_MAX);  // The slot shall not overlap with anything.
+    REQUIRE(heap->doInvariantsHold());
+
+    // The freed slots are reused in the LIFO order, and the full slab becomes available again.
+    o1heapSlabFree(slab, small.at(3));
+    o1heapSlabFree(slab, small.at(7));
+    REQUIRE(o1heapSlabAllocate(slab, 1U) == small.at(7));
+    REQUIRE(o1heapSlabAllocate(slab, 1U) == small.at(3));
+    REQUIRE(heap->getDiagnostics().allocated == base + SlabSize * 6U);
+
+    // The empty slabs are returned to the heap immediately.
+    o1heapSlabFree(slab, extra);
+    o1heapSlabFree(slab, p16);
+    o1heapSlabFree(slab, p24);
+    o1heapSlabFree(slab, p32);
+    o1heapSlabFree(slab, p48);
+    REQUIRE(heap->getDiagnostics().allocated == base + SlabSize);
+    for (auto* const p : small)
+    {
+        o1heapSlabFree(slab, p);
+    }
+    REQUIRE(heap->getDiagnostics().allocated == base);
+
+    // Exhaust the heap: the heap failure is reported as usual.
+    const auto oom_count = heap->getDiagnostics().oom_count;
+    std::vector<void*> large;
+    for (;;)
+    {
+        auto* const p = o1heapSlabAllocate(slab, 48U);
+        if (p == nullptr)
+        {
+            break;
+        }
+        large.push_back(p);
+    }
+    REQUIRE(large.size() >= Slots48 * 3U);
+    REQUIRE((large.size() % Slots48) == 0U);
+    REQUIRE(heap->getDiagnostics().oom_count > oom_count);
+    REQUIRE(heap->doInvariantsHold());
+    for (auto* const p : large)
+    {
+        o1heapSlabFree(slab, p);
+    }
+    REQUIRE(heap->getDiagnostics().allocated == base);
+
+    o1heapSlabDestroy(slab);
+    REQUIRE(heap->getDiagnostics().allocated == 0U);
+    REQUIRE(heap->doInvariantsHold());
+}
+
+TEST_CASE("General: slab: random")
+{
+    constexpr auto                   ArenaSize = MiB;
+    const std::shared_ptr<std::byte> arena(static_cast<std::byte*>(std::aligned_alloc(64U, ArenaSize)), &std::free);
+    auto                             heap = init(arena.get(), ArenaSize);
+    REQUIRE(heap != nullptr);
+    auto* const slab = o1heapSlabInit(reinterpret_cast<::O1HeapInstance*>(heap), KiB);
+    REQUIRE(slab != nullptr);
+    const auto base = heap->getDiagnostics().allocated;
+
+    std::random_device                         random_device;
+    std::mt19937                               random_generator(random_device());
+    std::uniform_int_distribution<std::size_t> dis_amount(1U, O1HEAP_SLAB_AMOUNT_MAX);
+    std::uniform_int_distribution<int>         dis_action(0, 2);
+
+    // Each slot is filled with a distinct pattern to detect overlaps.
+    std::vector<std::tuple<void*, std::size_t, std::uint8_t>> pointers;
+    for (auto i = 0U; i < 100'000U; i++)
+    {
+        if (((dis_action(random_generator) != 0) && (pointers.size() < 5'000U)) || pointers.empty())
+        {
+            const auto  amount = dis_amount(random_generator);
+            auto* const p      = o1heapSlabAllocate(slab, amount);
+            REQUIRE(p != nullptr);
+            std::memset(p, static_cast<int>(i & 0xFFU), amount);
+            pointers.emplace_back(p, amount, static_cast<std::uint8_t>(i & 0xFFU));
+        }
+        else
+        {
+            std::uniform_int_distribution<std::size_t> dis_index(0U, pointers.size() - 1U);
+            const auto                                 index = dis_index(random_generator);
+
+            const auto [p, amount, pattern] = pointers.at(index);
+            for (std::size_t k = 0U; k < amount; k++)
+            {
+                REQUIRE(static_cast<const std::uint8_t*>(p)[k] == pattern);
+            }
+            o1heapSlabFree(slab, p);
+            pointers.at(index) = pointers.back();
+            pointers.pop_back();
+        }
+        if ((i % 10'000U) == 0U)
+        {
+            REQUIRE(heap->doInvariantsHold());
+        }
+    }
+    for (const auto& item : pointers)
+    {
+        o1heapSlabFree(slab, std::get<0>(item));
+    }
+    REQUIRE(heap->getDiagnostics().allocated == base);
+    o1heapSlabDestroy(slab);
+    heap->matchFragments({{false, heap->diagnostics.capacity}});
+    REQUIRE(heap->doInvariantsHold());
+}
+
+TEST_CASE("General: concurrent")
+{
+    alignas(128U) std::array<std::byte, (KiB * 64U) + (4U * sizeof(internal::O1HeapInstance))> arena{};
+    REQUIRE(o1heapConcurrentInit(nullptr, std::size(arena), 4U) == nullptr);
+    REQUIRE(o1heapConcurrentInit(arena.data() + 1U, std::size(arena) - 1U, 4U) == nullptr);
+    REQUIRE(o1heapConcurrentInit(arena.data(), std::size(arena), 0U) == nullptr);
+    REQUIRE(o1heapConcurrentInit(arena.data(), 1000U, 4U) == nullptr);
+    REQUIRE(o1heapConcurrentInit(arena.data(), std::size(arena), std::size(arena)) == nullptr);
+    auto* const h = o1heapConcurrentInit(arena.data(), std::size(arena), 4U);
+    if (!AtomicsAvailable)
+    {
+        REQUIRE(h == nullptr);
+        return;
+    }
+    REQUIRE(h != nullptr);
+    REQUIRE(o1heapConcurrentDoInvariantsHold(h));
+    auto diag = o1heapConcurrentGetDiagnostics(h);
+    REQUIRE(diag.capacity > KiB * 60U);
+    REQUIRE(diag.capacity % 4U == 0U);
+    REQUIRE(diag.allocated == 0U);
+    const auto cap = diag.capacity / 4U;  // All shards are equal.
+    REQUIRE(cap > KiB * 12U);
+    REQUIRE(cap < KiB * 16U);
+
+    // The first allocation in each shard is placed at its beginning.
+    std::array<std::byte*, 4> heads{};
+    for (std::size_t i = 0U; i < std::size(heads); i++)
+    {
+        heads.at(i) = static_cast<std::byte*>(o1heapConcurrentAllocate(h, i, 1U));
+        REQUIRE(heads.at(i) != nullptr);
+        REQUIRE(reinterpret_cast<std::size_t>(heads.at(i)) % O1HEAP_ALIGNMENT == 0U);
+        if (i > 0U)
+        {
+            REQUIRE(heads.at(i) >= heads.at(i - 1U) + cap);
+        }
+    }
+    const auto shard_of = [&heads](const void* const p) {
+        std::size_t out = 0U;
+        for (std::size_t i = 0U; i < std::size(heads); i++)
+        {
+            out = (static_cast<const std::byte*>(p) >= heads.at(i)) ? i : out;
+        }
+        return out;
+    };
+    // The hint is taken modulo the number of shards.
+    auto* const p = o1heapConcurrentAllocate(h, 5U, 1U);
+    REQUIRE(shard_of(p) == 1U);
+    o1heapConcurrentFree(h, p);
+    o1heapConcurrentFree(h, nullptr);
+    diag = o1heapConcurrentGetDiagnostics(h);
+    REQUIRE(diag.allocated == O1HEAP_ALIGNMENT * 2U * 4U);
+    REQUIRE(diag.peak_allocated == O1HEAP_ALIGNMENT * 2U * 5U);
+    REQUIRE(diag.peak_request_size == 1U);
+    O1HeapFragmentation fg{};
+    o1heapConcurrentGetFragmentation(h, &fg);
+    REQUIRE(std::accumulate(std::begin(fg.free_fragment_size), std::end(fg.free_fragment_size), std::size_t{0U}) ==
+            (diag.capacity - diag.allocated));
+    REQUIRE(std::accumulate(std::begin(fg.free_fragment_count), std::end(fg.free_fragment_count), std::size_t{0U}) ==
+            4U);
+
+    // Each shard can fit three 4 KiB fragments. Once the preferred shard is full, the next ones are used in order.
+    std::vector<void*> items;
+    while (auto* const x = o1heapConcurrentAllocate(h, 2U, 4000U))
+    {
+        REQUIRE(shard_of(x) == ((2U + (items.size() / 3U)) % 4U));
+        items.push_back(x);
+    }
+    REQUIRE(items.size() == 12U);
+    REQUIRE(o1heapConcurrentAllocate(h, 3U, cap) == nullptr);
+    REQUIRE(o1heapConcurrentAllocate(h, 3U, 0U) == nullptr);
+    diag = o1heapConcurrentGetDiagnostics(h);
+    REQUIRE(diag.oom_count == 2U);
+    REQUIRE(diag.peak_request_size == cap);
+    REQUIRE(diag.allocated == (O1HEAP_ALIGNMENT * 2U * 4U) + (KiB * 4U * 12U));
+    REQUIRE(o1heapConcurrentDoInvariantsHold(h));
+
+    // Any shard can be freed into regardless of the preferred one.
+    std::shuffle(std::begin(items), std::end(items), std::mt19937(std::random_device()()));
+    for (auto* const x : items)
+    {
+        o1heapConcurrentFree(h, x);
+    }
+    for (auto* const x : heads)
+    {
+        o1heapConcurrentFree(h, x);
+    }
+    diag = o1heapConcurrentGetDiagnostics(h);
+    REQUIRE(diag.allocated == 0U);
+    REQUIRE(o1heapConcurrentDoInvariantsHold(h));
+
+    // With more shards than fit in one group, the order of the visits is preserved across the groups.
+    constexpr std::size_t            ShardCount = 70U;
+    constexpr auto                   ArenaSize  = ((KiB * 6U) + sizeof(internal::O1HeapInstance)) * ShardCount;
+    const std::shared_ptr<std::byte> large(static_cast<std::byte*>(std::aligned_alloc(64U, ArenaSize)), &std::free);
+    auto* const                      hl = o1heapConcurrentInit(large.get(), ArenaSize, ShardCount);
+    REQUIRE(hl != nullptr);
+    // Every shard can hold one allocation only, even if the remainder is probed.
+    REQUIRE((o1heapConcurrentGetDiagnostics(hl).capacity / ShardCount) > (KiB * 4U));
+    std::vector<std::byte*> filled;
+    while (auto* const x = static_cast<std::byte*>(o1heapConcurrentAllocate(hl, 60U, 4000U)))
+    {
+        filled.push_back(x);
+    }
+    REQUIRE(filled.size() == ShardCount);  // One per shard, starting from the preferred one and wrapping around.
+    for (std::size_t i = 1U; i < ShardCount; i++)
+    {
+        CAPTURE(i);
+        REQUIRE((filled.at(i) > filled.at(i - 1U)) == (i != (ShardCount - 60U)));
+    }
+    for (auto* const x : filled)
+    {
+        o1heapConcurrentFree(hl, x);
+    }
+    REQUIRE(o1heapConcurrentGetDiagnostics(hl).allocated == 0U);
+}
+
+TEST_CASE("General: concurrent: threads")
+{
+    constexpr auto                   ArenaSize = MiB * 8U;
+    const std::shared_ptr<std::byte> arena(static_cast<std::byte*>(std::aligned_alloc(64U, ArenaSize)), &std::free);
+    auto* const                      h = o1heapConcurrentInit(arena.get(), ArenaSize, 4U);
+    if (!AtomicsAvailable)
+    {
+        REQUIRE(h == nullptr);
+        return;
+    }
+    REQUIRE(h != nullptr);
+
+    // The fragments are occasionally passed between the threads to exercise the cross-shard deallocation.
+    std::atomic<void*> exchange{nullptr};
+    const auto         worker = [h, &exchange](const std::uint32_t index) {
+        std::mt19937                                    random_generator(index);
+        std::uniform_int_distribution<std::size_t>      dis_amount(1U, 20'000U);
+        std::vector<std::pair<std::byte*, std::size_t>> pointers;
+        bool                                            ok      = true;
+        const auto                                      pattern = static_cast<std::byte>(index + 1U);
+        for (auto i = 0U; i < 20'000U; i++)
+        {
+            if ((pointers.size() < 64U) && ((random_generator() % 2U) == 0U))
+            {
+                const auto amount = dis_amount(random_generator);
+                auto*      p      = static_cast<std::byte*>(o1heapConcurrentAllocate(h, index, amount));
+                if (p != nullptr)
+                {
+                    std::fill_n(p, amount, pattern);
+                    pointers.emplace_back(p, amount);
+                }
+            }
+            else if (!pointers.empty())
+            {
+                const auto [p, amount] = pointers.back();
+                pointers.pop_back();
+                ok = ok && std::all_of(p, p + amount, [pattern](const std::byte x) { return x == pattern; });
+                o1heapConcurrentFree(h, ((random_generator() % 4U) == 0U) ? exchange.exchange(p) : p);
+            }
+        }
+        for (const auto& [p, amount] : pointers)
+        {
+            o1heapConcurrentFree(h, p);
+        }
+        return ok;
+    };
+
+    std::array<bool, 4>      results{};
+    std::vector<std::thread> threads;
+    for (std::uint32_t i = 0U; i < results.size(); i++)
+    {
+        threads.emplace_back([&results, &worker, i]() { results.at(i) = worker(i); });
+    }
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+    o1heapConcurrentFree(h, exchange.load());
+    REQUIRE(std::all_of(std::begin(results), std::end(results), [](const bool x) { return x; }));
+    REQUIRE(o1heapConcurrentDoInvariantsHold(h));
+    const auto diag = o1heapConcurrentGetDiagnostics(h);
+    REQUIRE(diag.allocated == 0U);
+    REQUIRE(diag.peak_allocated > 0U);
+}
+
+TEST_CASE("General: free deferred")
+{
+    using internal::Fragment;
+
+    alignas(128U) std::array<std::byte, 4096U + sizeof(internal::O1HeapInstance) + O1HEAP_ALIGNMENT * 2U - 1U> arena{};
+    auto heap = init(arena.data(), std::size(arena));
+    REQUIRE(heap != nullptr);
+    auto* const h = reinterpret_cast<::O1HeapInstance*>(heap);
+
+    constexpr auto X          = true;   // used
+    constexpr auto O          = false;  // free
+    constexpr auto DrainLimit = 4U;     // The default value of O1HEAP_DEFERRED_DRAIN_LIMIT.
+
+    REQUIRE(o1heapFreeDeferred(h, nullptr));
+    std::array<void*, 10> v{};
+    for (auto& x : v)
+    {
+        x = heap->allocate(200U);
+        REQUIRE(x != nullptr);
+    }
+    heap->matchFragments({{X, 256}, {X, 256}, {X, 256}, {X, 256}, {X, 256}, {X, 256}, {X, 256}, {X, 256}, {X, 256},
+                          {X, 256}, {O, 1536}});
+    if (!AtomicsAvailable)
+    {
+        REQUIRE(!o1heapFreeDeferred(h, v.at(0)));
+        REQUIRE(heap->getDiagnostics().deferred_depth == 0U);
+        REQUIRE(heap->getDiagnostics().allocated == 2560U);
+        return;
+    }
+
+    // The queued fragments are still allocated until the owner drains the queue.
+    REQUIRE(o1heapFreeDeferred(h, v.at(8)));
+    REQUIRE(o1heapFreeDeferred(h, v.at(9)));
+    REQUIRE(heap->getDiagnostics().deferred_depth == 2U);
+    REQUIRE(heap->getDiagnostics().allocated == 2560U);
+    heap->matchFragments({{X, 256}, {X, 256}, {X, 256}, {X, 256}, {X, 256}, {X, 256}, {X, 256}, {X, 256}, {X, 256},
+                          {X, 256}, {O, 1536}});
+    heap->free(nullptr);
+    REQUIRE(heap->getDiagnostics().deferred_depth == 0U);
+    REQUIRE(heap->getDiagnostics().allocated == 2048U);
+    heap->matchFragments({{X, 256}, {X, 256}, {X, 256}, {X, 256}, {X, 256}, {X, 256}, {X, 256}, {X, 256}, {O, 2048}});
+
+    // The queue is drained in bounded chunks by both allocation and deallocation.
+    for (std::size_t i = 0U; i < 8U; i++)
+    {
+        REQUIRE(o1heapFreeDeferred(h, v.at(i)));
+    }
+    REQUIRE(heap->getDiagnostics().deferred_depth == 8U);
+    heap->free(nullptr);
+    REQUIRE(heap->getDiagnostics().deferred_depth == 8U - DrainLimit);
+    REQUIRE(heap->getDiagnostics().allocated == 256U * (8U - DrainLimit));
+    auto* const a = heap->allocate(200U);
+    REQUIRE(a != nullptr);
+    REQUIRE(heap->getDiagnostics().deferred_depth == 0U);
+    REQUIRE(heap->getDiagnostics().allocated == 256U);
+    heap->free(a);
+    heap->matchFragments({{O, 4096}});
+    REQUIRE(heap->doInvariantsHold());
+}
+
+TEST_CASE("General: free deferred: threads")
+{
+    constexpr auto                   ArenaSize = MiB * 8U;
+    const std::shared_ptr<std::byte> arena(static_cast<std::byte*>(std::aligned_alloc(64U, ArenaSize)), &std::free);
+    auto                             heap = init(arena.get(), ArenaSize);
+    REQUIRE(heap != nullptr);
+    auto* const h = reinterpret_cast<::O1HeapInstance*>(heap);
+    if (!AtomicsAvailable)
+    {
+        return;
+    }
+
+    // The owner allocates the fragments and hands them over to the other threads, which free them.
+    std::mutex         lock;
+    std::vector<void*> handover;
+    std::atomic<bool>  done{false};
+    const auto         consumer = [h, &lock, &handover, &done]() {
+        bool ok       = true;
+        bool finished = false;
+        while (!finished)
+        {
+            void* p = nullptr;
+            {
+                const std::lock_guard<std::mutex> guard(lock);
+                if (!handover.empty())
+                {
+                    p = handover.back();
+                    handover.pop_back();
+                }
+                else
+                {
+                    finished = done.load();
+                }
+            }
+            ok = ok && o1heapFreeDeferred(h, p);
+        }
+        return ok;
+    };
+    std::array<bool, 3>      results{};
+    std::vector<std::thread> threads;
+    for (std::size_t i = 0U; i < results.size(); i++)
+    {
+        threads.emplace_back([&results, &consumer, i]() { results.at(i) = consumer(); });
+    }
+
+    std::mt19937                               random_generator(std::random_device{}());
+    std::uniform_int_distribution<std::size_t> dis_amount(1U, 4U * KiB);
+    std::vector<void*>                         own;
+    for (auto i = 0U; i < 50'000U; i++)
+    {
+        auto* const p = o1heapAllocate(h, dis_amount(random_generator));
+        if (p == nullptr)
+        {
+            continue;
+        }
+        if ((random_generator() % 4U) == 0U)
+        {
+            own.push_back(p);
+        }
+        else
+        {
+            const std::lock_guard<std::mutex> guard(lock);
+            handover.push_back(p);
+        }
+        if ((own.size() > 16U) || ((random_generator() % 8U) == 0U))
+        {
+            o1heapFree(h, own.empty() ? nullptr : own.back());
+            if (!own.empty())
+            {
+                own.pop_back();
+            }
+        }
+    }
+    done.store(true);
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+    REQUIRE(std::all_of(std::begin(results), std::end(results), [](const bool x) { return x; }));
+    for (auto* const p : own)
+    {
+        o1heapFree(h, p);
+    }
+    while (heap->getDiagnostics().deferred_depth > 0U)
+    {
+        heap->free(nullptr);
+    }
+    REQUIRE(heap->getDiagnostics().allocated == 0U);
+    heap->matchFragments({{false, heap->diagnostics.capacity}});
+}
+
+TEST_CASE("General: deferred coalescing")
+{
+    using internal::Fragment;
+
+    alignas(128U) std::array<std::byte, 4096U + sizeof(internal::O1HeapInstance) + O1HEAP_ALIGNMENT * 2U - 1U> arena{};
+    auto heap = init(arena.data(), std::size(arena));
+    REQUIRE(heap != nullptr);
+    REQUIRE(heap->diagnostics.capacity == 4096U);
+
+    constexpr auto X    = true;   // used
+    constexpr auto O    = false;  // free
+    constexpr auto S    = Fragment::SizeMin;
+    constexpr auto Rest = 4096U - (S * 16U);
+
+    REQUIRE(heap->maintain(100U) == 0U);
+    auto* const a = heap->allocate((S * 4U) - O1HEAP_ALIGNMENT);
+    auto* const b = heap->allocate((S * 4U) - O1HEAP_ALIGNMENT);
+    auto* const c = heap->allocate((S * 4U) - O1HEAP_ALIGNMENT);
+    auto* const d = heap->allocate((S * 4U) - O1HEAP_ALIGNMENT);
+    REQUIRE(d != nullptr);
+    heap->matchFragments({{X, S * 4U}, {X, S * 4U}, {X, S * 4U}, {X, S * 4U}, {O, Rest}});
+
+    // The freed fragments remain in place and accounted for until coalesced, most recently freed first.
+    heap->free(b);
+    heap->free(c);
+    if (O1HEAP_DEFERRED_COALESCING)
+    {
+        heap->matchFragments({{X, S * 4U}, {X, S * 4U}, {X, S * 4U}, {X, S * 4U}, {O, Rest}});
+        REQUIRE(heap->diagnostics.pending_depth == 2U);
+        REQUIRE(heap->diagnostics.allocated == (S * 16U));
+        REQUIRE(heap->maintain(1U) == 1U);
+        heap->matchFragments({{X, S * 4U}, {X, S * 4U}, {O, S * 4U}, {X, S * 4U}, {O, Rest}});
+        REQUIRE(heap->diagnostics.allocated == (S * 12U));
+    }
+    REQUIRE(heap->maintain(100U) == 0U);
+    heap->matchFragments({{X, S * 4U}, {O, S * 8U}, {X, S * 4U}, {O, Rest}});
+    REQUIRE(heap->diagnostics.allocated == (S * 8U));
+
+    // An allocation that cannot be served otherwise coalesces the pending fragments on demand.
+    heap->free(a);
+    heap->free(d);
+    REQUIRE(heap->diagnostics.pending_depth == (O1HEAP_DEFERRED_COALESCING ? 2U : 0U));
+    auto* const e = heap->allocate(4096U - O1HEAP_ALIGNMENT);
+    REQUIRE(e != nullptr);
+    REQUIRE(heap->diagnostics.pending_depth == 0U);
+    REQUIRE(heap->diagnostics.allocated == 4096U);
+    REQUIRE(heap->diagnostics.oom_count == 0U);
+    heap->matchFragments({{X, 4096U}});
+
+    // Maintenance with zero budget does nothing.
+    heap->free(e);
+    REQUIRE(heap->maintain(0U) == (O1HEAP_DEFERRED_COALESCING ? 1U : 0U));
+    REQUIRE(heap->maintain(1U) == 0U);
+    heap->matchFragments({{O, 4096U}});
+    REQUIRE(heap->diagnostics.allocated == 0U);
+
+    // The fragments within the frame that await coalescing are discarded by the rollback.
+    REQUIRE(heap->mark());
+    auto* const f = heap->allocate((S * 4U) - O1HEAP_ALIGNMENT);
+    auto* const g = heap->allocate((S * 4U) - O1HEAP_ALIGNMENT);
+    REQUIRE(g != nullptr);
+    heap->free(f);
+    REQUIRE(heap->diagnostics.pending_depth == (O1HEAP_DEFERRED_COALESCING ? 1U : 0U));
+    REQUIRE(heap->rollback());
+    REQUIRE(heap->diagnostics.pending_depth == 0U);
+    heap->matchFragments({{O, 4096U}});
+
+    // A fragment outside of the frame voids the checkpoint whether it is coalesced or not.
+    auto* const h = heap->allocate((S * 4U) - O1HEAP_ALIGNMENT);
+    REQUIRE(h != nullptr);
+    REQUIRE(heap->mark());
+    heap->free(h);
+    REQUIRE(!heap->rollback());
+    REQUIRE(heap->mark());  // The pending fragment is released before the checkpoint is taken.
+    REQUIRE(heap->diagnostics.pending_depth == 0U);
+    heap->matchFragments({{O, 4096U}});
+    REQUIRE(heap->doInvariantsHold());
+}
+
+TEST_CASE("General: deferred coalescing: accounting")
+{
+    using internal::Fragment;
+    using Event = std::pair<O1HeapPressureEvent, std::size_t>;
+
+    alignas(128U) std::array<std::byte, 4096U + sizeof(internal::O1HeapInstance) + O1HEAP_ALIGNMENT * 2U - 1U> arena{};
+    auto heap = init(arena.data(), std::size(arena));
+    REQUIRE(heap != nullptr);
+    REQUIRE(heap->diagnostics.capacity == 4096U);
+    auto* const    handle = reinterpret_cast<::O1HeapInstance*>(heap);
+    constexpr auto S      = Fragment::SizeMin;
+    static_assert(O1HEAP_TAG_COUNT >= 3U, "The test requires several tags");
+
+    // The fragments that await coalescing are still accounted for as allocated, yet they shall not cause failures
+    // that would not occur if they were coalesced immediately. Every failure is reported to the callback.
+    std::vector<Event> events;
+    const auto         callback = [](void* const context, const O1HeapPressureEvent event, const std::size_t amount) {
+        static_cast<std::vector<Event>*>(context)->emplace_back(event, amount);
+        return false;
+    };
+    o1heapSetPressureCallback(handle, callback, &events, 4096U, 0U);
+
+    // The tag quota.
+    REQUIRE(o1heapSetTagQuota(handle, 1U, S * 8U));
+    auto* const a = heap->allocateTagged((S * 4U) - O1HEAP_ALIGNMENT, 1U);
+    auto* const b = heap->allocateTagged((S * 4U) - O1HEAP_ALIGNMENT, 1U);
+    REQUIRE(a != nullptr);
+    REQUIRE(b != nullptr);
+    heap->free(a);
+    auto* const c = heap->allocateTagged((S * 4U) - O1HEAP_ALIGNMENT, 1U);
+    REQUIRE(c != nullptr);
+    REQUIRE(heap->diagnostics.pending_depth == 0U);
+    REQUIRE(o1heapGetTagDiagnostics(handle, 1U).allocated == (S * 8U));
+
+    // The tag quota when growing the memory.
+    heap->free(b);
+    auto* const d = heap->reallocate(c, (S * 8U) - O1HEAP_ALIGNMENT);
+    REQUIRE(d != nullptr);
+    REQUIRE(heap->diagnostics.pending_depth == 0U);
+    REQUIRE(o1heapGetTagDiagnostics(handle, 1U).allocated == (S * 8U));
+    REQUIRE(o1heapGetTagDiagnostics(handle, 1U).quota_fail_count == 0U);
+    heap->free(d);
+    REQUIRE(heap->maintain(100U) == 0U);
+    heap->matchFragments({{false, 4096U}});
+
+    // The reserve, including the aligned allocations.
+    o1heapSetReserve(handle, 2048U, 1U);
+    auto* const e = heap->allocate(1024U - O1HEAP_ALIGNMENT);
+    auto* const f = heap->allocate(1024U - O1HEAP_ALIGNMENT);
+    REQUIRE(e != nullptr);
+    REQUIRE(f != nullptr);
+    heap->free(e);
+    auto* const g = heap->allocate(1024U - O1HEAP_ALIGNMENT);
+    REQUIRE(g != nullptr);
+    heap->free(f);
+    auto* const h = heap->allocateAligned(1024U, 1024U - O1HEAP_ALIGNMENT);
+    REQUIRE(h != nullptr);
+    REQUIRE(heap->diagnostics.pending_depth == 0U);
+    REQUIRE(heap->diagnostics.reserve_denial_count == 0U);
+    heap->free(g);
+    heap->free(h);
+    o1heapSetReserve(handle, 0U, 0U);
+
+    // The fragments released on demand within the frame do not void the checkpoint.
+    REQUIRE(heap->mark());
+    REQUIRE(o1heapSetTagQuota(handle, 2U, S * 4U));
+    auto* const i = heap->allocateTagged((S * 4U) - O1HEAP_ALIGNMENT, 2U);
+    REQUIRE(i != nullptr);
+    heap->free(i);
+    REQUIRE(heap->allocateTagged((S * 4U) - O1HEAP_ALIGNMENT, 2U) != nullptr);
+    REQUIRE(heap->rollback());
+    REQUIRE(o1heapGetTagDiagnostics(handle, 2U).allocated == 0U);
+    heap->matchFragments({{false, 4096U}});
+
+    // Only the genuine failures are counted and reported.
+    REQUIRE(events.empty());
+    REQUIRE(heap->diagnostics.oom_count == 0U);
+    REQUIRE(heap->allocateTagged((S * 8U) - O1HEAP_ALIGNMENT, 2U) == nullptr);
+    REQUIRE(o1heapGetTagDiagnostics(handle, 2U).quota_fail_count == 1U);
+    REQUIRE(events == std::vector<Event>{{O1HEAP_PRESSURE_OOM, (S * 8U) - O1HEAP_ALIGNMENT}});
+    REQUIRE(heap->diagnostics.oom_count == 1U);
+    REQUIRE(heap->doInvariantsHold());
+}
+
+TEST_CASE("General: random A")
+{
+    using internal::Fragment;
+
+    constexpr auto                   ArenaSize = MiB * 300U;
+    const std::shared_ptr<std::byte> arena(static_cast<std::byte*>(std::aligned_alloc(64U, ArenaSize)), &std::free);
+    std::generate_n(arena.get(), ArenaSize, getRandomByte);  // Random-fill the ENTIRE arena!
+    auto heap = init(arena.get(), ArenaSize);
+    REQUIRE(heap != nullptr);
+
+    std::vector<void*> pointers;
+
+    std::size_t   allocated         = 0U;
+    std::size_t   peak_allocated    = 0U;
+    std::size_t   peak_request_size = 0U;
+    std::uint64_t oom_count         = 0U;
+
+    std::random_device random_device;
+    std::mt19937       random_generator(random_device());
+
+    // The free list policy does not affect the correctness, so a random one is used to extend the coverage.
+    const auto policy = static_cast<O1HeapFreeListPolicy>(std::uniform_int_distribution<int>(0, 2)(random_generator));
+    o1heapSetFreeListPolicy(reinterpret_cast<::O1HeapInstance*>(heap), policy);
+    CAPTURE(policy);
+
+    const auto allocate = [&]() {
+        REQUIRE(heap->doInvariantsHold());
+        std::uniform_int_distribution<std::size_t> dis(0, ArenaSize / 1000U);
+
+        const std::size_t amount = dis(random_generator);
+        const auto        ptr    = heap->allocate(amount);
+        if (ptr != nullptr)
+        {
+            // Overwrite all to ensure that the allocator does not make implicit assumptions about the memory use.
+            std::generate_n(reinterpret_cast<std::byte*>(ptr), amount, getRandomByte);
+            pointers.push_back(ptr);
+            const auto& frag = Fragment::constructFromAllocatedMemory(ptr);
+            allocated += frag.getSize();
+            peak_allocated = std::max(peak_allocated, allocated);
+        }
+        else
+        {
+            if (amount > 0U)
+            {
+                oom_count++;
+            }
+        }
+        peak_request_size = std::max(peak_request_size, amount);
+        REQUIRE(heap->doInvariantsHold());
+    };
+
+    const auto deallocate = [&]() {
+        REQUIRE(heap->doInvariantsHold());
+        if (!pointers.empty())
+        {
+            std::uniform_int_distribution<decltype(pointers)::difference_type>
+                        dis(0, static_cast<decltype(pointers)::difference_type>(std::size(pointers) - 1));
+            const auto  it  = std::begin(pointers) + dis(random_generator);
+            void* const ptr = *it;
+            (void) pointers.erase(it);
+            if (ptr != nullptr)
+            {
+                const auto& frag = Fragment::constructFromAllocatedMemory(ptr);
+                frag.validate();
+                REQUIRE(allocated >= frag.getSize());
+                allocated -= frag.getSize();
+            }
+            heap->free(ptr);
+        }
+        REQUIRE(heap->doInvariantsHold());
+        REQUIRE(o1heapValidateStep(reinterpret_cast<::O1HeapInstance*>(heap), 3U));
+    };
+
+    // The memory use is growing slowly from zero.
+    // We stop the test when it's been running near the max heap utilization for long enough.
+    while (heap->diagnostics.oom_count < 1000U)
+    {
+        for (auto i = 0U; i < 100U; i++)
+        {
+            allocate();
+        }
+        for (auto i = 0U; i < 50U; i++)
+        {
+            deallocate();
+        }
+        REQUIRE(heap->diagnostics.allocated == allocated);
+        REQUIRE(heap->diagnostics.peak_allocated == peak_allocated);
+        REQUIRE(heap->diagnostics.peak_request_size == peak_request_size);
+        REQUIRE(heap->diagnostics.oom_count == oom_count);
+        REQUIRE(heap->doInvariantsHold());
+
+        std::cout << heap->visualize() << std::endl;
+    }
+}
+
+TEST_CASE("General: invariant checker")
+{
+    using internal::Fragment;
+
+    alignas(128U) std::array<std::byte, 4096U + sizeof(internal::O1HeapInstance) + O1HEAP_ALIGNMENT * 2U - 1U> arena{};
+    auto heap = init(arena.data(), std::size(arena));
+    REQUIRE(heap != nullptr);
+    REQUIRE(heap->doInvariantsHold());
+    auto& dg = heap->diagnostics;
+    auto& tg = heap->tag_diagnostics.at(0);
+
+    dg.capacity++;
+    REQUIRE(!heap->doInvariantsHold());
+    dg.capacity--;
+    REQUIRE(heap->doInvariantsHold());
+
+    dg.allocated += Fragment::SizeMin;
+    tg.allocated += Fragment::SizeMin;
+    REQUIRE(!heap->doInvariantsHold());
+    dg.peak_allocated += Fragment::SizeMin;
+    REQUIRE(!heap->doInvariantsHold());
+    tg.peak_allocated += Fragment::SizeMin;
+    REQUIRE(!heap->doInvariantsHold());
+    dg.peak_request_size += 1;
+    REQUIRE(heap->doInvariantsHold());
+    dg.peak_allocated--;
+    REQUIRE(!heap->doInvariantsHold());
+    dg.peak_allocated++;
+    tg.allocated -= Fragment::SizeMin;
+    REQUIRE(!heap->doInvariantsHold());  // The per-tag allocated memory does not add up to the total.
+    heap->tag_diagnostics.at(O1HEAP_TAG_COUNT - 1U).allocated      = Fragment::SizeMin;
+    heap->tag_diagnostics.at(O1HEAP_TAG_COUNT - 1U).peak_allocated = Fragment::SizeMin;
+    REQUIRE(heap->doInvariantsHold());
+    heap->tag_diagnostics.at(O1HEAP_TAG_COUNT - 1U).allocated = 0U;
+    dg.allocated -= Fragment::SizeMin;
+    REQUIRE(heap->doInvariantsHold());
+    tg.peak_allocated = dg.capacity + 1U;
+    REQUIRE(!heap->doInvariantsHold());
+    tg.peak_allocated = dg.capacity;
+    REQUIRE(heap->doInvariantsHold());
+    dg.allocated++;
+    REQUIRE(!heap->doInvariantsHold());
+    dg.allocated--;
+    REQUIRE(heap->doInvariantsHold());
+
+    dg.peak_allocated = dg.capacity + 1U;
+    REQUIRE(!heap->doInvariantsHold());
+    dg.peak_allocated = dg.capacity;
+    REQUIRE(heap->doInvariantsHold());
+
+    dg.peak_request_size = dg.capacity;
+    REQUIRE(!heap->doInvariantsHold());
+    dg.oom_count++;
+    REQUIRE(heap->doInvariantsHold());
+
+    dg.largest_allocatable += Fragment::SizeMin;
+    REQUIRE(!heap->doInvariantsHold());
+    dg.largest_allocatable -= Fragment::SizeMin;
+    REQUIRE(heap->doInvariantsHold());
+
+    auto&      fg = heap->fragmentation;
+    const auto it = std::find_if(std::begin(fg.free_fragment_count), std::end(fg.free_fragment_count), [](auto x) {
+        return x > 0U;
+    });
+    REQUIRE(it != std::end(fg.free_fragment_count));
+    (*it)++;
+    REQUIRE(!heap->doInvariantsHold());
+    (*it)--;
+    REQUIRE(heap->doInvariantsHold());
+    std::begin(fg.free_fragment_size)[it - std::begin(fg.free_fragment_count)] = 0U;
+    REQUIRE(!heap->doInvariantsHold());
 }
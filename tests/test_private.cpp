@@ -84,3 +84,42 @@ TEST_CASE("Private: roundUpToPowerOf2")
         REQUIRE(pow2(log2Ceil(i)) == roundUpToPowerOf2(i));
     }
 }
+
+TEST_CASE("Private: roundUpToBin")
+{
+    using internal::getBinIndex;
+    using internal::roundUpToBin;
+    using internal::roundUpToPowerOf2;
+    constexpr std::size_t Min = O1HEAP_ALIGNMENT * 2U;
+    // The function is only defined for x>O1HEAP_ALIGNMENT.
+    REQUIRE(roundUpToBin(O1HEAP_ALIGNMENT + 1U) == Min);
+    REQUIRE(roundUpToBin(Min) == Min);
+    REQUIRE(roundUpToBin(Min + 1U) == Min * 2U);
+#if O1HEAP_SUBBIN_BITS == 3
+    REQUIRE(roundUpToBin((Min * 16U) + 1U) == (Min * 18U));
+    REQUIRE(roundUpToBin((Min * 17U) + 1U) == (Min * 18U));
+    REQUIRE(roundUpToBin((Min * 18U) + 1U) == (Min * 20U));
+    REQUIRE(roundUpToBin((Min * 31U) + 1U) == (Min * 32U));
+#endif
+    std::size_t last_bin = 0U;
+    for (auto i = O1HEAP_ALIGNMENT + 1U; i < 1'000'000; i++)
+    {
+        const auto out = roundUpToBin(i);
+        REQUIRE(out >= i);
+        REQUIRE((out % Min) == 0U);
+        REQUIRE(roundUpToBin(out) == out);
+        // The rounding waste does not exceed 1/2**O1HEAP_SUBBIN_BITS of the power of 2 below, or the min fragment.
+        REQUIRE((out - i) < std::max<std::size_t>(Min, roundUpToPowerOf2(i) >> (O1HEAP_SUBBIN_BITS + 1U)));
+#if O1HEAP_SUBBIN_BITS == 0
+        REQUIRE(out == std::max<std::size_t>(Min, roundUpToPowerOf2(i)));
+#endif
+        // Every rounded size is the lower bound of a bin, and the bin index is monotonic.
+        if (((i % Min) == 0U) && (i >= Min))
+        {
+            const auto bin = getBinIndex(i);
+            REQUIRE(bin >= last_bin);
+            REQUIRE((bin > last_bin) == ((out == i) && (i > Min)));
+            last_bin = bin;
+        }
+    }
+}